@@ -1,10 +1,23 @@
 #pragma once
 
-#include <fstream> 
-#include <sstream>
-#include <iterator>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include "mappedfile.h"
 #include "unknown_opcode_exception.h"
 
+// Produces bytes on demand for a BinaryReader, such as a streaming decompressor
+class IByteSource
+{
+public:
+    virtual ~IByteSource() = default;
+
+    // Writes up to count bytes to buffer and returns how many were written, 0 means there is no more data
+    virtual size_t Read(unsigned char* buffer, size_t count) = 0;
+};
+
 class BinaryReader
 {
 public:
@@ -25,13 +38,53 @@ public:
         }
     }
 
+    // Takes ownership of the data, the bytes are not copied
     BinaryReader(std::vector<unsigned char>&& data)
+        : mOwnedData(std::move(data)),
+          mOwnedFile(),
+          mSource(),
+          mData(mOwnedData.data()),
+          mSize(mOwnedData.size())
+    {
+
+    }
+
+    // Views a caller owned buffer, which must outlive the reader
+    BinaryReader(const unsigned char* data, size_t size)
+        : mOwnedData(),
+          mOwnedFile(),
+          mSource(),
+          mData(data),
+          mSize(size)
+    {
+
+    }
+
+    // Takes ownership of a mapped file and reads directly from it
+    BinaryReader(std::unique_ptr<MappedFile> file)
+        : mOwnedData(),
+          mOwnedFile(std::move(file)),
+          mSource(),
+          mData(mOwnedFile->Data()),
+          mSize(mOwnedFile->Size())
+    {
+
+    }
+
+    // Pulls data from the source only as far as it is read or seeked to, so the
+    // rest of the source is never produced if the caller stops early
+    BinaryReader(std::unique_ptr<IByteSource> source)
+        : mOwnedData(),
+          mOwnedFile(),
+          mSource(std::move(source))
     {
-        mSize = data.size();
-        std::copy(data.begin(), data.end(), std::ostream_iterator<unsigned char>(mStream));
-        mStream.seekg(std::ios::beg);
+
     }
 
+    BinaryReader(const BinaryReader&) = delete;
+    BinaryReader& operator = (const BinaryReader&) = delete;
+
+    // When reading from a source this is only the number of bytes produced so far
     size_t Size() const
     {
         return mSize;
@@ -39,59 +92,90 @@ public:
 
     void Seek(unsigned int pos)
     {
-        if (!mStream.seekg(pos))
+        if (pos > mSize && !Fill(pos))
         {
             throw InternalDecompilerError();
         }
+        mPos = pos;
     }
 
     unsigned int Position()
     {
-        return static_cast<unsigned int>(mStream.tellg());
+        return static_cast<unsigned int>(mPos);
     }
 
     unsigned int ReadU32()
     {
-        return InternalRead<unsigned int>();
+        const unsigned char* p = Take(4);
+        return static_cast<unsigned int>(p[0]) |
+            (static_cast<unsigned int>(p[1]) << 8) |
+            (static_cast<unsigned int>(p[2]) << 16) |
+            (static_cast<unsigned int>(p[3]) << 24);
     }
 
     signed int ReadS32()
     {
-        return InternalRead<signed int>();
+        return static_cast<signed int>(ReadU32());
     }
 
     signed short int ReadS16()
     {
-        return InternalRead<signed short int>();
+        return static_cast<signed short int>(ReadU16());
     }
 
     unsigned short int ReadU16()
     {
-        return InternalRead<unsigned short int>();
+        const unsigned char* p = Take(2);
+        return static_cast<unsigned short int>(p[0] | (p[1] << 8));
     }
 
     unsigned char ReadU8()
     {
-        return InternalRead<unsigned char>();
+        return *Take(1);
     }
 
     signed char ReadS8()
     {
-        return InternalRead<signed char>();
+        return static_cast<signed char>(ReadU8());
     }
 
 private:
-    template<class T>
-    T InternalRead()
+    // Returns a pointer to the next count bytes and advances past them
+    const unsigned char* Take(size_t count)
     {
-        T r = {};
-        if (!mStream.read(reinterpret_cast<char*>(&r), sizeof(r)))
+        if (count > mSize - mPos && !Fill(mPos + count))
         {
             throw InternalDecompilerError();
         }
-        return r;
+        const unsigned char* p = mData + mPos;
+        mPos += count;
+        return p;
+    }
+
+    // Pulls from the source until at least size bytes are available, returns false if it runs out first
+    bool Fill(size_t size)
+    {
+        // Read ahead in chunks so small reads don't each call in to the source
+        const size_t kChunkSize = 4096;
+        while (mSource && mSize < size)
+        {
+            mOwnedData.resize(std::max(size, mSize + kChunkSize));
+            const size_t read = mSource->Read(mOwnedData.data() + mSize, mOwnedData.size() - mSize);
+            mSize += read;
+            mOwnedData.resize(mSize);
+            mData = mOwnedData.data();
+            if (read == 0)
+            {
+                mSource.reset();
+            }
+        }
+        return mSize >= size;
     }
 
-    std::stringstream mStream;
-    size_t mSize;
+    std::vector<unsigned char> mOwnedData;
+    std::unique_ptr<MappedFile> mOwnedFile;
+    std::unique_ptr<IByteSource> mSource;
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+    size_t mPos = 0;
 };
@@ -1,92 +1,512 @@
 #pragma once
 
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "unknown_opcode_exception.h"
+#include "binaryreader.h"
+
 namespace Lzs
 {
-    inline std::vector<unsigned char> Decompress(const std::vector<unsigned char>& compressed)
+    namespace Detail
     {
-        if (compressed.size() < 4)
+        const size_t kHeaderSize = 4;
+        const unsigned int kWindowMask = 0xFFF;
+        const unsigned int kWindowBias = 18;
+        const unsigned int kMinReferenceLength = 3;
+        const unsigned int kMaxReferenceLength = 18;
+
+        const size_t kWindowSize = kWindowMask + 1;
+
+        // Most input bytes that a single control byte can cover, 8 references of 2 bytes each
+        const size_t kMaxBlockSize = 1 + 8 * 2;
+
+        inline unsigned int ReadLength(const unsigned char* p)
         {
-            abort();
+            return static_cast<unsigned int>(p[0]) |
+                (static_cast<unsigned int>(p[1]) << 8) |
+                (static_cast<unsigned int>(p[2]) << 16) |
+                (static_cast<unsigned int>(p[3]) << 24);
         }
 
-        const unsigned int inputBufferSize = static_cast<unsigned int>(compressed.size());
-        const unsigned int input_length =
-            (((compressed[0] & 0xFF) << 0) |
-            ((compressed[1] & 0xFF) << 8) |
-            ((compressed[2] & 0xFF) << 16) |
-            ((compressed[3] & 0xFF) << 24)) + 4;
+        inline void CheckHeader(const unsigned char* compressed, size_t compressedSize)
+        {
+            if (compressedSize < kHeaderSize)
+            {
+                throw LzsDecompressionException("stream is too small to hold a header");
+            }
 
-        if (input_length != inputBufferSize)
+            if (ReadLength(compressed) + kHeaderSize != compressedSize)
+            {
+                throw LzsDecompressionException("header length does not match the stream size");
+            }
+        }
+
+        // Walks the control bytes to find the exact decompressed size without writing anything,
+        // also rejects a stream that is truncated part way through a reference
+        inline size_t DecompressedSize(const unsigned char* input, size_t inputSize)
         {
-            abort();
+            size_t inputOffset = kHeaderSize;
+            size_t outputSize = 0;
+            while (inputOffset < inputSize)
+            {
+                unsigned int controlByte = input[inputOffset++];
+                for (int bit = 0; bit < 8 && inputOffset < inputSize; bit++, controlByte >>= 1)
+                {
+                    if (controlByte & 1)
+                    {
+                        inputOffset++;
+                        outputSize++;
+                    }
+                    else
+                    {
+                        if (inputSize - inputOffset < 2)
+                        {
+                            throw LzsDecompressionException("stream ends inside a reference");
+                        }
+                        outputSize += (input[inputOffset + 1] & 0xF) + kMinReferenceLength;
+                        inputOffset += 2;
+                    }
+                }
+            }
+            return outputSize;
         }
 
-        unsigned int extract_size = (inputBufferSize + 255) & ~255;
-        std::vector<unsigned char> extract_buffer(extract_size);
+        // Copies a back reference, anything before the start of the output is treated as zeros.
+        // May write up to kMaxReferenceLength bytes past the reference, so the output needs that much slack.
+        inline void CopyReference(unsigned char* output, size_t& outputOffset, const unsigned char* reference)
+        {
+            const unsigned int referenceOffset = reference[0] | ((reference[1] & 0xF0) << 4);
+            size_t length = (reference[1] & 0xF) + kMinReferenceLength;
+
+            const size_t distance = (outputOffset - kWindowBias - referenceOffset) & kWindowMask;
+            if (distance == 0)
+            {
+                // Refers to the bytes it is writing, which have never been written so read as zeros
+                std::memset(output + outputOffset, 0, length);
+                outputOffset += length;
+                return;
+            }
+            if (distance > outputOffset)
+            {
+                const size_t zeros = distance - outputOffset < length ? distance - outputOffset : length;
+                std::memset(output + outputOffset, 0, zeros);
+                outputOffset += zeros;
+                length -= zeros;
+                if (length == 0)
+                {
+                    return;
+                }
+            }
+
+            unsigned char* dst = output + outputOffset;
+            const unsigned char* src = dst - distance;
+            if (distance >= kMaxReferenceLength)
+            {
+                // Can't overlap, so use fixed size copies which compile down to a few moves
+                std::memcpy(dst, src, 16);
+                std::memcpy(dst + 16, src + 16, 2);
+            }
+            else
+            {
+                // May overlap, so each byte can depend on one written by this same reference
+                for (size_t i = 0; i < length; i++)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            outputOffset += length;
+        }
+    }
 
+    /*
+    * Decompresses an LZS stream, which starts with a 32-bit little-endian length of the data that follows.
+    * Throws LzsDecompressionException if the stream is malformed.
+    */
+    inline std::vector<unsigned char> Decompress(const unsigned char* compressed, size_t compressedSize)
+    {
+        using namespace Detail;
 
+        CheckHeader(compressed, compressedSize);
 
-        unsigned int input_offset = 4;
-        unsigned int output_offset = 0;
-        unsigned char control_byte = 0;
-        unsigned char control_bit = 0;
+        const size_t outputSize = DecompressedSize(compressed, compressedSize);
+        std::vector<unsigned char> output(outputSize + kMaxReferenceLength);
+        unsigned char* out = output.data();
+        size_t outputOffset = 0;
+        size_t inputOffset = kHeaderSize;
 
-        while (input_offset < inputBufferSize)
+        // Whole blocks, where all 8 items of the control byte are known to be present
+        while (compressedSize - inputOffset >= kMaxBlockSize)
         {
-            if (control_bit == 0)
+            unsigned int controlByte = compressed[inputOffset++];
+            if (controlByte == 0xFF)
             {
-                control_byte = compressed[input_offset++];
-                control_bit = 8;
+                std::memcpy(out + outputOffset, compressed + inputOffset, 8);
+                outputOffset += 8;
+                inputOffset += 8;
+                continue;
             }
 
-            if (control_byte & 1)
+            for (int bit = 0; bit < 8; bit++, controlByte >>= 1)
             {
-                extract_buffer[output_offset++] = compressed[input_offset++];
-
-                if (output_offset == extract_size)
+                if (controlByte & 1)
                 {
-                    extract_size += 256;
-                    extract_buffer.resize(extract_size);
+                    out[outputOffset++] = compressed[inputOffset++];
+                }
+                else
+                {
+                    CopyReference(out, outputOffset, compressed + inputOffset);
+                    inputOffset += 2;
                 }
             }
-            else
+        }
+
+        // Tail, which may stop part way through a control byte
+        while (inputOffset < compressedSize)
+        {
+            unsigned int controlByte = compressed[inputOffset++];
+            for (int bit = 0; bit < 8 && inputOffset < compressedSize; bit++, controlByte >>= 1)
             {
-                const unsigned char reference1 = compressed[input_offset++];
-                const unsigned char reference2 = compressed[input_offset++];
+                if (controlByte & 1)
+                {
+                    out[outputOffset++] = compressed[inputOffset++];
+                }
+                else
+                {
+                    CopyReference(out, outputOffset, compressed + inputOffset);
+                    inputOffset += 2;
+                }
+            }
+        }
+
+        // Drop the slack, this never reallocates
+        output.resize(outputSize);
+        return output;
+    }
+
+    inline std::vector<unsigned char> Decompress(const std::vector<unsigned char>& compressed)
+    {
+        return Decompress(compressed.data(), compressed.size());
+    }
+
+    /*
+    * Decompresses an LZS stream a piece at a time, keeping only the 4 KiB window that back references
+    * can reach rather than the whole output. Give it to a BinaryReader to only decompress as far as is read.
+    */
+    class StreamDecompressor : public IByteSource
+    {
+    public:
+        // Views the compressed data, which must outlive the decompressor
+        StreamDecompressor(const unsigned char* compressed, size_t compressedSize)
+            : mFile(),
+              mInput(compressed),
+              mInputSize(compressedSize)
+        {
+            Detail::CheckHeader(mInput, mInputSize);
+        }
 
-                const unsigned short int reference_offset = reference1 | ((reference2 & 0xF0) << 4);
+        // Takes ownership of a mapped file and decompresses directly from it
+        StreamDecompressor(std::unique_ptr<MappedFile> file)
+            : mFile(std::move(file)),
+              mInput(mFile->Data()),
+              mInputSize(mFile->Size())
+        {
+            Detail::CheckHeader(mInput, mInputSize);
+        }
 
-                const unsigned char reference_length = (reference2 & 0xF) + 3;
+        StreamDecompressor(const StreamDecompressor&) = delete;
+        StreamDecompressor& operator = (const StreamDecompressor&) = delete;
 
-                int real_offset = output_offset - ((output_offset - 18 - reference_offset) & 0xFFF);
+        virtual size_t Read(unsigned char* buffer, size_t count) override
+        {
+            using namespace Detail;
 
-                for (int j = 0; j < reference_length; ++j)
+            size_t written = 0;
+            while (written < count)
+            {
+                if (mReferenceRemaining > 0)
                 {
-                    if (real_offset < 0)
+                    // Finish off the current reference, possibly left over from the last call
+                    while (mReferenceRemaining > 0 && written < count)
                     {
-                        extract_buffer[output_offset++] = 0;
+                        const unsigned char value = mZeroReference ? 0 : mWindow[mReferencePos];
+                        mReferencePos = (mReferencePos + 1) & kWindowMask;
+                        Put(buffer, written, value);
+                        mReferenceRemaining--;
                     }
-                    else
+                    continue;
+                }
+
+                if (mInputOffset >= mInputSize)
+                {
+                    break;
+                }
+
+                if (mControlBits == 0)
+                {
+                    mControlByte = mInput[mInputOffset++];
+                    mControlBits = 8;
+                    if (mInputOffset >= mInputSize)
                     {
-                        extract_buffer[output_offset++] = extract_buffer[real_offset];
+                        break;
                     }
+                }
+
+                const bool isLiteral = (mControlByte & 1) != 0;
+                mControlByte >>= 1;
+                mControlBits--;
 
-                    if (output_offset == extract_size)
+                if (isLiteral)
+                {
+                    Put(buffer, written, mInput[mInputOffset++]);
+                }
+                else
+                {
+                    if (mInputSize - mInputOffset < 2)
                     {
-                        extract_size += 256;
-                        extract_buffer.resize(extract_size);
+                        throw LzsDecompressionException("stream ends inside a reference");
                     }
+                    const unsigned char* reference = mInput + mInputOffset;
+                    mInputOffset += 2;
 
-                    ++real_offset;
+                    const unsigned int referenceOffset = reference[0] | ((reference[1] & 0xF0) << 4);
+                    mReferenceRemaining = (reference[1] & 0xF) + kMinReferenceLength;
+
+                    // The window starts zeroed, which covers references to before the start of the output,
+                    // but a reference to its own position reads bytes that have never been written
+                    const size_t distance = (mProduced - kWindowBias - referenceOffset) & kWindowMask;
+                    mZeroReference = distance == 0;
+                    mReferencePos = (mProduced - distance) & kWindowMask;
                 }
             }
+            return written;
+        }
 
-            control_byte >>= 1;
-            control_bit--;
+        // Total number of bytes decompressed so far
+        size_t Produced() const
+        {
+            return mProduced;
+        }
+
+    private:
+        void Put(unsigned char* buffer, size_t& written, unsigned char value)
+        {
+            buffer[written++] = value;
+            mWindow[mProduced & Detail::kWindowMask] = value;
+            mProduced++;
+        }
+
+        std::unique_ptr<MappedFile> mFile;
+        const unsigned char* mInput;
+        size_t mInputSize;
+        size_t mInputOffset = Detail::kHeaderSize;
+        unsigned int mControlByte = 0;
+        unsigned int mControlBits = 0;
+        size_t mProduced = 0;
+        size_t mReferenceRemaining = 0;
+        size_t mReferencePos = 0;
+        bool mZeroReference = false;
+        std::vector<unsigned char> mWindow = std::vector<unsigned char>(Detail::kWindowSize);
+    };
+
+    enum class eCompressionMode
+    {
+        eFast,      // Checks only a few recent candidates for each match
+        eMaxRatio   // Checks every candidate in the window and defers matches when the next byte has a longer one
+    };
+
+    namespace Detail
+    {
+        const unsigned int kHashBits = 13;
+        const size_t kNoPosition = static_cast<size_t>(-1);
+
+        // Hash chains over the window, each position links to the previous one with the same 3 byte prefix
+        class MatchFinder
+        {
+        public:
+            MatchFinder(const unsigned char* data, size_t size)
+                : mData(data),
+                  mSize(size),
+                  mHead(size_t(1) << kHashBits, kNoPosition),
+                  mPrev(kWindowSize, kNoPosition)
+            {
+
+            }
+
+            MatchFinder(const MatchFinder&) = delete;
+            MatchFinder& operator = (const MatchFinder&) = delete;
+
+            void Insert(size_t pos)
+            {
+                if (mSize - pos < kMinReferenceLength)
+                {
+                    return;
+                }
+                const unsigned int hash = Hash(pos);
+                mPrev[pos & kWindowMask] = mHead[hash];
+                mHead[hash] = pos;
+            }
+
+            // Returns the length of the longest match for pos that was found, or 0 if there isn't one of at least kMinReferenceLength
+            size_t Find(size_t pos, unsigned int maxCandidates, size_t& distance) const
+            {
+                const size_t maxLength = std::min<size_t>(kMaxReferenceLength, mSize - pos);
+                if (maxLength < kMinReferenceLength)
+                {
+                    return 0;
+                }
+
+                size_t bestLength = 0;
+                size_t candidate = mHead[Hash(pos)];
+                // A distance of 0 can't be encoded since it means "read zeros", so the window is one byte short
+                while (candidate != kNoPosition && pos - candidate < kWindowSize && maxCandidates-- > 0)
+                {
+                    // The end byte is checked first as it must be beaten for the candidate to be any use
+                    if (mData[candidate + bestLength] == mData[pos + bestLength])
+                    {
+                        size_t length = 0;
+                        while (length < maxLength && mData[candidate + length] == mData[pos + length])
+                        {
+                            length++;
+                        }
+                        if (length > bestLength)
+                        {
+                            bestLength = length;
+                            distance = pos - candidate;
+                            if (length == maxLength)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                    candidate = mPrev[candidate & kWindowMask];
+                }
+                return bestLength >= kMinReferenceLength ? bestLength : 0;
+            }
+
+        private:
+            unsigned int Hash(size_t pos) const
+            {
+                const unsigned int value = mData[pos] | (mData[pos + 1] << 8) | (mData[pos + 2] << 16);
+                return (value * 2654435761u) >> (32 - kHashBits);
+            }
+
+            const unsigned char* mData;
+            size_t mSize;
+            std::vector<size_t> mHead;
+            std::vector<size_t> mPrev;
+        };
+
+        // Writes items grouped in to blocks of 8 behind a control byte
+        class BlockWriter
+        {
+        public:
+            BlockWriter(std::vector<unsigned char>& output)
+                : mOutput(output)
+            {
+
+            }
+
+            void Literal(unsigned char value)
+            {
+                Next(true);
+                mOutput.push_back(value);
+            }
+
+            void Reference(size_t outputOffset, size_t distance, size_t length)
+            {
+                Next(false);
+                const size_t referenceOffset = (outputOffset - kWindowBias - distance) & kWindowMask;
+                mOutput.push_back(static_cast<unsigned char>(referenceOffset & 0xFF));
+                mOutput.push_back(static_cast<unsigned char>(((referenceOffset >> 4) & 0xF0) | (length - kMinReferenceLength)));
+            }
+
+        private:
+            void Next(bool isLiteral)
+            {
+                if (mControlBit == 8)
+                {
+                    mControlPos = mOutput.size();
+                    mOutput.push_back(0);
+                    mControlBit = 0;
+                }
+                if (isLiteral)
+                {
+                    mOutput[mControlPos] |= 1 << mControlBit;
+                }
+                mControlBit++;
+            }
+
+            std::vector<unsigned char>& mOutput;
+            size_t mControlPos = 0;
+            unsigned int mControlBit = 8;
+        };
+    }
+
+    /*
+    * Compresses data in to an LZS stream that Decompress turns back in to the same bytes.
+    */
+    inline std::vector<unsigned char> Compress(const unsigned char* data, size_t size, eCompressionMode mode = eCompressionMode::eMaxRatio)
+    {
+        using namespace Detail;
+
+        const bool maxRatio = mode == eCompressionMode::eMaxRatio;
+        const unsigned int maxCandidates = maxRatio ? static_cast<unsigned int>(kWindowSize) : 8;
+
+        // Worst case is all literals, which is 9 bytes for every 8
+        std::vector<unsigned char> output(kHeaderSize);
+        output.reserve(kHeaderSize + size + (size + 7) / 8);
+
+        MatchFinder finder(data, size);
+        BlockWriter writer(output);
+        size_t pos = 0;
+        while (pos < size)
+        {
+            size_t distance = 0;
+            size_t length = finder.Find(pos, maxCandidates, distance);
+
+            if (length > 0 && length < kMaxReferenceLength && maxRatio)
+            {
+                // Lazy matching, if the next byte starts a longer match then this byte is better off as a literal
+                finder.Insert(pos);
+                size_t nextDistance = 0;
+                if (finder.Find(pos + 1, maxCandidates, nextDistance) > length)
+                {
+                    writer.Literal(data[pos]);
+                    pos++;
+                    continue;
+                }
+            }
+            else
+            {
+                finder.Insert(pos);
+            }
+
+            if (length == 0)
+            {
+                writer.Literal(data[pos]);
+                pos++;
+                continue;
+            }
+
+            writer.Reference(pos, distance, length);
+            for (size_t i = 1; i < length; i++)
+            {
+                finder.Insert(pos + i);
+            }
+            pos += length;
         }
 
-        // Truncate to exact size
-        extract_buffer.resize(output_offset);
-        return extract_buffer;
+        const size_t compressedSize = output.size() - kHeaderSize;
+        for (size_t i = 0; i < kHeaderSize; i++)
+        {
+            output[i] = static_cast<unsigned char>(compressedSize >> (i * 8));
+        }
+        return output;
+    }
+
+    inline std::vector<unsigned char> Compress(const std::vector<unsigned char>& data, eCompressionMode mode = eCompressionMode::eMaxRatio)
+    {
+        return Compress(data.data(), data.size(), mode);
     }
 }
@@ -0,0 +1,65 @@
+#include "mappedfile.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& fileName)
+    : mBuffer()
+{
+#ifdef POSIX
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Can't open file");
+    }
+
+    struct stat info = {};
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void* mapping = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            mMapping = mapping;
+            mData = static_cast<const unsigned char*>(mapping);
+            mSize = static_cast<size_t>(info.st_size);
+        }
+    }
+    ::close(fd);
+
+    if (mMapping)
+    {
+        return;
+    }
+#endif
+    ReadBuffered(fileName);
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef POSIX
+    if (mMapping)
+    {
+        ::munmap(mMapping, mSize);
+    }
+#endif
+}
+
+void MappedFile::ReadBuffered(const std::string& fileName)
+{
+    // Read as a stream rather than seeking to the end, as non regular files can't report their size
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Can't open file");
+    }
+    mBuffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Read only view of a whole file. Regular files are memory mapped so that no copy
+// of the data is made, anything that can't be mapped (pipes, devices, empty files
+// or platforms without mmap) falls back to a buffered read.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& fileName);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    const unsigned char* Data() const
+    {
+        return mData;
+    }
+
+    size_t Size() const
+    {
+        return mSize;
+    }
+
+    bool IsMapped() const
+    {
+        return mMapping != nullptr;
+    }
+
+private:
+    void ReadBuffered(const std::string& fileName);
+
+    void* mMapping = nullptr;
+    std::vector<unsigned char> mBuffer;
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+};
@@ -0,0 +1,106 @@
+#include "arena.h"
+#include "refcounted.h"
+#include <algorithm>
+#include <atomic>
+
+thread_local Arena* Arena::tCurrent = nullptr;
+
+static std::atomic<bool> gArenaEnabled(true);
+
+// Every allocation is rounded up to this so objects stay suitably aligned
+static const size_t kAlignment = alignof(std::max_align_t);
+
+Arena::Arena(size_t initialChunkSize, size_t maxChunkSize)
+    : mChunkSize(initialChunkSize), mMaxChunkSize(maxChunkSize)
+{
+
+}
+
+Arena::~Arena()
+{
+    // Destroy in reverse creation order, like the stack unwinding of ordinary objects. Any
+    // reference these release to another arena object is a no-op.
+    for (auto it = mObjects.rbegin(); it != mObjects.rend(); ++it)
+    {
+        (*it)->~RefCounted();
+    }
+}
+
+Arena::Scope::Scope(Arena* arena)
+    : mPrevious(tCurrent)
+{
+    tCurrent = arena;
+}
+
+Arena::Scope::~Scope()
+{
+    tCurrent = mPrevious;
+}
+
+bool Arena::Enabled()
+{
+    return gArenaEnabled;
+}
+
+void Arena::SetEnabled(bool enabled)
+{
+    gArenaEnabled = enabled;
+}
+
+void* Arena::Allocate(size_t size)
+{
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (static_cast<size_t>(mEnd - mPos) < size)
+    {
+        NewChunk(size);
+    }
+    void* ptr = mPos;
+    mPos += size;
+    mBytesAllocated += size;
+    return ptr;
+}
+
+void Arena::NewChunk(size_t minSize)
+{
+    const size_t size = std::max(minSize, mChunkSize);
+    mChunkSize = std::min(mChunkSize * 2, mMaxChunkSize);
+    mChunks.emplace_back(new unsigned char[size]);
+    mPos = mChunks.back().get();
+    mEnd = mPos + size;
+    mChunkRanges.emplace_back(mPos, mEnd);
+}
+
+bool Arena::Owns(const void* ptr) const
+{
+    // Objects being constructed are normally in the newest chunk, so search from the back
+    const unsigned char* p = static_cast<const unsigned char*>(ptr);
+    for (auto range = mChunkRanges.rbegin(); range != mChunkRanges.rend(); ++range)
+    {
+        if (p >= range->first && p < range->second)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Arena::Forget(const void* ptr)
+{
+    // Evaluating a constructor's arguments can throw before the object is claimed
+    auto unclaimed = std::find(mUnclaimed.begin(), mUnclaimed.end(), ptr);
+    if (unclaimed != mUnclaimed.end())
+    {
+        mUnclaimed.erase(unclaimed);
+        return;
+    }
+
+    // Normally the most recent object, so search from the back
+    for (auto it = mObjects.rbegin(); it != mObjects.rend(); ++it)
+    {
+        if (*it == ptr)
+        {
+            mObjects.erase(std::next(it).base());
+            return;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+class RefCounted;
+
+/**
+ * Monotonic allocator for the RefCounted objects (instructions, values and groups) of a
+ * single decompilation. While an Arena::Scope is active on a thread, RefCounted objects
+ * created with new on that thread are carved out of the arena's chunks and are never
+ * reference counted or deleted individually. They are all destroyed, and their memory
+ * released, when the arena is destroyed.
+ *
+ * Nothing allocated in an arena may outlive it, so only use one where every InstPtr,
+ * ValuePtr and GroupPtr has a known lifetime, such as SUDM::FF7::Field::Decompile.
+ */
+class Arena
+{
+public:
+    // Chunks start at initialChunkSize and double up to maxChunkSize, so small scripts stay cheap
+    explicit Arena(size_t initialChunkSize = 4 * 1024, size_t maxChunkSize = 256 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator = (const Arena&) = delete;
+
+    /**
+     * Installs an arena as the current one for this thread until the scope ends. A null
+     * arena turns arena allocation off for the scope.
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(Arena* arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator = (const Scope&) = delete;
+    private:
+        Arena* mPrevious;
+    };
+
+    static Arena* Current()
+    {
+        return tCurrent;
+    }
+
+    // Whether SUDM::FF7::Field::Decompile uses an arena, on by default
+    static bool Enabled();
+    static void SetEnabled(bool enabled);
+
+    void* Allocate(size_t size);
+    bool Owns(const void* ptr) const;
+
+    // Total bytes handed out, and the number of objects the arena will destroy
+    size_t BytesAllocated() const { return mBytesAllocated; }
+    size_t ObjectCount() const { return mObjects.size(); }
+
+    /**
+     * Called by operator new for RefCounted, allocates from the current arena and notes the
+     * object as unclaimed, so the RefCounted constructor can recognise it with Claim however
+     * allocations and constructors of nested new expressions interleave.
+     */
+    static void* AllocateObject(size_t size)
+    {
+        void* obj = tCurrent->Allocate(size);
+        tCurrent->mUnclaimed.push_back(obj);
+        return obj;
+    }
+
+    /**
+     * Called by the RefCounted constructor, returns true if the object was allocated by
+     * AllocateObject, in which case the arena takes ownership of it. Objects on the stack or
+     * embedded in others weren't allocated as themselves, so stay reference counted.
+     */
+    static bool Claim(RefCounted* obj)
+    {
+        if (!tCurrent)
+        {
+            return false;
+        }
+        // Only the new expressions being evaluated have unclaimed objects, the latest normally being this one
+        std::vector<const void*>& unclaimed = tCurrent->mUnclaimed;
+        for (auto it = unclaimed.rbegin(); it != unclaimed.rend(); ++it)
+        {
+            if (*it == obj)
+            {
+                unclaimed.erase(std::next(it).base());
+                tCurrent->mObjects.push_back(obj);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Called when a new expression throws. If the arena took ownership the object's base
+     * destructor has already run, so the arena must not destroy it again.
+     */
+    void Forget(const void* ptr);
+
+private:
+    void NewChunk(size_t minSize);
+
+    static thread_local Arena* tCurrent;
+
+    size_t mChunkSize;
+    const size_t mMaxChunkSize;
+    std::vector<std::unique_ptr<unsigned char[]>> mChunks;
+    std::vector<std::pair<const unsigned char*, const unsigned char*>> mChunkRanges;
+    unsigned char* mPos = nullptr;
+    unsigned char* mEnd = nullptr;
+    size_t mBytesAllocated = 0;
+    std::vector<RefCounted*> mObjects;
+    std::vector<const void*> mUnclaimed; // Allocated by AllocateObject, not yet constructed
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal timing harness for the Sudm_Benchmark executable, each BENCHMARK body
+// times whatever it wants with Benchmark::Time and prints its own results.
+namespace Benchmark
+{
+    struct Case
+    {
+        std::string mName;
+        std::function<void()> mFunc;
+    };
+
+    std::vector<Case>& Registry();
+
+    struct Registrar
+    {
+        Registrar(const char* name, std::function<void()> func)
+        {
+            Registry().push_back({ name, func });
+        }
+    };
+
+    // Runs func repeatedly for at least minSeconds and returns the mean seconds per call
+    template<class TFunc>
+    double Time(TFunc func, double minSeconds = 0.25)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+        size_t iterations = 0;
+        const auto start = Clock::now();
+        std::chrono::duration<double> elapsed(0);
+        do
+        {
+            func();
+            iterations++;
+            elapsed = Clock::now() - start;
+        } while (elapsed.count() < minSeconds);
+        return elapsed.count() / iterations;
+    }
+
+    // Heap allocations made through operator new since the program started
+    struct Allocations
+    {
+        size_t mCount;
+        size_t mBytes;
+    };
+    Allocations AllocationsSoFar();
+
+    // Prints a single result line, throughput is only shown when bytesPerCall is non zero
+    void Report(const std::string& label, double secondsPerCall, size_t bytesPerCall = 0);
+
+    // Prints how much faster candidate is than baseline
+    void ReportSpeedup(const std::string& label, double baselineSeconds, double candidateSeconds);
+
+    // Prints the allocations made between before and after
+    void ReportAllocations(const std::string& label, const Allocations& before, const Allocations& after);
+}
+
+#define BENCHMARK(name) \
+    static void Benchmark_##name(); \
+    static Benchmark::Registrar sBenchmarkRegistrar_##name(#name, Benchmark_##name); \
+    static void Benchmark_##name()
@@ -0,0 +1,335 @@
+#include "benchmark.h"
+#include "binaryreader.h"
+#include "lzs.h"
+#include "decompiler/control_flow.h"
+#include "decompiler/ff7_field/ff7_field_engine.h"
+#include "decompiler/scummv6/engine.h"
+#include "sudm.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // The script section of a field file, as passed to SUDM::FF7::Field::Decompile
+    std::vector<unsigned char> ScriptSection(const char* file)
+    {
+        auto scriptBytes = Lzs::Decompress(BinaryReader::ReadAll(file));
+        const int kNumSections = 7;
+        scriptBytes.erase(scriptBytes.begin(), scriptBytes.begin() + kNumSections * sizeof(uint32));
+        return scriptBytes;
+    }
+
+    // What the field decompiler builds for every script
+    template<class TGraph>
+    size_t CreateGroups(InstVec& insts, Engine& engine)
+    {
+        BasicControlFlow<TGraph> controlFlow(insts, engine);
+        controlFlow.createGroups();
+        return num_vertices(controlFlow.getGraph());
+    }
+
+    template<class TGraph>
+    size_t Analyze(InstVec& insts, Engine& engine)
+    {
+        BasicControlFlow<TGraph> controlFlow(insts, engine);
+        controlFlow.createGroups();
+        return num_vertices(controlFlow.analyze());
+    }
+
+    // Scummv6 bytecode of made up scripts, far bigger than the test ones
+    class SyntheticScript
+    {
+    public:
+        // var0 = 1
+        void Statement()
+        {
+            Condition();
+            mBytes.insert(mBytes.end(), { 0x43, 0x00, 0x00 });
+        }
+
+        // if (1) { then } else { otherwise }
+        template<typename TThen, typename TElse>
+        void IfElse(TThen then, TElse otherwise)
+        {
+            Condition();
+            const size_t toElse = Jump(kJumpFalse);
+            then();
+            const size_t toEnd = Jump(kJump);
+            Patch(toElse, mBytes.size());
+            otherwise();
+            Patch(toEnd, mBytes.size());
+        }
+
+        // while (1) { body if (1) break; }
+        template<typename TBody>
+        void WhileWithBreak(TBody body)
+        {
+            const size_t top = mBytes.size();
+            Condition();
+            const size_t toEnd = Jump(kJumpFalse);
+            body();
+            Condition();
+            const size_t skipBreak = Jump(kJumpFalse);
+            const size_t toBreak = Jump(kJump);
+            Patch(skipBreak, mBytes.size());
+            Patch(Jump(kJump), top);
+            Patch(toEnd, mBytes.size());
+            Patch(toBreak, mBytes.size());
+        }
+
+        // do { body } while (1)
+        template<typename TBody>
+        void DoWhile(TBody body)
+        {
+            const size_t top = mBytes.size();
+            body();
+            Condition();
+            Patch(Jump(kJumpTrue), top);
+        }
+
+        // Ends the script and disassembles it
+        void Disassemble(Engine& engine, InstVec& insts)
+        {
+            mBytes.push_back(kStopObjectCode);
+            const char* file = "sudm_benchmark.dmp";
+            {
+                // A global script block, whose size the disassembler skips
+                std::ofstream out(file, std::ios::binary | std::ios::trunc);
+                out.write("SCRP\0\0\0\0", 8);
+                out.write(reinterpret_cast<const char*>(mBytes.data()), mBytes.size());
+            }
+            auto disassembler = engine.getDisassembler(insts);
+            disassembler->open(file);
+            disassembler->disassemble();
+            std::remove(file);
+        }
+
+        size_t Size() const { return mBytes.size(); }
+
+    private:
+        static const unsigned char kJump = 0x73;
+        static const unsigned char kJumpTrue = 0x5C;
+        static const unsigned char kJumpFalse = 0x5D;
+        static const unsigned char kStopObjectCode = 0x65;
+
+        // push 1
+        void Condition()
+        {
+            mBytes.insert(mBytes.end(), { 0x00, 0x01 });
+        }
+
+        size_t Jump(unsigned char opcode)
+        {
+            mBytes.insert(mBytes.end(), { opcode, 0x00, 0x00 });
+            return mBytes.size() - 3;
+        }
+
+        // Jumps are relative to the end of the jump, and no further than an int16 reaches
+        void Patch(size_t jump, size_t destination)
+        {
+            const long offset = static_cast<long>(destination) - static_cast<long>(jump + 3);
+            assert(offset >= INT16_MIN && offset <= INT16_MAX);
+            mBytes[jump + 1] = static_cast<unsigned char>(offset & 0xFF);
+            mBytes[jump + 2] = static_cast<unsigned char>((offset >> 8) & 0xFF);
+        }
+
+        std::vector<unsigned char> mBytes;
+    };
+
+    // One construct after another, each a few blocks, as in most scripts
+    void Sequence(SyntheticScript& script, int constructs)
+    {
+        for (int i = 0; i < constructs; i++)
+        {
+            switch (i % 3)
+            {
+            case 0:
+                script.IfElse([&]() { script.Statement(); }, [&]() { script.Statement(); });
+                break;
+            case 1:
+                script.WhileWithBreak([&]() { script.Statement(); });
+                break;
+            default:
+                script.DoWhile([&]() { script.Statement(); });
+                break;
+            }
+        }
+    }
+
+    // Loops and ifs, each inside the next, depth deep
+    void Tower(SyntheticScript& script, int depth)
+    {
+        if (depth == 0)
+        {
+            script.Statement();
+            return;
+        }
+        switch (depth % 3)
+        {
+        case 0:
+            script.WhileWithBreak([&]() { script.Statement(); Tower(script, depth - 1); });
+            break;
+        case 1:
+            script.IfElse([&]() { Tower(script, depth - 1); }, [&]() { script.Statement(); });
+            break;
+        default:
+            script.DoWhile([&]() { Tower(script, depth - 1); script.Statement(); });
+            break;
+        }
+    }
+
+    // Times both analyses of a script, each on a graph fresh from createGroups
+    void CompareAnalyses(const std::string& label, SyntheticScript& script)
+    {
+        Scumm::v6::Scummv6Engine engine;
+        InstVec insts;
+        script.Disassemble(engine, insts);
+        std::cout << "  " << label << " (" << CreateGroups<Graph>(insts, engine) << " groups)" << std::endl;
+
+        const double groupSeconds = Benchmark::Time([&]() { CreateGroups<Graph>(insts, engine); });
+        const double walkSeconds = Benchmark::Time([&]()
+        {
+            ControlFlow controlFlow(insts, engine);
+            controlFlow.createGroups();
+            controlFlow.analyze();
+        });
+        const double dominatorSeconds = Benchmark::Time([&]()
+        {
+            ControlFlow controlFlow(insts, engine);
+            controlFlow.createGroups();
+            controlFlow.analyzeWithDominators();
+        });
+        Benchmark::Report("analyze", walkSeconds - groupSeconds);
+        Benchmark::Report("analyzeWithDominators", dominatorSeconds - groupSeconds);
+        Benchmark::ReportSpeedup("speedup", walkSeconds - groupSeconds, dominatorSeconds - groupSeconds);
+    }
+}
+
+BENCHMARK(ControlFlowFF7Field)
+{
+    const char* file = "decompiler/test/ff7_all_opcodes_by_category.dat";
+    const std::vector<unsigned char> scriptBytes = ScriptSection(file);
+    SUDM::IScriptFormatter formatter;
+    FF7::FF7FieldEngine engine(formatter, "benchmark");
+    InstVec insts;
+    engine.getDisassembler(insts, scriptBytes)->disassemble();
+    std::cout << "  " << file << " (" << insts.size() << " instructions, "
+        << CreateGroups<Graph>(insts, engine) << " groups)" << std::endl;
+
+    const double boostSeconds = Benchmark::Time([&]() { CreateGroups<BoostGraph>(insts, engine); });
+    Benchmark::Report("create groups, adjacency_list", boostSeconds);
+    const double flatSeconds = Benchmark::Time([&]() { CreateGroups<Graph>(insts, engine); });
+    Benchmark::Report("create groups, FlatGraph", flatSeconds);
+    Benchmark::ReportSpeedup("speedup", boostSeconds, flatSeconds);
+
+    auto before = Benchmark::AllocationsSoFar();
+    CreateGroups<BoostGraph>(insts, engine);
+    auto after = Benchmark::AllocationsSoFar();
+    Benchmark::ReportAllocations("create groups, adjacency_list", before, after);
+    before = Benchmark::AllocationsSoFar();
+    CreateGroups<Graph>(insts, engine);
+    after = Benchmark::AllocationsSoFar();
+    Benchmark::ReportAllocations("create groups, FlatGraph", before, after);
+}
+
+BENCHMARK(ControlFlowScummv6)
+{
+    const char* scripts[] =
+    {
+        "branches", "break-do-while", "break-do-while2", "break-while", "continue-do-while", "continue-do-while2",
+        "continue-while", "do-while-in-while", "do-while", "if-else", "if-no-else", "if", "nested-do-while", "nested-while",
+        "nested-while2", "short-circuit", "unreachable", "while-in-do-while", "while-in-do-while2", "while"
+    };
+
+    // Every test script, analyzed one after another
+    Scumm::v6::Scummv6Engine engine;
+    std::vector<InstVec> scriptInsts;
+    for (const char* script : scripts)
+    {
+        scriptInsts.push_back(InstVec());
+        auto disassembler = engine.getDisassembler(scriptInsts.back());
+        disassembler->open((std::string("decompiler/test/") + script + ".dmp").c_str());
+        disassembler->disassemble();
+    }
+    std::cout << "  " << scriptInsts.size() << " scripts from decompiler/test" << std::endl;
+
+    const double boostSeconds = Benchmark::Time([&]()
+    {
+        for (auto& insts : scriptInsts)
+        {
+            Analyze<BoostGraph>(insts, engine);
+        }
+    });
+    Benchmark::Report("analyze, adjacency_list", boostSeconds);
+    const double flatSeconds = Benchmark::Time([&]()
+    {
+        for (auto& insts : scriptInsts)
+        {
+            Analyze<Graph>(insts, engine);
+        }
+    });
+    Benchmark::Report("analyze, FlatGraph", flatSeconds);
+    Benchmark::ReportSpeedup("speedup", boostSeconds, flatSeconds);
+}
+
+BENCHMARK(ControlFlowSynthetic)
+{
+    // Growing scripts of small constructs
+    for (int constructs : { 300, 3000, 12000 })
+    {
+        SyntheticScript script;
+        Sequence(script, constructs);
+        CompareAnalyses(std::to_string(constructs) + " constructs in sequence", script);
+    }
+
+    // About as many groups each time, nested ever deeper. Jumps only reach 32KB, so deep nests are repeated.
+    for (int depth : { 30, 300, 1500 })
+    {
+        SyntheticScript script;
+        const int towers = 30000 / depth;
+        for (int i = 0; i < towers; i++)
+        {
+            Tower(script, depth);
+        }
+        CompareAnalyses(std::to_string(towers) + " nests " + std::to_string(depth) + " deep", script);
+    }
+}
+
+BENCHMARK(CodeGenerationSynthetic)
+{
+    // Code generation walks every group once, carrying the value stack along each edge
+    for (int constructs : { 300, 3000, 12000 })
+    {
+        SyntheticScript script;
+        Sequence(script, constructs);
+        Scumm::v6::Scummv6Engine engine;
+        InstVec insts;
+        script.Disassemble(engine, insts);
+        ControlFlow controlFlow(insts, engine);
+        controlFlow.createGroups();
+        const Graph& g = controlFlow.analyzeWithDominators();
+        std::cout << "  " << constructs << " constructs in sequence (" << num_vertices(g) << " groups)" << std::endl;
+
+        std::ostringstream output;
+        auto generate = [&]()
+        {
+            // Groups keep the lines generated for them, so start each run without the last run's
+            VertexRange vr = vertices(g);
+            for (VertexIterator v = vr.first; v != vr.second; ++v)
+            {
+                get(boost::vertex_name, g, *v)->_code.clear();
+            }
+            output.str(std::string());
+            engine.getCodeGenerator(insts, output)->generate(insts, g);
+        };
+        Benchmark::Report("generate", Benchmark::Time(generate));
+        const auto before = Benchmark::AllocationsSoFar();
+        generate();
+        const auto after = Benchmark::AllocationsSoFar();
+        Benchmark::ReportAllocations("generate", before, after);
+    }
+}
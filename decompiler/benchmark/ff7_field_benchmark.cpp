@@ -0,0 +1,346 @@
+#include "benchmark.h"
+#include "binaryreader.h"
+#include "lzs.h"
+#include "decompiler/ff7_field/ff7_field_engine.h"
+#include "decompiler/ff7_field/ff7_field_disassembler.h"
+#include "decompiler/arena.h"
+#include "sudm.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    // The script section of a field file, as passed to SUDM::FF7::Field::Decompile
+    std::vector<unsigned char> ScriptSection(const char* file)
+    {
+        auto scriptBytes = Lzs::Decompress(BinaryReader::ReadAll(file));
+        const int kNumSections = 7;
+        scriptBytes.erase(scriptBytes.begin(), scriptBytes.begin() + kNumSections * sizeof(uint32));
+        return scriptBytes;
+    }
+
+    size_t Disassemble(const std::vector<unsigned char>& scriptBytes)
+    {
+        SUDM::IScriptFormatter formatter;
+        FF7::FF7FieldEngine engine(formatter, "benchmark");
+        InstVec insts;
+        engine.getDisassembler(insts, scriptBytes)->disassemble();
+        return insts.size();
+    }
+
+    // Disassembles without materializing Instruction objects, returns the bytes used by the store
+    size_t DisassembleToStore(const std::vector<unsigned char>& scriptBytes)
+    {
+        SUDM::IScriptFormatter formatter;
+        FF7::FF7FieldEngine engine(formatter, "benchmark");
+        InstVec insts;
+        FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+        disassembler.DisassembleToStore();
+        return disassembler.Store().MemoryUsage();
+    }
+}
+
+BENCHMARK(FF7FieldDisassemble)
+{
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat"
+    };
+    for (const char* file : files)
+    {
+        const std::vector<unsigned char> scriptBytes = ScriptSection(file);
+        const size_t instructions = Disassemble(scriptBytes);
+        const double seconds = Benchmark::Time([&]() { Disassemble(scriptBytes); });
+
+        std::cout << "  " << file << " (" << instructions << " instructions)" << std::endl;
+        Benchmark::Report("disassemble", seconds);
+        Benchmark::Report("per instruction", seconds / instructions);
+
+        size_t storeBytes = 0;
+        const double storeSeconds = Benchmark::Time([&]() { storeBytes = DisassembleToStore(scriptBytes); });
+        Benchmark::Report("disassemble to store only", storeSeconds);
+        Benchmark::ReportSpeedup("store only speedup", seconds, storeSeconds);
+
+        auto before = Benchmark::AllocationsSoFar();
+        Disassemble(scriptBytes);
+        auto after = Benchmark::AllocationsSoFar();
+        Benchmark::ReportAllocations("disassemble to Instruction objects", before, after);
+
+        before = Benchmark::AllocationsSoFar();
+        DisassembleToStore(scriptBytes);
+        after = Benchmark::AllocationsSoFar();
+        Benchmark::ReportAllocations("disassemble to store only", before, after);
+        std::cout << "  store holds " << storeBytes << " bytes, "
+            << static_cast<double>(storeBytes) / instructions << " per instruction" << std::endl;
+    }
+}
+
+BENCHMARK(FF7FieldScriptInfo)
+{
+    const char* file = "decompiler/test/ff7_all_opcodes_by_category.dat";
+    const std::vector<unsigned char> scriptBytes = ScriptSection(file);
+    std::cout << "  " << file << std::endl;
+
+    // What ScaleFactor used to do, make a disassembler to read the header
+    float scale = 0.0f;
+    const double disassemblerSeconds = Benchmark::Time([&]()
+    {
+        SUDM::IScriptFormatter formatter;
+        FF7::FF7FieldEngine engine(formatter, "benchmark");
+        InstVec insts;
+        FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+        scale += disassembler.ScaleFactor();
+    });
+    Benchmark::Report("scale from FF7Disassembler", disassemblerSeconds);
+
+    const double infoSeconds = Benchmark::Time([&]() { scale += SUDM::FF7::Field::ScaleFactor(scriptBytes); });
+    Benchmark::Report("scale from FieldScriptInfo", infoSeconds);
+    Benchmark::ReportSpeedup("speedup", disassemblerSeconds, infoSeconds);
+
+    const auto before = Benchmark::AllocationsSoFar();
+    scale += SUDM::FF7::Field::ScaleFactor(scriptBytes);
+    const auto after = Benchmark::AllocationsSoFar();
+    Benchmark::ReportAllocations("scale from FieldScriptInfo", before, after);
+
+    unsigned int entryPoints = 0;
+    const double tablesSeconds = Benchmark::Time([&]()
+    {
+        const SUDM::FF7::Field::FieldScriptInfo info(scriptBytes);
+        for (unsigned int entity = 0; entity < info.NumEntities(); entity++)
+        {
+            entryPoints += static_cast<unsigned int>(info.EntityName(entity).size());
+            for (unsigned int script = 0; script < SUDM::FF7::Field::FieldScriptInfo::kScriptsPerEntity; script++)
+            {
+                entryPoints += info.ScriptEntryPoint(entity, script);
+            }
+        }
+    });
+    Benchmark::Report("names and entry points of every entity", tablesSeconds);
+
+    // A catalogue of every field, as pipeline tools build it
+    const int kFields = 1000;
+    size_t catalogueBytes = 0;
+    const double catalogueSeconds = Benchmark::Time([&]()
+    {
+        for (int i = 0; i < kFields; i++)
+        {
+            const SUDM::FF7::Field::FieldScriptInfo info(scriptBytes);
+            catalogueBytes += info.Name().size() + info.Creator().size() + info.OffsetToStrings() + info.NumAkaoOffsets();
+            for (unsigned int entity = 0; entity < info.NumEntities(); entity++)
+            {
+                catalogueBytes += info.EntityName(entity).size();
+            }
+        }
+    });
+    Benchmark::Report(std::to_string(kFields) + " field catalogue entries", catalogueSeconds);
+}
+
+BENCHMARK(FF7FieldDecompileArena)
+{
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat"
+    };
+    for (const char* file : files)
+    {
+        const std::vector<unsigned char> scriptBytes = ScriptSection(file);
+        SUDM::IScriptFormatter formatter;
+        auto decompile = [&]() { SUDM::FF7::Field::Decompile("benchmark", scriptBytes, formatter, "", ""); };
+        std::cout << "  " << file << std::endl;
+
+        Arena::SetEnabled(false);
+        const double heapSeconds = Benchmark::Time(decompile);
+        auto before = Benchmark::AllocationsSoFar();
+        decompile();
+        auto after = Benchmark::AllocationsSoFar();
+        Benchmark::Report("decompile, heap", heapSeconds);
+        Benchmark::ReportAllocations("decompile, heap", before, after);
+
+        Arena::SetEnabled(true);
+        const double arenaSeconds = Benchmark::Time(decompile);
+        before = Benchmark::AllocationsSoFar();
+        decompile();
+        after = Benchmark::AllocationsSoFar();
+        Benchmark::Report("decompile, arena", arenaSeconds);
+        Benchmark::ReportAllocations("decompile, arena", before, after);
+        Benchmark::ReportSpeedup("arena speedup", heapSeconds, arenaSeconds);
+    }
+}
+
+BENCHMARK(FF7FieldDecompileBatch)
+{
+    // Stand in for a whole FLEVEL, the test fields repeated
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat"
+    };
+    SUDM::IScriptFormatter formatter;
+    std::vector<SUDM::FF7::Field::DecompileJob> jobs;
+    for (int copy = 0; copy < 32; copy++)
+    {
+        for (const char* file : files)
+        {
+            jobs.push_back({ file, ScriptSection(file), &formatter, "", "" });
+        }
+    }
+
+    const double serialSeconds = Benchmark::Time([&]()
+    {
+        for (const auto& job : jobs)
+        {
+            SUDM::FF7::Field::Decompile(job.scriptName, job.scriptBytes, *job.formatter);
+        }
+    });
+    Benchmark::Report(std::to_string(jobs.size()) + " scripts, Decompile in a loop", serialSeconds);
+
+    const unsigned int threads = std::thread::hardware_concurrency();
+    const double batchSeconds = Benchmark::Time([&]() { SUDM::FF7::Field::DecompileBatch(jobs); });
+    Benchmark::Report(std::to_string(jobs.size()) + " scripts, DecompileBatch on " + std::to_string(threads) + " threads", batchSeconds);
+    Benchmark::ReportSpeedup("batch speedup", serialSeconds, batchSeconds);
+}
+
+BENCHMARK(FF7FieldDecompileEntitiesParallel)
+{
+    // One script at a time, as for a hot reload, with its entities shared out between threads
+    const char* file = "decompiler/test/ff7_all_opcodes_by_category.dat";
+    const auto scriptBytes = ScriptSection(file);
+    SUDM::IScriptFormatter formatter;
+    const int kIterations = 20;
+
+    const double serialSeconds = Benchmark::Time([&]()
+    {
+        for (int i = 0; i < kIterations; i++)
+        {
+            SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1);
+        }
+    });
+    Benchmark::Report(std::to_string(kIterations) + " decompiles on 1 thread", serialSeconds);
+
+    const unsigned int threads = std::thread::hardware_concurrency();
+    const double parallelSeconds = Benchmark::Time([&]()
+    {
+        for (int i = 0; i < kIterations; i++)
+        {
+            SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 0);
+        }
+    });
+    Benchmark::Report(std::to_string(kIterations) + " decompiles on " + std::to_string(threads) + " threads", parallelSeconds);
+    Benchmark::ReportSpeedup("entity speedup", serialSeconds, parallelSeconds);
+}
+
+BENCHMARK(FF7FieldDecompileIncremental)
+{
+    // A hot reload after editing one function: only that function misses the cache
+    const char* file = "decompiler/test/ff7_all_opcodes_by_category.dat";
+    const auto scriptBytes = ScriptSection(file);
+    SUDM::IScriptFormatter formatter;
+    std::cout << "  " << file << std::endl;
+
+    const double fullSeconds = Benchmark::Time([&]() { SUDM::FF7::Field::Decompile(file, scriptBytes, formatter); });
+    Benchmark::Report("decompile without a cache", fullSeconds);
+
+    SUDM::FF7::Field::FunctionCache cache;
+    const double coldSeconds = Benchmark::Time([&]()
+    {
+        cache.Clear();
+        SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, &cache);
+    });
+    Benchmark::Report("decompile filling an empty cache", coldSeconds);
+
+    const double warmSeconds = Benchmark::Time([&]() { SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, &cache); });
+    Benchmark::Report("decompile with every function cached", warmSeconds);
+    Benchmark::ReportSpeedup("cached speedup", fullSeconds, warmSeconds);
+
+    // Give a WAIT a new length each run, so exactly its function misses the cache as if just edited
+    InstVec insts;
+    FF7::FF7FieldEngine engine(formatter, "benchmark");
+    FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+    disassembler.disassemble();
+    auto wait = std::find_if(insts.begin(), insts.end(), [](const InstPtr& inst) { return inst->_opcode == FF7::eOpcodes::WAIT; });
+    const size_t waitParam = (*wait)->_address + 1;
+    auto edited = scriptBytes;
+    uint16 waitFrames = 0;
+    const double editSeconds = Benchmark::Time([&]()
+    {
+        waitFrames++;
+        edited[waitParam] = waitFrames & 0xFF;
+        edited[waitParam + 1] = waitFrames >> 8;
+        SUDM::FF7::Field::Decompile(file, edited, formatter, "", "", 1, &cache);
+    });
+    Benchmark::Report("decompile after editing one function", editSeconds);
+    Benchmark::ReportSpeedup("hot reload speedup", fullSeconds, editSeconds);
+}
+
+BENCHMARK(FF7FieldDecompileStructured)
+{
+    // What structuring costs over writing gotos, analysis and the per-function attempts included
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat"
+    };
+    for (const char* file : files)
+    {
+        const auto scriptBytes = ScriptSection(file);
+        SUDM::IScriptFormatter formatter;
+        std::cout << "  " << file << std::endl;
+
+        const double gotoSeconds = Benchmark::Time([&]() { SUDM::FF7::Field::Decompile(file, scriptBytes, formatter); });
+        Benchmark::Report("decompile with gotos", gotoSeconds);
+        const double structuredSeconds = Benchmark::Time([&]()
+        {
+            SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, nullptr, SUDM::FF7::Field::ControlFlowMode::Structured);
+        });
+        Benchmark::Report("decompile structured", structuredSeconds);
+        Benchmark::ReportSpeedup("structured speedup", gotoSeconds, structuredSeconds);
+    }
+}
+
+BENCHMARK(FF7FieldDecompileDiskCache)
+{
+    // Rebuilding every field, first with nothing cached and then after nothing changed
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat"
+    };
+    SUDM::IScriptFormatter formatter;
+    std::vector<SUDM::FF7::Field::DecompileJob> jobs;
+    for (int copy = 0; copy < 32; copy++)
+    {
+        for (const char* file : files)
+        {
+            // Named apart so each copy has its own entry, as each field of a real FLEVEL would
+            jobs.push_back({ file + std::to_string(copy), ScriptSection(file), &formatter, "", "" });
+        }
+    }
+    const std::string cacheFile = "sudm_benchmark.cache";
+
+    const double uncachedSeconds = Benchmark::Time([&]() { SUDM::FF7::Field::DecompileBatch(jobs); });
+    Benchmark::Report(std::to_string(jobs.size()) + " scripts without a cache", uncachedSeconds);
+
+    const double coldSeconds = Benchmark::Time([&]()
+    {
+        std::remove(cacheFile.c_str());
+        SUDM::FF7::Field::DiskCache cache(cacheFile);
+        SUDM::FF7::Field::DecompileBatch(jobs, 0, &cache);
+    });
+    Benchmark::Report(std::to_string(jobs.size()) + " scripts filling an empty cache file", coldSeconds);
+
+    std::string report;
+    const double warmSeconds = Benchmark::Time([&]()
+    {
+        SUDM::FF7::Field::DiskCache cache(cacheFile);
+        SUDM::FF7::Field::DecompileBatch(jobs, 0, &cache);
+        report = cache.Report();
+    });
+    Benchmark::Report(std::to_string(jobs.size()) + " scripts from the cache file", warmSeconds);
+    Benchmark::ReportSpeedup("rebuild speedup", uncachedSeconds, warmSeconds);
+    std::cout << "  " << report << std::endl;
+    std::remove(cacheFile.c_str());
+}
@@ -0,0 +1,216 @@
+#include "benchmark.h"
+#include "binaryreader.h"
+#include "lzs.h"
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+    // The original decompressor, kept as the baseline to measure against
+    std::vector<unsigned char> LegacyDecompress(const std::vector<unsigned char>& compressed)
+    {
+        if (compressed.size() < 4)
+        {
+            abort();
+        }
+
+        const unsigned int inputBufferSize = static_cast<unsigned int>(compressed.size());
+        const unsigned int input_length =
+            (((compressed[0] & 0xFF) << 0) |
+            ((compressed[1] & 0xFF) << 8) |
+            ((compressed[2] & 0xFF) << 16) |
+            ((compressed[3] & 0xFF) << 24)) + 4;
+
+        if (input_length != inputBufferSize)
+        {
+            abort();
+        }
+
+        unsigned int extract_size = (inputBufferSize + 255) & ~255;
+        std::vector<unsigned char> extract_buffer(extract_size);
+
+        unsigned int input_offset = 4;
+        unsigned int output_offset = 0;
+        unsigned char control_byte = 0;
+        unsigned char control_bit = 0;
+
+        while (input_offset < inputBufferSize)
+        {
+            if (control_bit == 0)
+            {
+                control_byte = compressed[input_offset++];
+                control_bit = 8;
+            }
+
+            if (control_byte & 1)
+            {
+                extract_buffer[output_offset++] = compressed[input_offset++];
+
+                if (output_offset == extract_size)
+                {
+                    extract_size += 256;
+                    extract_buffer.resize(extract_size);
+                }
+            }
+            else
+            {
+                const unsigned char reference1 = compressed[input_offset++];
+                const unsigned char reference2 = compressed[input_offset++];
+
+                const unsigned short int reference_offset = reference1 | ((reference2 & 0xF0) << 4);
+
+                const unsigned char reference_length = (reference2 & 0xF) + 3;
+
+                int real_offset = output_offset - ((output_offset - 18 - reference_offset) & 0xFFF);
+
+                for (int j = 0; j < reference_length; ++j)
+                {
+                    if (real_offset < 0)
+                    {
+                        extract_buffer[output_offset++] = 0;
+                    }
+                    else
+                    {
+                        extract_buffer[output_offset++] = extract_buffer[real_offset];
+                    }
+
+                    if (output_offset == extract_size)
+                    {
+                        extract_size += 256;
+                        extract_buffer.resize(extract_size);
+                    }
+
+                    ++real_offset;
+                }
+            }
+
+            control_byte >>= 1;
+            control_bit--;
+        }
+
+        extract_buffer.resize(output_offset);
+        return extract_buffer;
+    }
+
+    // Builds a valid stream of roughly outputSize bytes with the given share of back references,
+    // this stands in for a full FLEVEL which can't be shipped with the tests
+    std::vector<unsigned char> SyntheticStream(size_t outputSize, double referenceRatio)
+    {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<double> kind(0.0, 1.0);
+        std::uniform_int_distribution<int> byte(0, 255);
+
+        std::vector<unsigned char> stream(4);
+        size_t produced = 0;
+        while (produced < outputSize)
+        {
+            const size_t controlPos = stream.size();
+            stream.push_back(0);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                if (kind(rng) >= referenceRatio)
+                {
+                    stream[controlPos] |= 1 << bit;
+                    stream.push_back(static_cast<unsigned char>(byte(rng) & 0x3F));
+                    produced++;
+                }
+                else
+                {
+                    const int length = byte(rng) & 0xF;
+                    const int offset = (byte(rng) << 4) | (byte(rng) & 0xF);
+                    stream.push_back(static_cast<unsigned char>(offset & 0xFF));
+                    stream.push_back(static_cast<unsigned char>(((offset >> 4) & 0xF0) | length));
+                    produced += length + 3;
+                }
+            }
+        }
+
+        const size_t length = stream.size() - 4;
+        for (int i = 0; i < 4; i++)
+        {
+            stream[i] = static_cast<unsigned char>(length >> (i * 8));
+        }
+        return stream;
+    }
+
+    void CompareDecompressors(const std::string& label, const std::vector<unsigned char>& compressed)
+    {
+        const std::vector<unsigned char> expected = LegacyDecompress(compressed);
+        if (Lzs::Decompress(compressed) != expected)
+        {
+            throw std::runtime_error("Lzs::Decompress output differs from the legacy implementation for " + label);
+        }
+
+        const double legacy = Benchmark::Time([&]() { LegacyDecompress(compressed); });
+        const double current = Benchmark::Time([&]() { Lzs::Decompress(compressed); });
+
+        std::cout << "  " << label << " (" << compressed.size() << " -> " << expected.size() << " bytes)" << std::endl;
+        Benchmark::Report("legacy", legacy, expected.size());
+        Benchmark::Report("Lzs::Decompress", current, expected.size());
+        Benchmark::ReportSpeedup("speedup", legacy, current);
+    }
+}
+
+BENCHMARK(LzsDecompress)
+{
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat",
+        "decompiler/test/ff7_control_flow_test.dat"
+    };
+    for (const char* file : files)
+    {
+        CompareDecompressors(file, BinaryReader::ReadAll(file));
+    }
+
+    CompareDecompressors("synthetic 4 MiB, 20% references", SyntheticStream(4 * 1024 * 1024, 0.2));
+    CompareDecompressors("synthetic 4 MiB, 60% references", SyntheticStream(4 * 1024 * 1024, 0.6));
+}
+
+namespace
+{
+    void MeasureCompressor(const std::string& label, const std::vector<unsigned char>& data)
+    {
+        std::cout << "  " << label << " (" << data.size() << " bytes)" << std::endl;
+        const std::pair<const char*, Lzs::eCompressionMode> modes[] =
+        {
+            { "fast", Lzs::eCompressionMode::eFast },
+            { "max ratio", Lzs::eCompressionMode::eMaxRatio }
+        };
+        for (const auto& mode : modes)
+        {
+            const std::vector<unsigned char> compressed = Lzs::Compress(data, mode.second);
+            if (Lzs::Decompress(compressed) != data)
+            {
+                throw std::runtime_error(std::string("Lzs::Compress ") + mode.first + " does not round trip for " + label);
+            }
+
+            const double seconds = Benchmark::Time([&]() { Lzs::Compress(data, mode.second); });
+            Benchmark::Report(mode.first, seconds, data.size());
+            std::cout << "    ratio " << std::fixed << std::setprecision(3) << static_cast<double>(compressed.size()) / data.size() << std::endl;
+        }
+    }
+}
+
+BENCHMARK(LzsCompress)
+{
+    const char* files[] =
+    {
+        "decompiler/test/bug_fixes.dat",
+        "decompiler/test/ff7_all_opcodes_by_category.dat",
+        "decompiler/test/ff7_control_flow_test.dat"
+    };
+    for (const char* file : files)
+    {
+        // The shipped file shows what ratio the original tools managed
+        const std::vector<unsigned char> original = BinaryReader::ReadAll(file);
+        const std::vector<unsigned char> data = Lzs::Decompress(original);
+        MeasureCompressor(file, data);
+        std::cout << "    shipped file ratio " << std::fixed << std::setprecision(3) << static_cast<double>(original.size()) / data.size() << std::endl;
+    }
+
+    MeasureCompressor("synthetic 4 MiB, 60% references", Lzs::Decompress(SyntheticStream(4 * 1024 * 1024, 0.6)));
+}
@@ -0,0 +1,87 @@
+#include "benchmark.h"
+#include <iostream>
+#include <boost/format.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Parallel benchmarks allocate from several threads at once
+    std::atomic<size_t> sAllocationCount(0);
+    std::atomic<size_t> sAllocationBytes(0);
+}
+
+// Counting replacements for the global allocator, only the benchmark executable has these
+void* operator new(size_t size)
+{
+    sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    sAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+Benchmark::Allocations Benchmark::AllocationsSoFar()
+{
+    return{ sAllocationCount.load(std::memory_order_relaxed), sAllocationBytes.load(std::memory_order_relaxed) };
+}
+
+std::vector<Benchmark::Case>& Benchmark::Registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void Benchmark::Report(const std::string& label, double secondsPerCall, size_t bytesPerCall)
+{
+    std::cout << boost::format("  %-48s %12.3f us") % label % (secondsPerCall * 1e6);
+    if (bytesPerCall > 0)
+    {
+        std::cout << boost::format("  %10.1f MB/s") % (bytesPerCall / secondsPerCall / (1024.0 * 1024.0));
+    }
+    std::cout << std::endl;
+}
+
+void Benchmark::ReportSpeedup(const std::string& label, double baselineSeconds, double candidateSeconds)
+{
+    std::cout << boost::format("  %-48s %12.2fx") % label % (baselineSeconds / candidateSeconds) << std::endl;
+}
+
+void Benchmark::ReportAllocations(const std::string& label, const Allocations& before, const Allocations& after)
+{
+    std::cout << boost::format("  %-48s %12u allocs  %10.1f KB")
+        % label % (after.mCount - before.mCount) % ((after.mBytes - before.mBytes) / 1024.0) << std::endl;
+}
+
+// Usage: Sudm_Benchmark [filter], runs every benchmark whose name contains filter.
+// Must be run from the repository root so the test data can be found.
+int main(int argc, char** argv)
+{
+    const std::string filter = argc > 1 ? argv[1] : "";
+    for (const auto& c : Benchmark::Registry())
+    {
+        if (c.mName.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        std::cout << c.mName << std::endl;
+        try
+        {
+            c.mFunc();
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "  FAILED: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
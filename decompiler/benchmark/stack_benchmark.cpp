@@ -0,0 +1,99 @@
+#include "benchmark.h"
+#include "decompiler/stack.h"
+#include "decompiler/value.h"
+#include <deque>
+#include <iostream>
+
+namespace
+{
+    // Stack<T> as it was before it stored items inline, for comparison
+    template<typename T>
+    class LegacyStack
+    {
+    public:
+        bool empty() const { return mStack.empty(); }
+        void push(const T& item) { mStack.push_front(item); }
+        T pop()
+        {
+            T item = mStack.front();
+            mStack.pop_front();
+            return item;
+        }
+        const T& peekPos(size_t pos) const { return mStack.at(pos); }
+
+    private:
+        std::deque<T> mStack;
+    };
+
+    // Creates a stack per instruction and pushes then pops depth values on it, as code generation does
+    template<class TStack>
+    size_t PushPop(const ValuePtr& value, int depth)
+    {
+        size_t popped = 0;
+        for (int instruction = 0; instruction < 1000; instruction++)
+        {
+            TStack stack;
+            for (int i = 0; i < depth; i++)
+            {
+                stack.push(value);
+            }
+            while (!stack.empty())
+            {
+                popped += stack.pop() == value;
+            }
+        }
+        return popped;
+    }
+
+    // Copies a stack of depth values, as code generation does for every edge it follows
+    template<class TStack>
+    size_t Copy(const ValuePtr& value, int depth)
+    {
+        TStack stack;
+        for (int i = 0; i < depth; i++)
+        {
+            stack.push(value);
+        }
+        size_t seen = 0;
+        for (int edge = 0; edge < 1000; edge++)
+        {
+            TStack copy(stack);
+            seen += copy.peekPos(depth - 1) == value;
+        }
+        return seen;
+    }
+
+    template<class TFunc>
+    void Compare(const std::string& label, TFunc legacy, TFunc current)
+    {
+        const double legacySeconds = Benchmark::Time(legacy);
+        const double currentSeconds = Benchmark::Time(current);
+        Benchmark::Report(label + ", deque", legacySeconds);
+        Benchmark::Report(label + ", Stack", currentSeconds);
+        Benchmark::ReportSpeedup("speedup", legacySeconds, currentSeconds);
+
+        auto before = Benchmark::AllocationsSoFar();
+        legacy();
+        auto after = Benchmark::AllocationsSoFar();
+        Benchmark::ReportAllocations(label + ", deque", before, after);
+        before = Benchmark::AllocationsSoFar();
+        current();
+        after = Benchmark::AllocationsSoFar();
+        Benchmark::ReportAllocations(label + ", Stack", before, after);
+    }
+}
+
+BENCHMARK(ValueStack)
+{
+    const ValuePtr value = new IntValue(1, true);
+    for (int depth : { 1, 4, 16 })
+    {
+        std::cout << "  1000 stacks " << depth << " deep" << std::endl;
+        Compare<std::function<void()>>("push and pop",
+            [&]() { PushPop<LegacyStack<ValuePtr>>(value, depth); },
+            [&]() { PushPop<ValueStack>(value, depth); });
+        Compare<std::function<void()>>("copy",
+            [&]() { Copy<LegacyStack<ValuePtr>>(value, depth); },
+            [&]() { Copy<ValueStack>(value, depth); });
+    }
+}
@@ -20,23 +20,55 @@
  */
 
 #include "control_flow.h"
+#include "dominators.h"
 #include "stack.h"
 
 #include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <set>
 
 #include <boost/format.hpp>
 
-#define PUT(vertex, group) boost::put(boost::vertex_name, _g, vertex, group);
-#define PUT_EDGE(edge, isJump) boost::put(boost::edge_attribute, _g, edge, isJump);
-#define PUT_ID(vertex, id) boost::put(boost::vertex_index, _g, vertex, id);
-#define GET(vertex) (boost::get(boost::vertex_name, _g, vertex))
-#define GET_EDGE(edge) (boost::get(boost::edge_attribute, _g, edge))
+// Unqualified, so they resolve to the Boost.Graph functions for a BoostGraph and the FlatGraph ones for a Graph
+#define PUT(vertex, group) put(boost::vertex_name, _g, vertex, group);
+#define PUT_EDGE(edge, isJump) put(boost::edge_attribute, _g, edge, isJump);
+#define PUT_ID(vertex, id) put(boost::vertex_index, _g, vertex, id);
+#define GET(vertex) (get(boost::vertex_name, _g, vertex))
+#define GET_EDGE(edge) (get(boost::edge_attribute, _g, edge))
 
-ControlFlow::ControlFlow(InstVec& insts, Engine& engine) 
+/**
+ * Merges vertex v of a BoostGraph into vertex u, the equivalent of FlatGraph's contract.
+ * u gets the outgoing edges of v, then v and all edges to and from it are removed.
+ *
+ * @param u The vertex to merge into.
+ * @param v The vertex to merge.
+ * @param g The graph containing both vertices.
+ */
+static void contract(BoostGraph::vertex_descriptor u, BoostGraph::vertex_descriptor v, BoostGraph &g) {
+	// Add outgoing edges from v
+	std::pair<BoostGraph::out_edge_iterator, BoostGraph::out_edge_iterator> r = boost::out_edges(v, g);
+	for (BoostGraph::out_edge_iterator e = r.first; e != r.second; ++e) {
+		BoostGraph::edge_descriptor newE = boost::add_edge(u, boost::target(*e, g), g).first;
+		boost::put(boost::edge_attribute, g, newE, boost::get(boost::edge_attribute, g, *e));
+	}
+
+	// Remove edges to/from v
+	boost::clear_vertex(v, g);
+	// Remove vertex
+	boost::remove_vertex(v, g);
+}
+
+template <class TGraph>
+const uint32 BasicControlFlow<TGraph>::kNoInst;
+
+template <class TGraph>
+BasicControlFlow<TGraph>::BasicControlFlow(InstVec& insts, Engine& engine) 
   : mInsts(insts), 
-    mEngine(engine)
+    mEngine(engine),
+    _addrBase(0),
+    _analysisSteps(0),
+    _maxAnalysisSteps(0)
 {
 
 	// Automatically add a function if we're not supposed to look for more functions and no functions are defined
@@ -46,26 +78,34 @@ ControlFlow::ControlFlow(InstVec& insts, Engine& engine)
         mEngine._functions[(*insts.begin())->_address] = Function((*insts.begin())->_address, (insts.back())->_address);
     }
 
+	indexAddresses();
+
+	// Every instruction starts out as its own group
+	_groupParent.resize(insts.size());
+	_groupSize.assign(insts.size(), 1);
+	_groupVertex.reserve(insts.size());
+
 	GroupPtr prev = NULL;
 	int id = 0;
 	// Create vertices
 	for (InstIterator it = insts.begin(); it != insts.end(); ++it) {
-		GraphVertex cur = boost::add_vertex(_g);
-		_addrMap[(*it)->_address] = cur;
-		PUT(cur, new Group(cur, it, it, prev));
+		Vertex cur = add_vertex(_g);
+		_groupParent[id] = id;
+		_groupVertex.push_back(cur);
+		PUT(cur, new Group(id, it, it, prev));
 		PUT_ID(cur, id);
-		id++;
 
 		// Add reference to vertex if function starts here
 		if (mEngine._functions.find((*it)->_address) != mEngine._functions.end())
-			mEngine._functions[(*it)->_address]._v = cur;
+			mEngine._functions[(*it)->_address]._v = id;
 
 		prev = GET(cur);
+		id++;
 	}
 
 	// Add regular edges
 	FuncMap::iterator fn;
-    GraphVertex last = {};
+    Vertex last = {};
 	bool addEdge = false;
 	prev = NULL;
 	for (InstIterator it = insts.begin(); it != insts.end(); ++it) {
@@ -73,9 +113,9 @@ ControlFlow::ControlFlow(InstVec& insts, Engine& engine)
 			addEdge = false;
 		}
 
-		GraphVertex cur = find(it);
+		Vertex cur = find(it);
 		if (addEdge) {
-			GraphEdge e = boost::add_edge(last, cur, _g).first;
+			Edge e = add_edge(last, cur, _g).first;
 			PUT_EDGE(e, false);
 		}
 
@@ -88,64 +128,124 @@ ControlFlow::ControlFlow(InstVec& insts, Engine& engine)
 	// Add jump edges
 	for (InstIterator it = insts.begin(); it != insts.end(); ++it) {
 		if ((*it)->isJump()) {
-			GraphEdge e = boost::add_edge(find(it), find((*it)->getDestAddress()), _g).first;
+			Vertex dest = find((*it)->getDestAddress());
+			if (dest == TGraph::null_vertex())
+				continue;
+			Edge e = add_edge(find(it), dest, _g).first;
 			PUT_EDGE(e, true);
 		}
 	}
 }
 
-GraphVertex ControlFlow::find(const InstPtr inst) {
-	return _addrMap[inst->_address];
+template <class TGraph>
+void BasicControlFlow<TGraph>::indexAddresses() {
+	if (mInsts.empty())
+		return;
+
+	uint32 lowest = mInsts.front()->_address;
+	uint32 highest = lowest;
+	for (InstIterator it = mInsts.begin(); it != mInsts.end(); ++it) {
+		lowest = std::min(lowest, (*it)->_address);
+		highest = std::max(highest, (*it)->_address);
+	}
+
+	// Instructions take at least a byte each, so the span of a script's addresses is normally close to its
+	// number of instructions. Only fall back to searching when it is not.
+	const uint32 span = highest - lowest;
+	if (span / 8 <= mInsts.size() + 128) {
+		_addrBase = lowest;
+		_addrIndex.assign(static_cast<size_t>(span) + 1, kNoInst);
+		for (uint32 i = 0; i < mInsts.size(); i++)
+			_addrIndex[mInsts[i]->_address - _addrBase] = i;
+	} else {
+		_sortedAddrs.reserve(mInsts.size());
+		for (uint32 i = 0; i < mInsts.size(); i++)
+			_sortedAddrs.push_back(std::make_pair(mInsts[i]->_address, i));
+		std::sort(_sortedAddrs.begin(), _sortedAddrs.end());
+	}
+}
+
+template <class TGraph>
+uint32 BasicControlFlow<TGraph>::findIndex(uint32 address) const {
+	if (_sortedAddrs.empty()) {
+		if (address < _addrBase || address - _addrBase >= _addrIndex.size())
+			return kNoInst;
+		return _addrIndex[address - _addrBase];
+	}
+	std::vector<std::pair<uint32, uint32> >::const_iterator it =
+		std::lower_bound(_sortedAddrs.begin(), _sortedAddrs.end(), std::make_pair(address, static_cast<uint32>(0)));
+	if (it == _sortedAddrs.end() || it->first != address)
+		return kNoInst;
+	return it->second;
+}
+
+template <class TGraph>
+uint32 BasicControlFlow<TGraph>::findRoot(uint32 index) {
+	while (_groupParent[index] != index) {
+		_groupParent[index] = _groupParent[_groupParent[index]];
+		index = _groupParent[index];
+	}
+	return index;
+}
+
+template <class TGraph>
+typename BasicControlFlow<TGraph>::Vertex BasicControlFlow<TGraph>::find(const InstPtr inst) {
+	return find(inst->_address);
 }
 
-GraphVertex ControlFlow::find(ConstInstIterator it) {
-	return _addrMap[(*it)->_address];
+template <class TGraph>
+typename BasicControlFlow<TGraph>::Vertex BasicControlFlow<TGraph>::find(ConstInstIterator it) {
+	return _groupVertex[findRoot(static_cast<uint32>(it - mInsts.begin()))];
 }
 
-GraphVertex ControlFlow::find(uint32 address) {
-	std::map<uint32, GraphVertex>::iterator it = _addrMap.find(address);
-	if (it == _addrMap.end())
+template <class TGraph>
+typename BasicControlFlow<TGraph>::Vertex BasicControlFlow<TGraph>::find(uint32 address) {
+	uint32 index = findIndex(address);
+	if (index == kNoInst) {
 		std::cerr << "Request for instruction at unknown address " << boost::format("0x%08x") % address << std::endl;
-	return it->second;
+		return TGraph::null_vertex();
+	}
+	return _groupVertex[findRoot(index)];
+}
+
+template <class TGraph>
+void BasicControlFlow<TGraph>::spendAnalysisStep(size_t steps) {
+	_analysisSteps += steps;
+	if (_maxAnalysisSteps != 0 && _analysisSteps > _maxAnalysisSteps)
+		throw AnalysisBudgetExceededException();
 }
 
-void ControlFlow::merge(GraphVertex g1, GraphVertex g2) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::merge(Vertex g1, Vertex g2) {
 	// Update property
 	GroupPtr gr1 = GET(g1);
 	GroupPtr gr2 = GET(g2);
 	gr1->_end = gr2->_end;
 	PUT(g1, gr1);
 
-	// Update address map
-	ConstInstIterator it = gr2->_start;
-	do {
-		_addrMap[(*it)->_address] = g1;
-		++it;
-	} while (gr2->_start != gr2->_end && it != gr2->_end);
-
-	// Add outgoing edges from g2
-	OutEdgeRange r = boost::out_edges(g2, _g);
-	for (OutEdgeIterator e = r.first; e != r.second; ++e) {
-		GraphEdge newE = boost::add_edge(g1, boost::target(*e, _g), _g).first;
-		PUT_EDGE(newE, GET_EDGE(*e));
-	}
+	// Join the instructions of g2 to those of g1, hanging the smaller tree off the larger
+	uint32 root1 = findRoot(static_cast<uint32>(gr1->_start - mInsts.begin()));
+	uint32 root2 = findRoot(static_cast<uint32>(gr2->_start - mInsts.begin()));
+	if (_groupSize[root1] < _groupSize[root2])
+		std::swap(root1, root2);
+	_groupParent[root2] = root1;
+	_groupSize[root1] += _groupSize[root2];
+	_groupVertex[root1] = g1;
 
 	// Update _next pointer
 	gr1->_next = gr2->_next;
 	if (gr2->_next != NULL)
 		gr2->_next->_prev = gr2->_prev;
 
-	// Remove edges to/from g2
-	boost::clear_vertex(g2, _g);
-	// Remove vertex
-	boost::remove_vertex(g2, _g);
+	// Move outgoing edges from g2 to g1 and remove g2
+	contract(g1, g2, _g);
 }
 
-typedef std::pair<GraphVertex, int> LevelEntry;
-
-void ControlFlow::setStackLevel(GraphVertex g, int level) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::setStackLevel(Vertex g, int level) {
+	typedef std::pair<Vertex, int> LevelEntry;
 	Stack<LevelEntry> levelStack;
-	std::set<GraphVertex> seen;
+	std::set<Vertex> seen;
 	levelStack.push(LevelEntry(g, level));
 	seen.insert(g);
 	while (!levelStack.empty()) {
@@ -158,37 +258,45 @@ void ControlFlow::setStackLevel(GraphVertex g, int level) {
 		}
 		gr->_stackLevel = e.second;
 
-		OutEdgeRange r = boost::out_edges(e.first, _g);
-		for (OutEdgeIterator oe = r.first; oe != r.second; ++oe) {
-			GraphVertex target = boost::target(*oe, _g);
-			if (seen.find(target) == seen.end()) {
-				levelStack.push(LevelEntry(target, e.second + (*gr->_start)->_stackChange));
-				seen.insert(target);
+		OutEdgeIterRange r = out_edges(e.first, _g);
+		for (OutEdgeIter oe = r.first; oe != r.second; ++oe) {
+			Vertex targetVertex = target(*oe, _g);
+			if (seen.find(targetVertex) == seen.end()) {
+				levelStack.push(LevelEntry(targetVertex, e.second + (*gr->_start)->_stackChange));
+				seen.insert(targetVertex);
 			}
 		}
 	}
 }
 
-void ControlFlow::createGroups() 
+template <class TGraph>
+void BasicControlFlow<TGraph>::createGroups() 
 {
-    if (!mEngine._functions.empty() && GET(mEngine._functions.begin()->second._v)->_stackLevel != -1)
+    if (!mEngine._functions.empty() && GET(find(mEngine._functions.begin()->first))->_stackLevel != -1)
     {
         return;
     }
 
 	for (FuncMap::iterator fn = mEngine._functions.begin(); fn != mEngine._functions.end(); ++fn)
-		setStackLevel(fn->second._v, 0);
+		setStackLevel(find(fn->first), 0);
 	ConstInstIterator curInst, nextInst;
 	nextInst = mInsts.begin();
 	nextInst++;
 	int stackLevel = 0;
 	int expectedStackLevel = 0;
+	// Whether an instruction of the current group before curInst has stack effect >= 0. Kept up to date as
+	// the group grows, rather than walking the whole group for every instruction merged in to it.
+	bool nonNegativeBefore = false;
 	for (curInst = mInsts.begin(); nextInst != mInsts.end(); ++curInst, ++nextInst) {
-		GraphVertex cur = find(curInst);
-		GraphVertex next = find(nextInst);
+		Vertex cur = find(curInst);
+		Vertex next = find(nextInst);
 
 		GroupPtr grCur = GET(cur);
 		GroupPtr grNext = GET(next);
+		if (grCur->_start == curInst)
+			nonNegativeBefore = false;
+		else
+			nonNegativeBefore |= (*(curInst - 1))->_stackChange >= 0;
 
 		// Don't process unreachable code
 		if (grCur->_stackLevel < 0) {
@@ -224,6 +332,12 @@ void ControlFlow::createGroups()
 			continue;
 		}
 
+		// Group ends before the start of a function, even when a jump inside that function is its only way in
+		if (mEngine._functions.find((*nextInst)->_address) != mEngine._functions.end()) {
+			stackLevel = grNext->_stackLevel;
+			continue;
+		}
+
 		// Group ends before target of a jump
 		if (in_degree(next, _g) != 1) {
 			stackLevel = grNext->_stackLevel;
@@ -232,14 +346,9 @@ void ControlFlow::createGroups()
 
 		// This part is only relevant if we use the stack level.
 		if (!mEngine.usePureGrouping()) {
-			// If group has no instructions with stack effect >= 0, don't merge on balanced stack
-			bool forceMerge = true;
-			ConstInstIterator it = grCur->_start;
-			do {
-				if ((*it)->_stackChange >= 0)
-					forceMerge = false;
-				++it;
-			} while (grCur->_start != grCur->_end && it != grCur->_end);
+			// If group has no instructions with stack effect >= 0, don't merge on balanced stack.
+			// The group ends at curInst, which only counts when it is the only instruction.
+			bool forceMerge = grCur->_start == curInst ? (*curInst)->_stackChange < 0 : !nonNegativeBefore;
 
 			// Group ends when stack is balanced, unless just before conditional jump
 			if (stackLevel == expectedStackLevel && !forceMerge && !(*nextInst)->isCondJump()) {
@@ -258,31 +367,32 @@ void ControlFlow::createGroups()
 	//detectShortCircuit();
 }
 
-void ControlFlow::detectShortCircuit() {
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectShortCircuit() {
 	ConstInstIterator lastInst = mInsts.end();
 	--lastInst;
-	GraphVertex cur = find(lastInst);
+	Vertex cur = find(lastInst);
 	GroupPtr gr = GET(cur);
 	while (gr->_prev != NULL) {
 		bool doMerge = false;
 		cur = find(gr->_start);
-		GraphVertex prev = find(gr->_prev->_start);
+		Vertex prev = find(gr->_prev->_start);
 		// Block is candidate for short-circuit merging if it and the preceding block both end with conditional jumps
 		if (out_degree(cur, _g) == 2 && out_degree(prev, _g) == 2) {
 			doMerge = true;
-			OutEdgeRange rCur = boost::out_edges(cur, _g);
-			std::vector<GraphVertex> succs;
+			OutEdgeIterRange rCur = out_edges(cur, _g);
+			std::vector<Vertex> succs;
 
 			// Find possible target vertices
-			for (OutEdgeIterator it = rCur.first; it != rCur.second; ++it) {
-				succs.push_back(boost::target(*it, _g));
+			for (OutEdgeIter it = rCur.first; it != rCur.second; ++it) {
+				succs.push_back(target(*it, _g));
 			}
 
 			// Check if vertex would add new targets - if yes, don't merge
-			OutEdgeRange rPrev = boost::out_edges(prev, _g);
-			for (OutEdgeIterator it = rPrev.first; it != rPrev.second; ++it) {
-				GraphVertex target = boost::target(*it, _g);
-				doMerge &= (std::find(succs.begin(), succs.end(), target) != succs.end() || target == cur);
+			OutEdgeIterRange rPrev = out_edges(prev, _g);
+			for (OutEdgeIter it = rPrev.first; it != rPrev.second; ++it) {
+				Vertex targetVertex = target(*it, _g);
+				doMerge &= (std::find(succs.begin(), succs.end(), targetVertex) != succs.end() || targetVertex == cur);
 			}
 
 			if (doMerge) {
@@ -295,7 +405,8 @@ void ControlFlow::detectShortCircuit() {
 	}
 }
 
-const Graph &ControlFlow::analyze() {
+template <class TGraph>
+const TGraph &BasicControlFlow<TGraph>::analyze() {
 	detectDoWhile();
 	detectWhile();
 	detectBreak();
@@ -305,16 +416,301 @@ const Graph &ControlFlow::analyze() {
 	return _g;
 }
 
-void ControlFlow::detectWhile() {
-	VertexRange vr = boost::vertices(_g);
-	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+namespace {
+
+/**
+ * Lowest and highest values over any range of two fixed arrays in constant time. The arrays are cut
+ * into chunks, and the extremes of every run of chunks whose length is a power of two are kept, so
+ * a range is scanned for at most two chunks' worth of values at its ends and looked up in between.
+ */
+class RangeExtremes {
+public:
+	/**
+	 * @param lows  The values lowest() looks at.
+	 * @param highs The values highest() looks at, as many as lows.
+	 */
+	RangeExtremes(const std::vector<uint32> &lows, const std::vector<uint32> &highs) : _lows(lows), _highs(highs) {
+		const size_t numChunks = (lows.size() + kChunkSize - 1) / kChunkSize;
+		_log2.assign(numChunks + 1, 0);
+		for (size_t length = 2; length < _log2.size(); length++)
+			_log2[length] = _log2[length / 2] + 1;
+		_chunkLows.push_back(std::vector<uint32>(numChunks, kNoValue));
+		_chunkHighs.push_back(std::vector<uint32>(numChunks, 0));
+		for (size_t i = 0; i < lows.size(); i++) {
+			_chunkLows[0][i / kChunkSize] = std::min(_chunkLows[0][i / kChunkSize], lows[i]);
+			_chunkHighs[0][i / kChunkSize] = std::max(_chunkHighs[0][i / kChunkSize], highs[i]);
+		}
+		for (size_t width = 1; 2 * width <= numChunks; width *= 2) {
+			std::vector<uint32> wider(numChunks - 2 * width + 1);
+			for (size_t i = 0; i < wider.size(); i++)
+				wider[i] = std::min(_chunkLows.back()[i], _chunkLows.back()[i + width]);
+			_chunkLows.push_back(std::move(wider));
+			wider.resize(numChunks - 2 * width + 1);
+			for (size_t i = 0; i < wider.size(); i++)
+				wider[i] = std::max(_chunkHighs.back()[i], _chunkHighs.back()[i + width]);
+			_chunkHighs.push_back(std::move(wider));
+		}
+	}
+
+	/**
+	 * @returns The lowest of lows[first] to lows[last], inclusive.
+	 */
+	uint32 lowest(uint32 first, uint32 last) const {
+		uint32 result = kNoValue;
+		const uint32 firstChunk = first / kChunkSize + 1;
+		const uint32 lastChunk = last / kChunkSize;
+		if (firstChunk >= lastChunk) {
+			for (uint32 i = first; i <= last; i++)
+				result = std::min(result, _lows[i]);
+			return result;
+		}
+		for (uint32 i = first; i < firstChunk * kChunkSize; i++)
+			result = std::min(result, _lows[i]);
+		for (uint32 i = lastChunk * kChunkSize; i <= last; i++)
+			result = std::min(result, _lows[i]);
+		const uint32 level = _log2[lastChunk - firstChunk];
+		return std::min(result, std::min(_chunkLows[level][firstChunk], _chunkLows[level][lastChunk - (1u << level)]));
+	}
+
+	/**
+	 * @returns The highest of highs[first] to highs[last], inclusive.
+	 */
+	uint32 highest(uint32 first, uint32 last) const {
+		uint32 result = 0;
+		const uint32 firstChunk = first / kChunkSize + 1;
+		const uint32 lastChunk = last / kChunkSize;
+		if (firstChunk >= lastChunk) {
+			for (uint32 i = first; i <= last; i++)
+				result = std::max(result, _highs[i]);
+			return result;
+		}
+		for (uint32 i = first; i < firstChunk * kChunkSize; i++)
+			result = std::max(result, _highs[i]);
+		for (uint32 i = lastChunk * kChunkSize; i <= last; i++)
+			result = std::max(result, _highs[i]);
+		const uint32 level = _log2[lastChunk - firstChunk];
+		return std::max(result, std::max(_chunkHighs[level][firstChunk], _chunkHighs[level][lastChunk - (1u << level)]));
+	}
+
+private:
+	static const uint32 kChunkSize = 32;
+	static const uint32 kNoValue = 0xFFFFFFFF;
+
+	const std::vector<uint32> &_lows;               ///< The values lowest() looks at.
+	const std::vector<uint32> &_highs;              ///< The values highest() looks at.
+	std::vector<uint32> _log2;                      ///< Floor of the base 2 logarithm of each number of chunks.
+	std::vector<std::vector<uint32> > _chunkLows;   ///< Lowest of each run of 2^level chunks, by level and first chunk.
+	std::vector<std::vector<uint32> > _chunkHighs;  ///< Highest of each run of 2^level chunks, by level and first chunk.
+};
+
+const uint32 RangeExtremes::kChunkSize;
+const uint32 RangeExtremes::kNoValue;
+
+/**
+ * A loop as seen from its last group, for telling which loop a break or continue belongs to.
+ */
+struct LoopEnd {
+	uint32 _header; ///< Index of the header of the natural loop it ends, its first group.
+	uint32 _last; ///< Index of the last group of the loop: the do-while condition, or the jump back to the while condition.
+	uint32 _cond; ///< Index of the loop's condition group.
+	uint32 _exit; ///< Index of the group the loop is left for.
+};
+
+} // End of anonymous namespace
+
+template <class TGraph>
+const TGraph &BasicControlFlow<TGraph>::analyzeWithDominators() {
+	// Number the groups in address order, which is the order the constructs are laid out in. Vertices are
+	// made in address order and only ever removed, so they're in that order too.
+	std::vector<Group *> groups;
+	std::vector<Vertex> blocks;
+	std::vector<uint32> blockOfInst(mInsts.size(), kNoInst);
+	groups.reserve(num_vertices(_g));
+	blocks.reserve(num_vertices(_g));
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
+		Group *gr = GET(*v).get();
+		blockOfInst[gr->_start - mInsts.begin()] = static_cast<uint32>(groups.size());
+		groups.push_back(gr);
+		blocks.push_back(*v);
+	}
+	const uint32 numBlocks = static_cast<uint32>(groups.size());
+	auto blockOf = [&](Vertex v) { return blockOfInst[GET(v)->_start - mInsts.begin()]; };
+
+	std::vector<uint32_t> succBegin(1, 0);
+	std::vector<uint32_t> succs;
+	succBegin.reserve(numBlocks + 1);
+	succs.reserve(2 * numBlocks); // A block falls through, jumps, or both
+	std::vector<uint32> jumpTarget(numBlocks, kNoInst);
+	for (uint32 b = 0; b < numBlocks; b++) {
+		OutEdgeIterRange oer = out_edges(blocks[b], _g);
+		for (OutEdgeIter e = oer.first; e != oer.second; ++e) {
+			succs.push_back(blockOf(target(*e, _g)));
+			if (get(boost::edge_attribute, _g, *e)._isJump)
+				jumpTarget[b] = succs.back();
+		}
+		succBegin.push_back(static_cast<uint32_t>(succs.size()));
+	}
+	std::vector<uint32_t> roots;
+	for (FuncMap::iterator fn = mEngine._functions.begin(); fn != mEngine._functions.end(); ++fn)
+		roots.push_back(blockOf(find(fn->first)));
+	// Only irreducible graphs, which structured code doesn't make, take the dominator tree more than a few steps per block
+	const DominatorTree dom(succBegin, succs, roots, [this](size_t steps) { spendAnalysisStep(steps); });
+
+	// do-while: Undetermined block with a conditional jump back to a block dominating it
+	for (uint32 b = 0; b < numBlocks; b++) {
+		if (groups[b]->_type != kNormalGroupType || succBegin[b + 1] - succBegin[b] != 2)
+			continue;
+		for (uint32 i = succBegin[b]; i < succBegin[b + 1]; i++) {
+			if (succs[i] < b && dom.Dominates(succs[i], b))
+				groups[b]->_type = kDoWhileCondGroupType;
+		}
+	}
+
+	// while: Undetermined block with a conditional jump, jumped back to from a block it dominates that
+	// isn't a do-while condition. The last such block closes the loop, any others are continues.
+	std::vector<uint32> whileLast(numBlocks, kNoInst);
+	for (uint32 b = 0; b < numBlocks; b++) {
+		if (groups[b]->_type != kNormalGroupType || succBegin[b + 1] - succBegin[b] != 2)
+			continue;
+		InEdgeIterRange ier = in_edges(blocks[b], _g);
+		for (InEdgeIter e = ier.first; e != ier.second; ++e) {
+			uint32 pred = blockOf(source(*e, _g));
+			if (pred > b && dom.Dominates(b, pred) && groups[pred]->_type != kDoWhileCondGroupType)
+				whileLast[b] = (whileLast[b] == kNoInst ? pred : std::max(whileLast[b], pred));
+		}
+		if (whileLast[b] != kNoInst)
+			groups[b]->_type = kWhileCondGroupType;
+	}
+
+	// The ends of the loops by header, in address order. Several do-whiles can start at the same block.
+	std::vector<LoopEnd> loopEnds;
+	for (uint32 b = 0; b < numBlocks; b++) {
+		if (groups[b]->_type == kWhileCondGroupType) {
+			LoopEnd end = { b, whileLast[b], b, jumpTarget[b] };
+			loopEnds.push_back(end);
+		} else if (groups[b]->_type == kDoWhileCondGroupType) {
+			for (uint32 i = succBegin[b]; i < succBegin[b + 1]; i++) {
+				LoopEnd end = { succs[i], b, b, b + 1 < numBlocks ? b + 1 : kNoInst };
+				if (succs[i] < b && dom.Dominates(succs[i], b))
+					loopEnds.push_back(end);
+			}
+		}
+	}
+	auto endsBefore = [](const LoopEnd &end, const LoopEnd &other) {
+		return end._header < other._header || (end._header == other._header && end._last < other._last);
+	};
+	std::sort(loopEnds.begin(), loopEnds.end(), endsBefore);
+
+	// The header of the innermost natural loop around each block. A block leaving its loop, like a break, doesn't
+	// reach the loop's end so isn't in the natural loop, and takes the loop around its immediate dominator instead.
+	const uint32 kUnknown = kNoInst - 1;
+	std::vector<uint32> loopOf(numBlocks, kUnknown);
+	std::vector<uint32> chain;
+	for (uint32 b = 0; b < numBlocks; b++) {
+		uint32 v = b;
+		while (v != DominatorTree::kNone && loopOf[v] == kUnknown && dom.LoopHeader(v) == DominatorTree::kNone) {
+			chain.push_back(v);
+			v = dom.IDom(v);
+		}
+		uint32 header = kNoInst;
+		if (v != DominatorTree::kNone)
+			header = loopOf[v] = (loopOf[v] == kUnknown ? dom.LoopHeader(v) : loopOf[v]);
+		for (std::vector<uint32>::iterator it = chain.begin(); it != chain.end(); ++it)
+			loopOf[*it] = header;
+		chain.clear();
+	}
+
+	// The innermost loop a block is in is the first to end at or after it among those sharing the header of the
+	// innermost natural loop around it. A natural loop with no condition, an infinite one, has no breaks or continues.
+	auto innermostLoop = [&](uint32 b) -> const LoopEnd * {
+		if (loopOf[b] == kNoInst)
+			return NULL;
+		LoopEnd key = { loopOf[b], b, 0, 0 };
+		std::vector<LoopEnd>::const_iterator it = std::lower_bound(loopEnds.begin(), loopEnds.end(), key, endsBefore);
+		return it == loopEnds.end() || it->_header != loopOf[b] ? NULL : &*it;
+	};
+
+	for (uint32 b = 0; b < numBlocks; b++) {
+		Group *gr = groups[b];
+		// Undetermined block with unconditional jump...
+		if (gr->_type != kNormalGroupType || !(*gr->_end)->isUncondJump() || succBegin[b + 1] - succBegin[b] != 1)
+			continue;
+		uint32 targetBlock = succs[succBegin[b]];
+		const LoopEnd *loop = innermostLoop(b);
+		if (loop == NULL)
+			continue;
+		// break: ...to the block the innermost loop is left for
+		if (targetBlock > b && targetBlock == loop->_exit)
+			gr->_type = kBreakGroupType;
+		// continue: ...to the condition of the innermost loop, other than the jump closing a while
+		else if (targetBlock == loop->_cond && b != loop->_last)
+			gr->_type = kContinueGroupType;
+	}
+
+	// if: Undetermined block with conditional jump
+	for (uint32 b = 0; b < numBlocks; b++) {
+		if (groups[b]->_type == kNormalGroupType && (*groups[b]->_end)->isCondJump())
+			groups[b]->_type = kIfCondGroupType;
+	}
+
+	// The immediate dominator of each block and the lowest and highest block each condition may jump to
+	std::vector<uint32> idoms(numBlocks);
+	std::vector<uint32> lowestSucc(numBlocks);
+	std::vector<uint32> highestSucc(numBlocks);
+	for (uint32 b = 0; b < numBlocks; b++) {
+		idoms[b] = dom.IDom(b);
+		lowestSucc[b] = highestSucc[b] = b;
+		GroupType type = groups[b]->_type;
+		if (type == kIfCondGroupType || type == kWhileCondGroupType || type == kDoWhileCondGroupType) {
+			for (uint32 i = succBegin[b]; i < succBegin[b + 1]; i++) {
+				lowestSucc[b] = std::min(lowestSucc[b], succs[i]);
+				highestSucc[b] = std::max(highestSucc[b], succs[i]);
+			}
+		}
+	}
+	const RangeExtremes idomRange(idoms, idoms);
+	const RangeExtremes succRange(lowestSucc, highestSucc);
+
+	for (uint32 b = 0; b < numBlocks; b++) {
+		if (groups[b]->_type != kIfCondGroupType)
+			continue;
+		uint32 start = 0;
+		for (uint32 i = succBegin[b]; i < succBegin[b + 1]; i++)
+			start = std::max(start, succs[i]);
+		// else: Jump target of if immediately preceded by an unconditional jump...
+		if (start == 0 || !(*groups[start - 1]->_end)->isUncondJump() || succBegin[start] == succBegin[start - 1])
+			continue;
+		// ...which is not a break or a continue...
+		if (groups[start - 1]->_type == kContinueGroupType || groups[start - 1]->_type == kBreakGroupType)
+			continue;
+		// ...to later in the code...
+		uint32 end = succs[succBegin[start - 1]];
+		if (end <= start)
+			continue;
+		// ...where the else is only entered from the if...
+		if (dom.IDom(start) != b || (end - start > 1 && (idomRange.lowest(start + 1, end - 1) < start || idomRange.highest(start + 1, end - 1) >= end)))
+			continue;
+		// ...and its conditions don't jump out of it
+		if (succRange.lowest(start, end - 1) < start || succRange.highest(start, end - 1) > end)
+			continue;
+		groups[start]->_startElse = true;
+		groups[end - 1]->_endElse.push_back(groups[start]);
+	}
+	return _g;
+}
+
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectWhile() {
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
 		GroupPtr gr = GET(*v);
 		// Undetermined block that ends with conditional jump
 		if (out_degree(*v, _g) == 2 && gr->_type == kNormalGroupType) {
-			InEdgeRange ier = boost::in_edges(*v, _g);
+			InEdgeIterRange ier = in_edges(*v, _g);
 			bool isWhile = false;
-			for (InEdgeIterator e = ier.first; e != ier.second; ++e) {
-				GroupPtr sourceGr = GET(boost::source(*e, _g));
+			for (InEdgeIter e = ier.first; e != ier.second; ++e) {
+				GroupPtr sourceGr = GET(source(*e, _g));
 				// Block has ingoing edge from block later in the code that isn't a do-while condition
 				if ((*sourceGr->_start)->_address > (*gr->_start)->_address && sourceGr->_type != kDoWhileCondGroupType)
 					isWhile = true;
@@ -325,15 +721,16 @@ void ControlFlow::detectWhile() {
 	}
 }
 
-void ControlFlow::detectDoWhile() {
-	VertexRange vr = boost::vertices(_g);
-	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectDoWhile() {
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
 		GroupPtr gr = GET(*v);
 		// Undetermined block that ends with conditional jump...
 		if (out_degree(*v, _g) == 2 && gr->_type == kNormalGroupType) {
-			OutEdgeRange oer = boost::out_edges(*v, _g);
-			for (OutEdgeIterator e = oer.first; e != oer.second; ++e) {
-				GroupPtr targetGr = GET(boost::target(*e, _g));
+			OutEdgeIterRange oer = out_edges(*v, _g);
+			for (OutEdgeIter e = oer.first; e != oer.second; ++e) {
+				GroupPtr targetGr = GET(target(*e, _g));
 				// ...to earlier in code
 				if ((*targetGr->_start)->_address < (*gr->_start)->_address)
 					gr->_type = kDoWhileCondGroupType;
@@ -342,21 +739,22 @@ void ControlFlow::detectDoWhile() {
 	}
 }
 
-void ControlFlow::detectBreak() {
-	VertexRange vr = boost::vertices(_g);
-	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectBreak() {
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
 		GroupPtr gr = GET(*v);
 		// Undetermined block with unconditional jump...
 		if (gr->_type == kNormalGroupType && ((*gr->_end)->isUncondJump()) && out_degree(*v, _g) == 1) {
-			OutEdgeIterator oe = boost::out_edges(*v, _g).first;
-			GraphVertex target = boost::target(*oe, _g);
-			GroupPtr targetGr = GET(target);
+			OutEdgeIter oe = out_edges(*v, _g).first;
+			Vertex targetVertex = target(*oe, _g);
+			GroupPtr targetGr = GET(targetVertex);
 			// ...to somewhere later in the code...
 			if ((*gr->_start)->_address >= (*targetGr->_start)->_address)
 				continue;
-			InEdgeRange ier = boost::in_edges(target, _g);
-			for (InEdgeIterator ie = ier.first; ie != ier.second; ++ie) {
-				GroupPtr sourceGr = GET(boost::source(*ie, _g));
+			InEdgeIterRange ier = in_edges(targetVertex, _g);
+			for (InEdgeIter ie = ier.first; ie != ier.second; ++ie) {
+				GroupPtr sourceGr = GET(source(*ie, _g));
 				// ...to block immediately after a do-while condition, or to jump target of a while condition
 				if ((targetGr->_prev == sourceGr && sourceGr->_type == kDoWhileCondGroupType) || sourceGr->_type == kWhileCondGroupType) {
 					if (validateBreakOrContinue(gr, sourceGr))
@@ -367,27 +765,28 @@ void ControlFlow::detectBreak() {
 	}
 }
 
-void ControlFlow::detectContinue() {
-	VertexRange vr = boost::vertices(_g);
-	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectContinue() {
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
 		GroupPtr gr = GET(*v);
 		// Undetermined block with unconditional jump...
 		if (gr->_type == kNormalGroupType && ((*gr->_end)->isUncondJump()) && out_degree(*v, _g) == 1) {
-			OutEdgeIterator oe = boost::out_edges(*v, _g).first;
-			GraphVertex target = boost::target(*oe, _g);
-			GroupPtr targetGr = GET(target);
+			OutEdgeIter oe = out_edges(*v, _g).first;
+			Vertex targetVertex = target(*oe, _g);
+			GroupPtr targetGr = GET(targetVertex);
 			// ...to a while or do-while condition...
 			if (targetGr->_type == kWhileCondGroupType || targetGr->_type == kDoWhileCondGroupType) {
 				bool isContinue = true;
 				// ...unless...
-				OutEdgeRange toer = boost::out_edges(target, _g);
+				OutEdgeIterRange toer = out_edges(targetVertex, _g);
 				bool afterJumpTargets = true;
-				for (OutEdgeIterator toe = toer.first; toe != toer.second; ++toe) {
+				for (OutEdgeIter toe = toer.first; toe != toer.second; ++toe) {
 					// ...it is targeting a while condition which jumps to the next sequential group
-					if (targetGr->_type == kWhileCondGroupType && GET(boost::target(*toe, _g)) == gr->_next)
+					if (targetGr->_type == kWhileCondGroupType && GET(target(*toe, _g)) == gr->_next)
 						isContinue = false;
 					// ...or the instruction is placed after all jump targets from condition
-					if ((*GET(boost::target(*toe, _g))->_start)->_address > (*gr->_start)->_address)
+					if ((*GET(target(*toe, _g))->_start)->_address > (*gr->_start)->_address)
 						afterJumpTargets = false;
 				}
 				if (afterJumpTargets)
@@ -400,7 +799,8 @@ void ControlFlow::detectContinue() {
 	}
 }
 
-bool ControlFlow::validateBreakOrContinue(GroupPtr gr, GroupPtr condGr) {
+template <class TGraph>
+bool BasicControlFlow<TGraph>::validateBreakOrContinue(GroupPtr gr, GroupPtr condGr) {
 	GroupPtr from, to, cursor;
 
 	if (condGr->_type == kDoWhileCondGroupType) {
@@ -414,18 +814,20 @@ bool ControlFlow::validateBreakOrContinue(GroupPtr gr, GroupPtr condGr) {
 	GroupType ogt = (condGr->_type == kDoWhileCondGroupType ? kWhileCondGroupType : kDoWhileCondGroupType);
 	// Verify that destination deals with innermost while/do-while
 	for (cursor = from; cursor->_next != NULL && cursor != to; cursor = cursor->_next) {
+		spendAnalysisStep();
 		if (cursor->_type == condGr->_type) {
-			OutEdgeRange oerValidate = boost::out_edges(find(cursor->_start), _g);
-			for (OutEdgeIterator oeValidate = oerValidate.first; oeValidate != oerValidate.second; ++oeValidate) {
-				GraphVertex vValidate = boost::target(*oeValidate, _g);
+			OutEdgeIterRange oerValidate = out_edges(find(cursor->_start), _g);
+			for (OutEdgeIter oeValidate = oerValidate.first; oeValidate != oerValidate.second; ++oeValidate) {
+				Vertex vValidate = target(*oeValidate, _g);
 				GroupPtr gValidate = GET(vValidate);
 				// For all other loops of same type found in range, all targets must fall within that range
 				if ((*gValidate->_start)->_address < (*from->_start)->_address || (*gValidate->_start)->_address > (*to->_start)->_address )
 					return false;
 
-				InEdgeRange ierValidate = boost::in_edges(vValidate, _g);
-				for (InEdgeIterator ieValidate = ierValidate.first; ieValidate != ierValidate.second; ++ieValidate) {
-					GroupPtr igValidate = GET(boost::source(*ieValidate, _g));
+				InEdgeIterRange ierValidate = in_edges(vValidate, _g);
+				for (InEdgeIter ieValidate = ierValidate.first; ieValidate != ierValidate.second; ++ieValidate) {
+					spendAnalysisStep();
+					GroupPtr igValidate = GET(source(*ieValidate, _g));
 					// All loops of other type going into range must be placed within range
 					if (igValidate->_type == ogt && ((*igValidate->_start)->_address < (*from->_start)->_address || (*igValidate->_start)->_address > (*to->_start)->_address ))
 					return false;
@@ -436,9 +838,10 @@ bool ControlFlow::validateBreakOrContinue(GroupPtr gr, GroupPtr condGr) {
 	return true;
 }
 
-void ControlFlow::detectIf() {
-	VertexRange vr = boost::vertices(_g);
-	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectIf() {
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
 		GroupPtr gr = GET(*v);
 		// if: Undetermined block with conditional jump
 		if (gr->_type == kNormalGroupType && ((*gr->_end)->isCondJump())) {
@@ -447,24 +850,27 @@ void ControlFlow::detectIf() {
 	}
 }
 
-void ControlFlow::detectElse() {
-	VertexRange vr = boost::vertices(_g);
-	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+template <class TGraph>
+void BasicControlFlow<TGraph>::detectElse() {
+	VertexIterRange vr = vertices(_g);
+	for (VertexIter v = vr.first; v != vr.second; ++v) {
 		GroupPtr gr = GET(*v);
 		if (gr->_type == kIfCondGroupType) {
-			OutEdgeRange oer = boost::out_edges(*v, _g);
-			GraphVertex target;
+			OutEdgeIterRange oer = out_edges(*v, _g);
+			Vertex targetVertex = TGraph::null_vertex();
 			uint32 maxAddress = 0;
 			GroupPtr targetGr;
 			// Find jump target
-			for (OutEdgeIterator oe = oer.first; oe != oer.second; ++oe) {
-				targetGr = GET(boost::target(*oe, _g));
+			for (OutEdgeIter oe = oer.first; oe != oer.second; ++oe) {
+				targetGr = GET(target(*oe, _g));
 				if ((*targetGr->_start)->_address > maxAddress) {
-					target = boost::target(*oe, _g);
+					targetVertex = target(*oe, _g);
 					maxAddress = (*targetGr->_start)->_address;
 				}
 			}
-			targetGr = GET(target);
+			// A conditional jump always has an edge to a later group
+			assert(targetVertex != TGraph::null_vertex());
+			targetGr = GET(targetVertex);
 			// else: Jump target of if immediately preceded by an unconditional jump...
 			if (!(*targetGr->_prev->_end)->isUncondJump())
 				continue;
@@ -472,8 +878,11 @@ void ControlFlow::detectElse() {
 			if (targetGr->_prev->_type == kContinueGroupType || targetGr->_prev->_type == kBreakGroupType)
 				continue;
 			// ...to later in the code
-			OutEdgeIterator toe = boost::out_edges(find((*targetGr->_prev->_start)->_address), _g).first;
-			GroupPtr targetTargetGr = GET(boost::target(*toe, _g));
+			Vertex prevVertex = find((*targetGr->_prev->_start)->_address);
+			if (out_degree(prevVertex, _g) == 0)
+				continue;
+			OutEdgeIter toe = out_edges(prevVertex, _g).first;
+			GroupPtr targetTargetGr = GET(target(*toe, _g));
 			if ((*targetTargetGr->_start)->_address > (*targetGr->_end)->_address) {
 				if (validateElseBlock(gr, targetGr, targetTargetGr)) {
 					targetGr->_startElse = true;
@@ -484,14 +893,16 @@ void ControlFlow::detectElse() {
 	}
 }
 
-bool ControlFlow::validateElseBlock(GroupPtr ifGroup, GroupPtr start, GroupPtr end) {
+template <class TGraph>
+bool BasicControlFlow<TGraph>::validateElseBlock(GroupPtr ifGroup, GroupPtr start, GroupPtr end) {
 	for (GroupPtr cursor = start; cursor != end; cursor = cursor->_next) {
+		spendAnalysisStep();
 		if (cursor->_type == kIfCondGroupType || cursor->_type == kWhileCondGroupType || cursor->_type == kDoWhileCondGroupType) {
 			// Validate outgoing edges of conditions
-			OutEdgeRange oer = boost::out_edges(find(cursor->_start), _g);
-			for (OutEdgeIterator oe = oer.first; oe != oer.second; ++oe) {
-				GraphVertex target = boost::target(*oe, _g);
-				GroupPtr targetGr = GET(target);
+			OutEdgeIterRange oer = out_edges(find(cursor->_start), _g);
+			for (OutEdgeIter oe = oer.first; oe != oer.second; ++oe) {
+				Vertex targetVertex = target(*oe, _g);
+				GroupPtr targetGr = GET(targetVertex);
 				// Each edge from condition must not leave the range [start, end]
 				if ((*start->_start)->_address > (*targetGr->_start)->_address || (*targetGr->_start)->_address > (*end->_start)->_address)
 					return false;
@@ -510,10 +921,11 @@ bool ControlFlow::validateElseBlock(GroupPtr ifGroup, GroupPtr start, GroupPtr e
 			continue;
 
 		// ...validate ingoing edges
-		InEdgeRange ier = boost::in_edges(find(cursor->_start), _g);
-		for (InEdgeIterator ie = ier.first; ie != ier.second; ++ie) {
-			GraphVertex source = boost::source(*ie, _g);
-			GroupPtr sourceGr = GET(source);
+		InEdgeIterRange ier = in_edges(find(cursor->_start), _g);
+		for (InEdgeIter ie = ier.first; ie != ier.second; ++ie) {
+			spendAnalysisStep();
+			Vertex sourceVertex = source(*ie, _g);
+			GroupPtr sourceGr = GET(sourceVertex);
 
 			// Edges going to conditions...
 			if (sourceGr->_type == kIfCondGroupType || sourceGr->_type == kWhileCondGroupType || sourceGr->_type == kDoWhileCondGroupType) {
@@ -532,3 +944,6 @@ bool ControlFlow::validateElseBlock(GroupPtr ifGroup, GroupPtr start, GroupPtr e
 	}
 	return true;
 }
+
+template class BasicControlFlow<Graph>;
+template class BasicControlFlow<BoostGraph>;
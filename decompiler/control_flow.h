@@ -25,36 +25,90 @@
 #include "graph.h"
 #include "decompiler_engine.h"
 
+#include <vector>
+
 /**
  * Class for doing code flow analysis.
+ *
+ * @tparam TGraph Type of the control flow graph, Graph or BoostGraph.
  */
-class ControlFlow {
+template <class TGraph>
+class BasicControlFlow {
 private:
-	Graph _g;                               ///< The control flow graph.
+	typedef typename TGraph::vertex_descriptor Vertex;          ///< A vertex of the graph.
+	typedef typename TGraph::edge_descriptor Edge;              ///< An edge of the graph.
+	typedef typename TGraph::vertex_iterator VertexIter;        ///< Iterator over the vertices of the graph.
+	typedef typename TGraph::out_edge_iterator OutEdgeIter;     ///< Iterator over the outgoing edges of a vertex.
+	typedef typename TGraph::in_edge_iterator InEdgeIter;       ///< Iterator over the ingoing edges of a vertex.
+	typedef std::pair<VertexIter, VertexIter> VertexIterRange;  ///< Range of vertices from vertices().
+	typedef std::pair<OutEdgeIter, OutEdgeIter> OutEdgeIterRange; ///< Range of edges from out_edges().
+	typedef std::pair<InEdgeIter, InEdgeIter> InEdgeIterRange;  ///< Range of edges from in_edges().
+
+	TGraph _g;                              ///< The control flow graph.
 	Engine& mEngine;                        ///< Pointer to the Engine used for the script.
 	InstVec &mInsts;                  ///< The instructions being analyzed
-	std::map<uint32, GraphVertex> _addrMap; ///< Map between addresses and vertices.
+	std::vector<uint32> _addrIndex;         ///< Index in mInsts of the instruction at each address from _addrBase, or kNoInst.
+	uint32 _addrBase;                       ///< Address of the first entry in _addrIndex.
+	std::vector<std::pair<uint32, uint32> > _sortedAddrs; ///< Sorted (address, index in mInsts) pairs, used instead of _addrIndex when addresses are too spread out.
+	std::vector<uint32> _groupParent;       ///< Union-find forest over indices in mInsts, each root stands for the group of its tree.
+	std::vector<uint32> _groupSize;         ///< Number of instructions in the tree of each root.
+	std::vector<Vertex> _groupVertex;       ///< Vertex of the group each root stands for.
+
+	size_t _analysisSteps;                  ///< Steps taken by analyze() so far.
+	size_t _maxAnalysisSteps;               ///< Steps analyze() may take, 0 for no limit.
+
+	static const uint32 kNoInst = 0xFFFFFFFF; ///< Marks addresses in _addrIndex without an instruction.
+
+	/**
+	 * Builds the address index for the instructions.
+	 */
+	void indexAddresses();
+
+	/**
+	 * Finds the index in mInsts of the instruction at an address.
+	 *
+	 * @param address The address to look up.
+	 * @returns The index of the instruction, or kNoInst if there is none at address.
+	 */
+	uint32 findIndex(uint32 address) const;
+
+	/**
+	 * Finds the root of the union-find tree an instruction is in, halving the path on the way.
+	 *
+	 * @param index The index in mInsts of the instruction.
+	 * @returns The index of the root, which stands for the group containing the instruction.
+	 */
+	uint32 findRoot(uint32 index);
 
 	/**
 	 * Finds a graph vertex through an instruction.
 	 *
 	 * @param inst The instruction to find the vertex for.
 	 */
-	GraphVertex find(const InstPtr inst);
+	Vertex find(const InstPtr inst);
 
 	/**
 	 * Finds a graph vertex through an instruction iterator.
 	 *
 	 * @param it The iterator to find the vertex for.
 	 */
-	GraphVertex find(ConstInstIterator it);
+	Vertex find(ConstInstIterator it);
 
 	/**
 	 * Finds a graph vertex through an address.
 	 *
 	 * @param address The address to find the vertex for.
+	 * @return The vertex, or null_vertex() if no instruction has the address.
 	 */
-	GraphVertex find(uint32 address);
+	Vertex find(uint32 address);
+
+	/**
+	 * Counts steps of analysis against the budget from setAnalysisBudget.
+	 *
+	 * @param steps The number of steps taken.
+	 * @throws AnalysisBudgetExceededException if the budget is spent.
+	 */
+	void spendAnalysisStep(size_t steps = 1);
 
 	/**
 	 * Merges two graph vertices. g2 will be merged into g1.
@@ -62,15 +116,15 @@ private:
 	 * @param g1 The first vertex to merge.
 	 * @param g2 The second vertex to merge.
 	 */
-	void merge(GraphVertex g1, GraphVertex g2);
+	void merge(Vertex g1, Vertex g2);
 
 	/**
 	 * Sets the stack level for all instructions, using depth-first search.
 	 *
-	 * @param g     The GraphVertex to search from.
+	 * @param g     The vertex to search from.
 	 * @param level The stack level when g is reached.
 	 */
-	void setStackLevel(GraphVertex g, int level);
+	void setStackLevel(Vertex g, int level);
 
 	/**
 	 * Merged groups that are part of the same short-circuited condition check.
@@ -132,15 +186,15 @@ private:
 	bool validateElseBlock(GroupPtr ifGroup, GroupPtr start, GroupPtr end);
 
 public:
-    ControlFlow(const ControlFlow&) = delete;
-    ControlFlow& operator = (const ControlFlow&) = delete;
+    BasicControlFlow(const BasicControlFlow&) = delete;
+    BasicControlFlow& operator = (const BasicControlFlow&) = delete;
 
 	/**
 	 * Gets the current control flow graph.
 	 *
 	 * @returns The current control flow graph.
 	 */
-	const Graph &getGraph() const { return _g; };
+	const TGraph &getGraph() const { return _g; };
 
 	/**
 	 * Constructor for the control flow graph.
@@ -148,7 +202,15 @@ public:
 	 * @param insts  std::vector containing the instructions to analyze control flow for.
 	 * @param engine Pointer to the Engine used for the script.
 	 */
-	ControlFlow(InstVec& insts, Engine& engine);
+	BasicControlFlow(InstVec& insts, Engine& engine);
+
+	/**
+	 * Limits the work analyze() may do. Without a limit, validating breaks, continues and elses walks the
+	 * groups between a jump and its target, which is quadratic in the worst case.
+	 *
+	 * @param maxSteps Groups and edges analyze() may look at while validating, 0 for no limit (the default).
+	 */
+	void setAnalysisBudget(size_t maxSteps) { _maxAnalysisSteps = maxSteps; }
 
 	/**
 	 * Creates groups suitable for a stack-based machine.
@@ -161,9 +223,28 @@ public:
 	 * Performs control flow analysis.
 	 * The constructs are detected in the following order: do-while, while, break, continue, if/else.
 	 *
+	 * @throws AnalysisBudgetExceededException if the budget from setAnalysisBudget is spent, leaving the graph partially analyzed.
 	 * @returns The control flow graph after analysis.
 	 */
-	const Graph &analyze();
+	const TGraph &analyze();
+
+	/**
+	 * Performs the same control flow analysis as analyze(), answering each question from a dominator
+	 * tree and loop nesting forest built once rather than by walking the groups between a jump and its
+	 * target, so large and deeply nested scripts take time close to linear in their size.
+	 * Loops are only found where they're entered through their start and elses where they're only
+	 * entered from their if, as in structured code.
+	 *
+	 * @throws AnalysisBudgetExceededException if building the dominator tree takes more steps than the budget
+	 *         from setAnalysisBudget allows, leaving the graph unanalyzed.
+	 * @returns The control flow graph after analysis.
+	 */
+	const TGraph &analyzeWithDominators();
 };
 
+/**
+ * Code flow analysis on the Graph type used by the rest of the decompiler.
+ */
+typedef BasicControlFlow<Graph> ControlFlow;
+
 #endif
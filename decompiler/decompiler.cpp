@@ -129,12 +129,12 @@ int main(int argc, char** argv) {
 			return 2;
 		}
 
-		if (vm.count("no-stack-effect")) {
-			setOutputStackEffect(false);
-		}
-
 		std::unique_ptr<Engine> engine(engineFactory.create(vm["engine"].as<std::string>()));
 		engine->_variant = vm["variant"].as<std::string>();
+		if (vm.count("no-stack-effect")) {
+			engine->_outputStackEffect = false;
+		}
+		std::cout << StackEffect(engine->_outputStackEffect);
 		std::string inputFile = vm["input-file"].as<std::string>();
 
 		// Disassembly
@@ -154,6 +154,7 @@ int main(int argc, char** argv) {
 				buf = std::cout.rdbuf();
 			}
 			std::ostream out(buf);
+			out << StackEffect(engine->_outputStackEffect);
 			disassembler->dumpDisassembly(out);
 		}
 
@@ -180,12 +181,12 @@ int main(int argc, char** argv) {
 				buf = std::cout.rdbuf();
 			}
 			std::ostream out(buf);
-			boost::write_graphviz(out, g, boost::make_label_writer(get(boost::vertex_name, g)), boost::makeArrowheadWriter(get(boost::edge_attribute, g)), GraphProperties(engine.get(), g));
+			writeGraphviz(out, g, engine->_outputStackEffect, GraphProperties(engine.get(), g));
 		}
 
 		if (!engine->supportsCodeGen() || vm.count("only-graph")) {
 			if (!vm.count("dump-graph")) {
-				boost::write_graphviz(std::cout, g, boost::make_label_writer(get(boost::vertex_name, g)), boost::makeArrowheadWriter(get(boost::edge_attribute, g)), GraphProperties(engine.get(), g));
+				writeGraphviz(std::cout, g, engine->_outputStackEffect, GraphProperties(engine.get(), g));
 			}
 			return 0;
 		}
@@ -199,10 +200,10 @@ int main(int argc, char** argv) {
 
 		if (vm.count("show-unreachable")) {
 			std::vector<GroupPtr> unreachable;
-			VertexRange vr = boost::vertices(g);
+			VertexRange vr = vertices(g);
 			for (VertexIterator v = vr.first; v != vr.second; ++v)
 			{
-				GroupPtr gr = boost::get(boost::vertex_name, g, *v);
+				GroupPtr gr = get(boost::vertex_name, g, *v);
 				if (gr->_stackLevel == -1)
 					unreachable.push_back(gr);
 			}
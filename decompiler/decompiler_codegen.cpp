@@ -22,13 +22,13 @@
 #include "decompiler_codegen.h"
 #include "decompiler_engine.h"
 #include <algorithm>
+#include <cstdio>
 #include <iostream>
-#include <set>
 #include <boost/format.hpp>
 #include "make_unique.h"
 
-#define GET(vertex)    (boost::get(boost::vertex_name, _g, vertex))
-#define GET_EDGE(edge) (boost::get(boost::edge_attribute, _g, edge))
+#define GET(vertex)    (get(boost::vertex_name, *_g, vertex))
+#define GET_EDGE(edge) (get(boost::edge_attribute, *_g, edge))
 
 void CodeGenerator::onBeforeStartFunction(const Function&)
 {
@@ -46,13 +46,12 @@ std::string CodeGenerator::constructFuncSignature(const Function &)
 
 std::string CodeGenerator::indentString(std::string s)
 {
-    std::stringstream stream;
-    stream << std::string(kIndentAmount * _indentLevel, ' ') << s;
-    return stream.str();
+    return s.insert(0, kIndentAmount * _indentLevel, ' ');
 }
 
 CodeGenerator::CodeGenerator(Engine *engine, std::ostream &output, ArgOrder binOrder, ArgOrder callOrder)
-   : _output(output),
+   : _g(NULL),
+    _output(output),
     _binOrder(binOrder),
     _callOrder(callOrder)
 {
@@ -61,11 +60,111 @@ CodeGenerator::CodeGenerator(Engine *engine, std::ostream &output, ArgOrder binO
     mTargetLang = std::make_unique<CTargetLanguage>();
 }
 
-typedef std::pair<GraphVertex, ValueStack> DFSEntry;
+const uint32 CodeGenerator::kNoSnapshot;
 
-void CodeGenerator::generatePass(InstVec& insts, const Graph& g)
+void CodeGenerator::restoreSnapshot(uint32 snapshot)
 {
-    _g = g;
+    if (--_snapshotUsers[snapshot] == 0)
+    {
+        _stack.swap(_snapshots[snapshot]);
+        _freeSnapshots.push_back(snapshot);
+    }
+    else
+    {
+        _stack = _snapshots[snapshot];
+    }
+}
+
+GroupPtr CodeGenerator::processFunction(Function& func, InstVec& insts)
+{
+    GraphVertex entryPoint = func._v;
+    GroupPtr lastGroup = GET(entryPoint);
+
+    const size_t numWords = (_g->numVertexIds() + 63) / 64;
+    if (_visited.size() < numWords)
+    {
+        _visited.resize(numWords, 0);
+    }
+    auto visit = [&](GraphVertex v)
+    {
+        uint64_t& word = _visited[v / 64];
+        const uint64_t bit = uint64_t(1) << (v % 64);
+        if (word & bit)
+        {
+            return false;
+        }
+        word |= bit;
+        _visitedVertices.push_back(v);
+        return true;
+    };
+
+    // DFS from entry point to process each vertex. The successors of a vertex start from the stack
+    // it leaves: the one queued last is processed next and takes that stack over as it is, while
+    // the others share a single copy of it.
+    _stack = ValueStack();
+    _dfsStack.push_back(DFSEntry(entryPoint, kNoSnapshot));
+    visit(entryPoint);
+    while (!_dfsStack.empty())
+    {
+        DFSEntry e = _dfsStack.back();
+        _dfsStack.pop_back();
+        if (e.second != kNoSnapshot)
+        {
+            restoreSnapshot(e.second);
+        }
+        GroupPtr tmp = GET(e.first);
+        if ((*tmp->_start)->_address > (*lastGroup->_start)->_address)
+        {
+            lastGroup = tmp;
+        }
+        GraphVertex v = e.first;
+        process(func, insts, v);
+
+        const size_t firstQueued = _dfsStack.size();
+        OutEdgeRange r = out_edges(v, *_g);
+        for (OutEdgeIterator i = r.first; i != r.second; ++i)
+        {
+            GraphVertex targetVertex = target(*i, *_g);
+            if (visit(targetVertex))
+            {
+                _dfsStack.push_back(DFSEntry(targetVertex, kNoSnapshot));
+            }
+        }
+        if (_dfsStack.size() > firstQueued + 1)
+        {
+            const uint32 sharers = static_cast<uint32>(_dfsStack.size() - firstQueued - 1);
+            uint32 snapshot;
+            if (_freeSnapshots.empty())
+            {
+                snapshot = static_cast<uint32>(_snapshots.size());
+                _snapshots.push_back(_stack);
+                _snapshotUsers.push_back(sharers);
+            }
+            else
+            {
+                snapshot = _freeSnapshots.back();
+                _freeSnapshots.pop_back();
+                _snapshots[snapshot] = _stack;
+                _snapshotUsers[snapshot] = sharers;
+            }
+            for (size_t queued = firstQueued; queued + 1 < _dfsStack.size(); queued++)
+            {
+                _dfsStack[queued].second = snapshot;
+            }
+        }
+    }
+
+    for (GraphVertex v : _visitedVertices)
+    {
+        _visited[v / 64] = 0;
+    }
+    _visitedVertices.clear();
+    return lastGroup;
+}
+
+void CodeGenerator::generate(InstVec& insts, const Graph &g)
+{
+    _g = &g;
     for (FuncMap::iterator fn = _engine->_functions.begin(); fn != _engine->_functions.end(); ++fn)
     {
         while (!_stack.empty())
@@ -91,35 +190,7 @@ void CodeGenerator::generatePass(InstVec& insts, const Graph& g)
             onStartFunction(fn->second);
         }
 
-        GroupPtr lastGroup = GET(entryPoint);
-
-        // DFS from entry point to process each vertex
-        Stack<DFSEntry> dfsStack;
-        std::set<GraphVertex> seen;
-        dfsStack.push(DFSEntry(entryPoint, ValueStack()));
-        seen.insert(entryPoint);
-        while (!dfsStack.empty())
-        {
-            DFSEntry e = dfsStack.pop();
-            GroupPtr tmp = GET(e.first);
-            if ((*tmp->_start)->_address > (*lastGroup->_start)->_address)
-            {
-                lastGroup = tmp;
-            }
-            _stack = e.second;
-            GraphVertex v = e.first;
-            process(fn->second, insts, v);
-            OutEdgeRange r = boost::out_edges(v, _g);
-            for (OutEdgeIterator i = r.first; i != r.second; ++i)
-            {
-                GraphVertex target = boost::target(*i, _g);
-                if (seen.find(target) == seen.end())
-                {
-                    dfsStack.push(DFSEntry(target, _stack));
-                    seen.insert(target);
-                }
-            }
-        }
+        GroupPtr lastGroup = processFunction(fn->second, insts);
 
         // Write the function end
         if (printFuncSignature)
@@ -146,7 +217,9 @@ void CodeGenerator::generatePass(InstVec& insts, const Graph& g)
                 }
                 else
                 {
-                    _output << boost::format("%08X: %s") % (*p->_start)->_address % indentString(it->_line) << std::endl;
+                    char address[16];
+                    std::snprintf(address, sizeof(address), "%08X: ", (*p->_start)->_address);
+                    _output << address << indentString(it->_line) << std::endl;
                 }
 
                 if (it->_indentAfter)
@@ -159,27 +232,9 @@ void CodeGenerator::generatePass(InstVec& insts, const Graph& g)
     }
 }
 
-void CodeGenerator::generate(InstVec& insts, const Graph &g)
-{
-    if (OutputOnlyRequiredLabels())
-    {
-        // Call twice, once where no output is generated but instructions are
-        // marked as "needs label", then a 2nd time to actually output the code
-        mIsLabelPass = true;
-        generatePass(insts, g);
-    }
-    mIsLabelPass = false;
-    generatePass(insts, g);
-}
-
 void CodeGenerator::addOutputLine(std::string s, bool unindentBefore, bool indentAfter) 
 {
-    // We don't generate output in the labels pass, we just find instructions that
-    // require a label to be outputted
-    if (!mIsLabelPass)
-    {
-        mCurGroup->_code.push_back(CodeLine(s, unindentBefore, indentAfter));
-    }
+    mCurGroup->_code.push_back(CodeLine(std::move(s), unindentBefore, indentAfter));
 }
 
 void CodeGenerator::writeAssignment(ValuePtr dst, ValuePtr src) 
@@ -197,17 +252,26 @@ void CodeGenerator::process(Function& func, InstVec& insts, GraphVertex v)
     // Check if we should add else start
     if (mCurGroup->_startElse)
     {
-        addOutputLine(mTargetLang->EndBlock(ITargetLanaguge::eToElseBlock) + " " + mTargetLang->Else() + " " + mTargetLang->StartBlock(ITargetLanaguge::eBeginElse), true, true);
+        // Languages without block delimiters have nothing either side of the else
+        std::string elseLine = mTargetLang->EndBlock(ITargetLanaguge::eToElseBlock);
+        for (const std::string& part : { mTargetLang->Else(), mTargetLang->StartBlock(ITargetLanaguge::eBeginElse) })
+        {
+            if (!part.empty())
+            {
+                elseLine += (elseLine.empty() ? "" : " ") + part;
+            }
+        }
+        addOutputLine(elseLine, true, true);
     }
 
     // Check ingoing edges to see if we want to add any extra output
-    InEdgeRange ier = boost::in_edges(v, _g);
+    InEdgeRange ier = in_edges(v, *_g);
     for (InEdgeIterator ie = ier.first; ie != ier.second; ++ie)
     {
-        GraphVertex in = boost::source(*ie, _g);
+        GraphVertex in = source(*ie, *_g);
         GroupPtr inGroup = GET(in);
 
-        if (!boost::get(boost::edge_attribute, _g, *ie)._isJump || inGroup->_stackLevel == -1)
+        if (!GET_EDGE(*ie)._isJump || inGroup->_stackLevel == -1)
         {
             continue;
         }
@@ -234,10 +298,9 @@ void CodeGenerator::process(Function& func, InstVec& insts, GraphVertex v)
     ConstInstIterator it = mCurGroup->_start;
     do 
     {
-        // If we only want to write labels that targets of goto's then check if this is the pass
-        // after we've setup mLabelRequired on each instruction. If this is set then it needs a label
-        // so write one out.
-        if (OutputOnlyRequiredLabels() && !mIsLabelPass && (*it)->mLabelRequired)
+        // If we only want to write labels that are targets of goto's then write one where the
+        // disassembler found an unconditional jump to the instruction
+        if (OutputOnlyRequiredLabels() && (*it)->mLabelRequired)
         {
             addOutputLine(mTargetLang->Label((*it)->_address));
         }
@@ -267,14 +330,14 @@ void CodeGenerator::processUncondJumpInst(Function& func, InstVec& insts, const
     default: // Might be a goto
     {
         bool printJump = true;
-        OutEdgeRange jumpTargets = boost::out_edges(_curVertex, _g);
-        for (OutEdgeIterator target = jumpTargets.first; target != jumpTargets.second && printJump; ++target)
+        OutEdgeRange jumpTargets = out_edges(_curVertex, *_g);
+        for (OutEdgeIterator jumpTarget = jumpTargets.first; jumpTarget != jumpTargets.second && printJump; ++jumpTarget)
         {
             Group* next = mCurGroup->_next;
             if (next)
             {
                 // Don't output jump to next vertex
-                if (boost::target(*target, _g) == next->_vertex)
+                if (target(*jumpTarget, *_g) == next->_vertex)
                 {
                     printJump = false;
                     break;
@@ -287,11 +350,11 @@ void CodeGenerator::processUncondJumpInst(Function& func, InstVec& insts, const
                     break;
                 }
 
-                OutEdgeRange targetR = boost::out_edges(boost::target(*target, _g), _g);
+                OutEdgeRange targetR = out_edges(target(*jumpTarget, *_g), *_g);
                 for (OutEdgeIterator targetE = targetR.first; targetE != targetR.second; ++targetE)
                 {
                     // Don't output jump to while loop that has jump to next vertex
-                    if (boost::target(*targetE, _g) == next->_vertex)
+                    if (target(*targetE, *_g) == next->_vertex)
                     {
                         printJump = false;
                     }
@@ -312,26 +375,18 @@ void CodeGenerator::processUncondJumpInst(Function& func, InstVec& insts, const
 
         if (printJump)
         {
-            const uint32 dstAddr = inst->getDestAddress();
-            if (mIsLabelPass)
-            {
-                // Mark the goto target
-                for (auto& i : insts)
-                {
-                    if (i->_address == dstAddr)
-                    {
-                        i->mLabelRequired = true;
-                        break;
-                    }
-                }
-            }
-            addOutputLine(mTargetLang->Goto(dstAddr));
+            processGoto(insts, inst->getDestAddress());
         }
     }
         break;
     }
 }
 
+void CodeGenerator::processGoto(InstVec&, uint32 dstAddr)
+{
+    addOutputLine(mTargetLang->Goto(dstAddr));
+}
+
 void CodeGenerator::writeFunctionCall(std::string functionName, std::string paramsFormat, const std::vector<ValuePtr>& params)
 {
     std::string strFuncCall = functionName + mTargetLang->FunctionCallBegin();
@@ -385,11 +440,11 @@ void CodeGenerator::processCondJumpInst(const InstPtr inst)
     case kIfCondGroupType:
         if (mCurGroup->_startElse && mCurGroup->_code.size() == 1)
         {
-            OutEdgeRange oer = boost::out_edges(_curVertex, _g);
+            OutEdgeRange oer = out_edges(_curVertex, *_g);
             bool coalesceElse = false;
             for (OutEdgeIterator oe = oer.first; oe != oer.second; ++oe)
             {
-                GroupPtr oGr = GET(boost::target(*oe, _g))->_prev;
+                GroupPtr oGr = GET(target(*oe, *_g))->_prev;
                 if (std::find(oGr->_endElse.begin(), oGr->_endElse.end(), mCurGroup.get()) != oGr->_endElse.end())
                 {
                     coalesceElse = true;
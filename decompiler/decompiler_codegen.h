@@ -27,6 +27,7 @@
 
 #include <ostream>
 #include <utility>
+#include <vector>
 
 #include <boost/intrusive_ptr.hpp>
 #include <memory>
@@ -281,7 +282,17 @@ public:
 class CodeGenerator 
 {
 private:
-    Graph _g;                  ///< The annotated graph of the script.
+    typedef std::pair<GraphVertex, uint32> DFSEntry; ///< A vertex waiting to be processed, and the index in _snapshots of its stack or kNoSnapshot.
+
+    static const uint32 kNoSnapshot = 0xFFFFFFFF; ///< The vertex is processed next, with _stack as its parent left it.
+
+    // Kept between functions so their storage is reused
+    std::vector<DFSEntry> _dfsStack;            ///< Vertices waiting to be processed by processFunction.
+    std::vector<uint64_t> _visited;             ///< Bit per vertex id, set once processFunction has queued the vertex.
+    std::vector<GraphVertex> _visitedVertices;  ///< The vertices whose bit is set in _visited.
+    std::vector<ValueStack> _snapshots;         ///< Stacks shared by the queued vertices.
+    std::vector<uint32> _snapshotUsers;         ///< Number of queued vertices sharing each stack in _snapshots.
+    std::vector<uint32> _freeSnapshots;         ///< Indices in _snapshots not in use.
 
     /**
      * Processes a GraphVertex.
@@ -290,7 +301,15 @@ private:
      */
     void process(Function& func, InstVec& insts, GraphVertex v);
 
+    /**
+     * Makes a stack in _snapshots the current stack, copying it only if other queued vertices still share it.
+     *
+     * @param snapshot Index in _snapshots of the stack.
+     */
+    void restoreSnapshot(uint32 snapshot);
+
 protected:
+    const Graph *_g;        ///< The annotated graph of the script, owned by the caller of generate().
     Engine *_engine;        ///< Pointer to the Engine used for the script.
     std::ostream &_output;  ///< The std::ostream to output the code to.
     ValueStack _stack;      ///< The stack currently being processed.
@@ -307,7 +326,25 @@ protected:
      */
     void processInst(Function& func, InstVec& insts, const InstPtr inst);
     void processUncondJumpInst(Function& func, InstVec& insts, const InstPtr inst);
-    void processCondJumpInst(const InstPtr inst);
+    virtual void processCondJumpInst(const InstPtr inst);
+
+    /**
+     * Outputs a goto for an unconditional jump that isn't part of a detected construct.
+     *
+     * @param insts   The instructions of the script, the target is marked as needing a label in the label pass.
+     * @param dstAddr The address jumped to.
+     */
+    virtual void processGoto(InstVec& insts, uint32 dstAddr);
+
+    /**
+     * Processes the groups reachable from the entry point of a function, in depth-first order.
+     * The code of each group is left in its _code.
+     *
+     * @param func  The function to process.
+     * @param insts The instructions of the script.
+     * @returns The processed group with the highest address.
+     */
+    GroupPtr processFunction(Function& func, InstVec& insts);
 
     /**
      * Indents a string according to the current indentation level.
@@ -326,10 +363,9 @@ protected:
     virtual void onBeforeStartFunction(const Function& func);
     virtual void onEndFunction(const Function& func);
     virtual void onStartFunction(const Function&) { }
-    virtual bool OutputOnlyRequiredLabels() const { return false; }
 
-    void generatePass(InstVec& insts, const Graph& g);
-    bool mIsLabelPass = true;
+    // Whether to write labels only before instructions with mLabelRequired set, rather than every line's address
+    virtual bool OutputOnlyRequiredLabels() const { return false; }
 
 public:
     ITargetLanaguge& TargetLang()
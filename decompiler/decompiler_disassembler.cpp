@@ -27,7 +27,7 @@ Disassembler::Disassembler(InstVec &insts) : _insts(insts) {
 }
 
 void Disassembler::open(const char *filename) {
-    mStream = std::make_unique<BinaryReader>(BinaryReader::ReadAll(filename));
+    mStream = std::make_unique<BinaryReader>(std::make_unique<MappedFile>(filename));
 }
 
 void Disassembler::doDumpDisassembly(std::ostream &output) {
@@ -25,10 +25,15 @@
 #include "decompiler_disassembler.h"
 #include "decompiler_codegen.h"
 
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+namespace FF7 {
+class FunctionMetaData;
+}
+
 /**
  * Structure representing a function.
  */
@@ -38,13 +43,15 @@ public:
     uint32 mStartAddr = 0;
     uint32 mEndAddr = 0;
     uint32 mNumInstructions = 0;
+    uint32 mFirstInstruction = 0; ///< Index of the function's first instruction, its instructions are the mNumInstructions from there.
 	//InstIterator _startIt; ///< Iterator to of the first instruction in the function, if available.
 	//InstIterator _endIt;   ///< Iterator to the instruction immediately after the function, similar to end() on STL containers. If _endIt == _startIt, the function endpoint is assumed to be unknown.
 	std::string _name;          ///< Function name.
 	GraphVertex _v;             ///< Graph vertex for the entry point to the function.
 	uint32 _args;               ///< Number of arguments to the function.
 	bool _retVal;               ///< Whether or not the function returns a value.
-	std::string _metadata;      ///< Metadata for code generation.
+	Symbol _metadata;           ///< Metadata for code generation.
+	std::shared_ptr<const FF7::FunctionMetaData> mMetaData; ///< _metadata parsed once, for FF7 field scripts.
 
 	/**
 	 * Parameterless constructor for Function. Required for use with STL, should not be called manually.
@@ -129,6 +136,8 @@ public:
 
 	std::string _variant; ///< Engine variant to use for the script.
 
+	bool _outputStackEffect = true; ///< Whether printed instructions should show their stack effect, see StackEffect.
+
 	/**
 	 * Whether or not to use "pure" grouping during code flow analysis.
 	 * With pure grouping, code flow analysis only looks at branches when merging.
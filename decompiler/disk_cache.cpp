@@ -0,0 +1,432 @@
+#include "sudm.h"
+#include "decompiler/hash.h"
+#include "common/binaryreader.h"
+#include "common/mappedfile.h"
+#include "make_unique.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef SUDM_VERSION_MAJOR
+#define SUDM_VERSION_MAJOR 0
+#endif
+#ifndef SUDM_VERSION_MINOR
+#define SUDM_VERSION_MINOR 0
+#endif
+
+namespace SUDM
+{
+    namespace FF7
+    {
+        namespace Field
+        {
+            namespace
+            {
+                // Bump whenever the Lua generated for the same input changes, so old caches aren't used
+                const uint32_t kOutputVersion = 1;
+
+                // Bump whenever the layout below changes
+                const uint32_t kFileVersion = 1;
+                const char kMagic[8] = { 'S', 'U', 'D', 'M', 'C', 'A', 'C', 'H' };
+
+                // Header: magic, file version, entry count, index offset
+                const size_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+                // Index entry: key, offset of the entry from the file start, entry size
+                const size_t kIndexEntrySize = 3 * sizeof(uint64_t);
+
+                // Little endian, so caches can be shared between machines
+                class ByteWriter
+                {
+                public:
+                    explicit ByteWriter(std::vector<unsigned char>& bytes)
+                        : mBytes(bytes)
+                    {
+
+                    }
+
+                    void U32(uint32_t value)
+                    {
+                        for (int i = 0; i < 4; i++)
+                        {
+                            mBytes.push_back(static_cast<unsigned char>(value >> (i * 8)));
+                        }
+                    }
+
+                    void U64(uint64_t value)
+                    {
+                        U32(static_cast<uint32_t>(value));
+                        U32(static_cast<uint32_t>(value >> 32));
+                    }
+
+                    void String(const std::string& str)
+                    {
+                        U32(static_cast<uint32_t>(str.size()));
+                        mBytes.insert(mBytes.end(), str.begin(), str.end());
+                    }
+
+                private:
+                    std::vector<unsigned char>& mBytes;
+                };
+
+                uint64_t ReadU64(const unsigned char* data)
+                {
+                    uint64_t value = 0;
+                    for (int i = 7; i >= 0; i--)
+                    {
+                        value = (value << 8) | data[i];
+                    }
+                    return value;
+                }
+
+                std::string ReadString(BinaryReader& reader)
+                {
+                    std::string str(reader.ReadU32(), '\0');
+                    for (char& c : str)
+                    {
+                        c = static_cast<char>(reader.ReadU8());
+                    }
+                    return str;
+                }
+
+                std::vector<unsigned char> Serialize(const CachedScript& cached)
+                {
+                    std::vector<unsigned char> bytes;
+                    ByteWriter writer(bytes);
+                    writer.String(cached.script.luaScript);
+                    writer.U32(static_cast<uint32_t>(cached.script.entities.size()));
+                    for (const auto& entity : cached.script.entities)
+                    {
+                        writer.String(entity.first);
+                        writer.U32(static_cast<uint32_t>(entity.second));
+                    }
+                    writer.U32(static_cast<uint32_t>(cached.spawnPoints.size()));
+                    for (const auto& sp : cached.spawnPoints)
+                    {
+                        writer.U32(sp.targetMapId);
+                        writer.String(sp.entity);
+                        writer.String(sp.funcName);
+                        writer.U32(sp.address);
+                        writer.U32(static_cast<uint32_t>(sp.x));
+                        writer.U32(static_cast<uint32_t>(sp.y));
+                        writer.U32(static_cast<uint32_t>(sp.triangleId));
+                        writer.U32(static_cast<uint32_t>(sp.angle));
+                    }
+                    return bytes;
+                }
+
+                // Throws InternalDecompilerError if the entry runs off the end
+                CachedScript Deserialize(const unsigned char* data, size_t size)
+                {
+                    BinaryReader reader(data, size);
+                    CachedScript cached;
+                    cached.script.luaScript = ReadString(reader);
+                    const uint32_t numEntities = reader.ReadU32();
+                    for (uint32_t i = 0; i < numEntities; i++)
+                    {
+                        std::string name = ReadString(reader);
+                        cached.script.entities[name] = reader.ReadS32();
+                    }
+                    const uint32_t numSpawnPoints = reader.ReadU32();
+                    for (uint32_t i = 0; i < numSpawnPoints; i++)
+                    {
+                        CachedFunction::SpawnPoint sp;
+                        sp.targetMapId = reader.ReadU32();
+                        sp.entity = ReadString(reader);
+                        sp.funcName = ReadString(reader);
+                        sp.address = reader.ReadU32();
+                        sp.x = reader.ReadS32();
+                        sp.y = reader.ReadS32();
+                        sp.triangleId = reader.ReadS32();
+                        sp.angle = reader.ReadS32();
+                        cached.spawnPoints.push_back(sp);
+                    }
+                    return cached;
+                }
+            }
+
+            DiskCache::DiskCache(const std::string& fileName)
+                : mFileName(fileName)
+            {
+                Open();
+            }
+
+            DiskCache::~DiskCache()
+            {
+                try
+                {
+                    Save();
+                }
+                catch (const std::exception&)
+                {
+                    // Losing the new entries only costs decompiling them again next time
+                }
+            }
+
+            uint64_t DiskCache::Key(const std::string& scriptName, const std::vector<unsigned char>& scriptBytes, IScriptFormatter& formatter,
+                ControlFlowMode mode)
+            {
+                Fnv1a hash;
+                hash.Add(kOutputVersion);
+                hash.Add(static_cast<uint32_t>(SUDM_VERSION_MAJOR));
+                hash.Add(static_cast<uint32_t>(SUDM_VERSION_MINOR));
+                hash.Add(formatter.Fingerprint());
+                hash.Add(static_cast<uint32_t>(mode));
+                hash.Add(scriptName);
+                hash.Add(static_cast<uint64_t>(scriptBytes.size()));
+                hash.Add(scriptBytes.data(), scriptBytes.size());
+                return hash.Value();
+            }
+
+            void DiskCache::Open()
+            {
+                mFile.reset();
+                mSavedCount = 0;
+                mIndexOffset = 0;
+                if (!std::ifstream(mFileName, std::ios::binary).is_open())
+                {
+                    return;
+                }
+
+                std::unique_ptr<MappedFile> file;
+                try
+                {
+                    file = std::make_unique<MappedFile>(mFileName);
+                }
+                catch (const std::exception&)
+                {
+                    return;
+                }
+
+                const unsigned char* data = file->Data();
+                const size_t size = file->Size();
+                if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0)
+                {
+                    return;
+                }
+
+                BinaryReader header(data + sizeof(kMagic), kHeaderSize - sizeof(kMagic));
+                if (header.ReadU32() != kFileVersion)
+                {
+                    return;
+                }
+                const size_t count = header.ReadU32();
+                const uint64_t indexOffset = ReadU64(data + sizeof(kMagic) + 2 * sizeof(uint32_t));
+                if (indexOffset < kHeaderSize || indexOffset > size || (size - indexOffset) / kIndexEntrySize < count)
+                {
+                    return;
+                }
+
+                mFile = std::move(file);
+                mSavedCount = count;
+                mIndexOffset = static_cast<size_t>(indexOffset);
+            }
+
+            bool DiskCache::FindSaved(uint64_t key, size_t& offset, size_t& size) const
+            {
+                if (!mFile)
+                {
+                    return false;
+                }
+
+                // Binary search of the mapped index
+                const unsigned char* index = mFile->Data() + mIndexOffset;
+                size_t first = 0;
+                size_t last = mSavedCount;
+                while (first < last)
+                {
+                    const size_t middle = first + (last - first) / 2;
+                    const uint64_t middleKey = ReadU64(index + middle * kIndexEntrySize);
+                    if (middleKey < key)
+                    {
+                        first = middle + 1;
+                    }
+                    else if (middleKey > key)
+                    {
+                        last = middle;
+                    }
+                    else
+                    {
+                        const uint64_t entryOffset = ReadU64(index + middle * kIndexEntrySize + sizeof(uint64_t));
+                        const uint64_t entrySize = ReadU64(index + middle * kIndexEntrySize + 2 * sizeof(uint64_t));
+                        if (entryOffset > mIndexOffset || entrySize > mIndexOffset - entryOffset)
+                        {
+                            return false;
+                        }
+                        offset = static_cast<size_t>(entryOffset);
+                        size = static_cast<size_t>(entrySize);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool DiskCache::Find(uint64_t key, CachedScript& script)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                try
+                {
+                    auto unsaved = mUnsaved.find(key);
+                    if (unsaved != std::end(mUnsaved))
+                    {
+                        script = Deserialize(unsaved->second.data(), unsaved->second.size());
+                        mHits++;
+                        return true;
+                    }
+
+                    size_t offset = 0;
+                    size_t size = 0;
+                    if (FindSaved(key, offset, size))
+                    {
+                        script = Deserialize(mFile->Data() + offset, size);
+                        mHits++;
+                        return true;
+                    }
+                }
+                catch (const InternalDecompilerError&)
+                {
+                    // A damaged entry is just a miss, Insert replaces it
+                }
+                mMisses++;
+                return false;
+            }
+
+            void DiskCache::Insert(uint64_t key, const CachedScript& script)
+            {
+                std::vector<unsigned char> bytes = Serialize(script);
+                std::lock_guard<std::mutex> lock(mMutex);
+                mUnsaved[key] = std::move(bytes);
+            }
+
+            void DiskCache::Save()
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mUnsaved.empty())
+                {
+                    return;
+                }
+
+                struct IndexEntry
+                {
+                    uint64_t mKey;
+                    uint64_t mOffset;
+                    uint64_t mSize;
+                };
+                std::vector<IndexEntry> index;
+
+                // Saved entries are copied across as they are, unless a new entry replaces them
+                std::vector<unsigned char> bytes(kHeaderSize);
+                if (mFile)
+                {
+                    const unsigned char* savedIndex = mFile->Data() + mIndexOffset;
+                    for (size_t i = 0; i < mSavedCount; i++)
+                    {
+                        const uint64_t key = ReadU64(savedIndex + i * kIndexEntrySize);
+                        size_t offset = 0;
+                        size_t size = 0;
+                        if (mUnsaved.count(key) || !FindSaved(key, offset, size))
+                        {
+                            continue;
+                        }
+                        index.push_back({ key, bytes.size(), size });
+                        bytes.insert(bytes.end(), mFile->Data() + offset, mFile->Data() + offset + size);
+                    }
+                }
+                for (const auto& entry : mUnsaved)
+                {
+                    index.push_back({ entry.first, bytes.size(), entry.second.size() });
+                    bytes.insert(bytes.end(), entry.second.begin(), entry.second.end());
+                }
+                std::sort(index.begin(), index.end(), [](const IndexEntry& a, const IndexEntry& b) { return a.mKey < b.mKey; });
+
+                const uint64_t indexOffset = bytes.size();
+                ByteWriter writer(bytes);
+                for (const auto& entry : index)
+                {
+                    writer.U64(entry.mKey);
+                    writer.U64(entry.mOffset);
+                    writer.U64(entry.mSize);
+                }
+
+                std::vector<unsigned char> header;
+                ByteWriter headerWriter(header);
+                header.insert(header.end(), kMagic, kMagic + sizeof(kMagic));
+                headerWriter.U32(kFileVersion);
+                headerWriter.U32(static_cast<uint32_t>(index.size()));
+                headerWriter.U64(indexOffset);
+                std::copy(header.begin(), header.end(), bytes.begin());
+
+                // Write next to the old file and swap it in, so a failed save never leaves half a cache
+                const std::string tempFileName = mFileName + ".tmp";
+                {
+                    std::ofstream out(tempFileName, std::ios::binary | std::ios::trunc);
+                    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+                    if (!out)
+                    {
+                        throw std::runtime_error("Can't write " + tempFileName);
+                    }
+                }
+
+                // Windows can't replace a file that is still mapped, or replace one at all with rename
+                mFile.reset();
+                if (std::rename(tempFileName.c_str(), mFileName.c_str()) != 0)
+                {
+                    std::remove(mFileName.c_str());
+                    if (std::rename(tempFileName.c_str(), mFileName.c_str()) != 0)
+                    {
+                        Open();
+                        throw std::runtime_error("Can't replace " + mFileName);
+                    }
+                }
+                mUnsaved.clear();
+                Open();
+            }
+
+            size_t DiskCache::Size() const
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                size_t size = mSavedCount;
+                for (const auto& entry : mUnsaved)
+                {
+                    size_t offset = 0;
+                    size_t entrySize = 0;
+                    if (!FindSaved(entry.first, offset, entrySize))
+                    {
+                        size++;
+                    }
+                }
+                return size;
+            }
+
+            size_t DiskCache::Hits() const
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                return mHits;
+            }
+
+            size_t DiskCache::Misses() const
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                return mMisses;
+            }
+
+            std::string DiskCache::Report() const
+            {
+                const size_t hits = Hits();
+                const size_t misses = Misses();
+                const size_t lookups = hits + misses;
+                std::stringstream report;
+                report << mFileName << ": " << hits << " hits, " << misses << " misses";
+                if (lookups > 0)
+                {
+                    report << " (" << (100 * hits / lookups) << "% hit rate)";
+                }
+                report << ", " << Size() << " entries";
+                return report.str();
+            }
+        }
+    }
+}
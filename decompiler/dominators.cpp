@@ -0,0 +1,281 @@
+#include "decompiler/dominators.h"
+#include <utility>
+
+const uint32_t DominatorTree::kNone;
+
+DominatorTree::DominatorTree(const std::vector<uint32_t>& succBegin, const std::vector<uint32_t>& succs, const std::vector<uint32_t>& roots,
+    const std::function<void(size_t)>& spendSteps)
+{
+    // Steps are passed on a batch at a time, as a call per vertex costs about as much as the work it counts
+    const size_t kStepsPerBatch = 1024;
+    size_t steps = 0;
+    auto spend = [&](size_t batch)
+    {
+        if (steps >= batch)
+        {
+            if (spendSteps)
+            {
+                spendSteps(steps);
+            }
+            steps = 0;
+        }
+    };
+
+    const uint32_t numVertices = static_cast<uint32_t>(succBegin.size() - 1);
+
+    // Predecessors, CSR style like the successors
+    std::vector<uint32_t> predBegin(numVertices + 1, 0);
+    for (uint32_t succ : succs)
+    {
+        predBegin[succ + 1]++;
+    }
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        predBegin[v + 1] += predBegin[v];
+    }
+    std::vector<uint32_t> preds(succs.size());
+    {
+        std::vector<uint32_t> fill(predBegin.begin(), predBegin.end() - 1);
+        for (uint32_t v = 0; v < numVertices; v++)
+        {
+            for (uint32_t i = succBegin[v]; i < succBegin[v + 1]; i++)
+            {
+                preds[fill[succs[i]]++] = v;
+            }
+        }
+    }
+
+    // Number the vertices in postorder of a depth first search from each root, then from each
+    // vertex still unreached
+    std::vector<uint32_t> postorder;
+    postorder.reserve(numVertices);
+    std::vector<uint32_t> postNumber(numVertices, kNone);
+    std::vector<bool> reached(numVertices, false);
+    std::vector<bool> isRoot(numVertices, false);
+    std::vector<std::pair<uint32_t, uint32_t>> stack; // Vertex and the position of its next successor
+    auto search = [&](uint32_t root)
+    {
+        if (reached[root])
+        {
+            return;
+        }
+        reached[root] = true;
+        isRoot[root] = true;
+        stack.push_back(std::make_pair(root, succBegin[root]));
+        while (!stack.empty())
+        {
+            const uint32_t v = stack.back().first;
+            uint32_t& next = stack.back().second;
+            if (next < succBegin[v + 1])
+            {
+                const uint32_t succ = succs[next++];
+                if (!reached[succ])
+                {
+                    reached[succ] = true;
+                    stack.push_back(std::make_pair(succ, succBegin[succ]));
+                }
+            }
+            else
+            {
+                postNumber[v] = static_cast<uint32_t>(postorder.size());
+                postorder.push_back(v);
+                stack.pop_back();
+            }
+        }
+    };
+    for (uint32_t root : roots)
+    {
+        search(root);
+    }
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        search(v);
+    }
+
+    // Immediate dominators by postorder number, with a virtual root numbered after every vertex
+    // that dominates the real roots
+    const uint32_t virtualRoot = numVertices;
+    std::vector<uint32_t> doms(numVertices + 1, kNone);
+    doms[virtualRoot] = virtualRoot;
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        if (isRoot[v])
+        {
+            doms[postNumber[v]] = virtualRoot;
+        }
+    }
+    auto intersect = [&](uint32_t a, uint32_t b)
+    {
+        while (a != b)
+        {
+            while (a < b)
+            {
+                a = doms[a];
+                steps++;
+            }
+            while (b < a)
+            {
+                b = doms[b];
+                steps++;
+            }
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (uint32_t number = numVertices; number-- > 0;)
+        {
+            const uint32_t v = postorder[number];
+            if (isRoot[v])
+            {
+                continue;
+            }
+            uint32_t idom = kNone;
+            for (uint32_t i = predBegin[v]; i < predBegin[v + 1]; i++)
+            {
+                const uint32_t pred = postNumber[preds[i]];
+                if (doms[pred] != kNone)
+                {
+                    idom = idom == kNone ? pred : intersect(pred, idom);
+                }
+            }
+            steps += predBegin[v + 1] - predBegin[v];
+            spend(kStepsPerBatch);
+            if (doms[number] != idom)
+            {
+                doms[number] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    mIDom.assign(numVertices, kNone);
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        const uint32_t idom = doms[postNumber[v]];
+        if (idom != virtualRoot)
+        {
+            mIDom[v] = postorder[idom];
+        }
+    }
+
+    // Number the dominator tree in pre and postorder, the children of the virtual root being the roots
+    std::vector<uint32_t> childBegin(numVertices + 2, 0);
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        childBegin[(mIDom[v] == kNone ? virtualRoot : mIDom[v]) + 1]++;
+    }
+    for (uint32_t v = 0; v <= numVertices; v++)
+    {
+        childBegin[v + 1] += childBegin[v];
+    }
+    std::vector<uint32_t> children(numVertices);
+    {
+        std::vector<uint32_t> fill(childBegin.begin(), childBegin.end() - 1);
+        for (uint32_t v = 0; v < numVertices; v++)
+        {
+            children[fill[mIDom[v] == kNone ? virtualRoot : mIDom[v]]++] = v;
+        }
+    }
+    mPreorder.assign(numVertices + 1, 0);
+    mPostorder.assign(numVertices + 1, 0);
+    uint32_t preCount = 0;
+    uint32_t postCount = 0;
+    stack.push_back(std::make_pair(virtualRoot, childBegin[virtualRoot]));
+    mPreorder[virtualRoot] = preCount++;
+    while (!stack.empty())
+    {
+        const uint32_t v = stack.back().first;
+        uint32_t& next = stack.back().second;
+        if (next < childBegin[v + 1])
+        {
+            const uint32_t child = children[next++];
+            mPreorder[child] = preCount++;
+            stack.push_back(std::make_pair(child, childBegin[child]));
+        }
+        else
+        {
+            mPostorder[v] = postCount++;
+            stack.pop_back();
+        }
+    }
+
+    // Every back edge retreats in the depth first search, so without a retreating edge there are no loops
+    mLoopHeader.assign(numVertices, kNone);
+    mParentLoop.assign(numVertices, kNone);
+    bool retreats = false;
+    for (uint32_t v = 0; v < numVertices && !retreats; v++)
+    {
+        for (uint32_t i = succBegin[v]; i < succBegin[v + 1]; i++)
+        {
+            retreats = retreats || postNumber[succs[i]] >= postNumber[v];
+        }
+    }
+    steps += succs.size();
+    if (!retreats)
+    {
+        spend(0);
+        return;
+    }
+
+    // Loops, innermost first: a loop's header comes before the headers of loops around it in
+    // postorder, since those dominate it. Each vertex's representative in the union-find is the
+    // header of the outermost loop found so far that contains it, or the vertex itself.
+    std::vector<uint32_t> representative(numVertices);
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        representative[v] = v;
+    }
+    auto find = [&](uint32_t v)
+    {
+        while (representative[v] != v)
+        {
+            representative[v] = representative[representative[v]];
+            v = representative[v];
+        }
+        return v;
+    };
+    std::vector<uint32_t> work;
+    for (uint32_t header : postorder)
+    {
+        for (uint32_t i = predBegin[header]; i < predBegin[header + 1]; i++)
+        {
+            if (Dominates(header, preds[i]))
+            {
+                mLoopHeader[header] = header;
+                work.push_back(preds[i]);
+            }
+        }
+        while (!work.empty())
+        {
+            const uint32_t v = find(work.back());
+            work.pop_back();
+            steps++;
+            if (v == header)
+            {
+                continue;
+            }
+            representative[v] = header;
+            if (IsLoopHeader(v))
+            {
+                mParentLoop[v] = header;
+            }
+            else
+            {
+                mLoopHeader[v] = header;
+            }
+            for (uint32_t i = predBegin[v]; i < predBegin[v + 1]; i++)
+            {
+                // Only irreducible graphs enter a loop other than through its header
+                if (Dominates(header, preds[i]))
+                {
+                    work.push_back(preds[i]);
+                }
+            }
+        }
+        spend(kStepsPerBatch);
+    }
+    spend(0);
+}
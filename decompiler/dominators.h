@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Dominator tree and loop nesting forest of a directed graph whose vertices are numbered from 0,
+ * given as successor lists one after another, CSR style. Vertices the roots don't reach become
+ * roots themselves, in order, so every vertex has a place in both.
+ *
+ * Immediate dominators come from the iterative algorithm of Cooper, Harvey and Kennedy over a
+ * reverse postorder, which settles in two passes on the reducible graphs structured code makes.
+ * Dominator tree vertices are numbered in pre and postorder, so whether one vertex dominates
+ * another is a constant time check.
+ *
+ * Loops are natural loops: a back edge is an edge to a vertex dominating its source, which is the
+ * loop's header, and the loop is every vertex reaching the back edge without passing the header.
+ * Loops are found innermost first and collapsed into their header with a union-find, as in
+ * Havlak's algorithm, so each vertex is visited once per loop it is the outermost vertex of.
+ * Loops of an irreducible graph, entered other than through one header, aren't found.
+ */
+class DominatorTree
+{
+public:
+    static const uint32_t kNone = 0xFFFFFFFF;
+
+    /**
+     * @param succBegin Where each vertex's successors start in succs, and then where the last one's end.
+     * @param succs     The successors of every vertex.
+     * @param roots     The vertices the graph is entered at.
+     * @param spendSteps Told of the work done as it goes, one step per edge looked at or dominator walked
+     *                   up, so the caller can give up on graphs that take too long by throwing.
+     */
+    DominatorTree(const std::vector<uint32_t>& succBegin, const std::vector<uint32_t>& succs, const std::vector<uint32_t>& roots,
+        const std::function<void(size_t)>& spendSteps = std::function<void(size_t)>());
+
+    // The immediate dominator of v, kNone for a root
+    uint32_t IDom(uint32_t v) const { return mIDom[v]; }
+
+    // Whether every path from a root to b goes through a, so a vertex dominates itself
+    bool Dominates(uint32_t a, uint32_t b) const
+    {
+        return mPreorder[a] <= mPreorder[b] && mPostorder[b] <= mPostorder[a];
+    }
+
+    // The header of the innermost loop containing v, v itself if it is a header, kNone outside loops
+    uint32_t LoopHeader(uint32_t v) const { return mLoopHeader[v]; }
+
+    // The header of the loop directly around the loop of header, kNone for an outermost loop
+    uint32_t ParentLoop(uint32_t header) const { return mParentLoop[header]; }
+
+    bool IsLoopHeader(uint32_t v) const { return mLoopHeader[v] == v; }
+
+private:
+    std::vector<uint32_t> mIDom;
+    std::vector<uint32_t> mPreorder;   // Of the dominator tree
+    std::vector<uint32_t> mPostorder;  // Of the dominator tree
+    std::vector<uint32_t> mLoopHeader;
+    std::vector<uint32_t> mParentLoop;
+};
@@ -1,11 +1,13 @@
 #include "ff7_field_codegen.h"
 #include "ff7_field_engine.h"
+#include "thread_pool.h"
 #include <boost/algorithm/string/predicate.hpp>
+#include <algorithm>
 
 void FF7::FF7CodeGenerator::onBeforeStartFunction(const Function& func)
 {
     // Start class
-    FunctionMetaData metaData(func._metadata);
+    const FunctionMetaData& metaData = *func.mMetaData;
     if (metaData.IsStart())
     {
         addOutputLine("EntityContainer[ \"" + metaData.EntityName() + "\" ] = {", false, true);
@@ -20,14 +22,11 @@ void FF7::FF7CodeGenerator::onBeforeStartFunction(const Function& func)
 void FF7::FF7CodeGenerator::onStartFunction(const Function& func)
 {
     addOutputLine("--[[");
-    for (const auto& inst : mInsts)
+    for (uint32 i = func.mFirstInstruction; i < func.mFirstInstruction + func.mNumInstructions; ++i)
     {
-        if (inst->_address >= func.mStartAddr && inst->_address <= func.mEndAddr)
-        {
-            std::stringstream output;
-            output << inst;
-            addOutputLine(output.str());
-        }
+        std::stringstream output;
+        output << StackEffect(_engine->_outputStackEffect) << mInsts[i];
+        addOutputLine(output.str());
     }
     addOutputLine("]]\n");
 }
@@ -38,7 +37,7 @@ void FF7::FF7CodeGenerator::onEndFunction(const Function& func)
     addOutputLine("end,", true, false);
     
     // End class
-    FunctionMetaData metaData(func._metadata);
+    const FunctionMetaData& metaData = *func.mMetaData;
     if (metaData.IsEnd())
     {
         addOutputLine("}", true, false);
@@ -51,116 +50,322 @@ std::string FF7::FF7CodeGenerator::constructFuncSignature(const Function &func)
     return func._name + " = function( self )";
 }
 
-void FF7::FF7SimpleCodeGenerator::generate(InstVec& insts, const Graph& /*g*/)
+void FF7::FF7SimpleCodeGenerator::generate(InstVec& insts, const Graph& g)
 {
     // TODO: yes, this is a big monolithic whatever. it's also WIP and i will be breaking it into digestable chunks when it's ready :D
 
-    auto instruction = insts.begin();
-    
-    std::vector<std::pair<Function&, InstVec>> functionsWithBodies;
+    _g = &g;
+    mScriptInsts = &insts;
+    FunctionBodies functionsWithBodies;
     for (auto function = _engine->_functions.begin(); function != _engine->_functions.end(); ++function)
     {
-        InstVec body;
-        for (size_t i = 0; i < function->second.mNumInstructions; ++i, ++instruction)
+        const auto first = insts.begin() + function->second.mFirstInstruction;
+        InstVec body(first, first + function->second.mNumInstructions);
+        functionsWithBodies.push_back(std::pair<Function&, InstVec> { function->second, body });
+    }
+
+    if (mPool && mPool->NumWorkers() > 0)
+    {
+        generateEntitiesInParallel(functionsWithBodies);
+    }
+    else
+    {
+        generateFunctions(functionsWithBodies.begin(), functionsWithBodies.end());
+    }
+
+    for (auto i = mLines.begin(); i != mLines.end(); ++i)
+    {
+        if (i->_unindentBefore)
         {
-            body.push_back(*instruction);
+            assert(_indentLevel > 0);
+            _indentLevel--;
+        }
+        _output << indentString(i->_line) << std::endl;
+        if (i->_indentAfter)
+        {
+            _indentLevel++;
         }
-        functionsWithBodies.push_back(std::pair<Function&, InstVec> { function->second, body });
     }
+}
 
-    for (auto function = functionsWithBodies.begin(); function != functionsWithBodies.end(); ++function)
+void FF7::FF7SimpleCodeGenerator::generateFunctions(FunctionBodies::iterator first, FunctionBodies::iterator last)
+{
+    for (auto function = first; function != last; ++function)
     {
-        onBeforeStartFunction(function->first);
-        auto signature = constructFuncSignature(function->first);
-        addOutputLine(signature, false, true);
-        onStartFunction(function->first);
-        
-        std::unordered_map<uint32, InstVec> labels;
-        for (auto instruction = function->second.begin(); instruction != function->second.end(); ++instruction)
+        generateFunction(function->first, function->second);
+    }
+}
+
+void FF7::FF7SimpleCodeGenerator::generateFunction(Function& func, const InstVec& body)
+{
+    if (mCacheLookup)
+    {
+        auto hit = mCacheLookup->mHits.find(&func);
+        if (hit != std::end(mCacheLookup->mHits))
         {
-            if ((*instruction)->isCondJump() || (*instruction)->isUncondJump())
+            for (const auto& line : hit->second->lines)
             {
-                auto targetAddr = (*instruction)->getDestAddress();
-                auto label = labels.find(targetAddr);
-                if (label == labels.end())
-                {
-                    labels.insert({ targetAddr, InstVec() });
-                }
-                labels[targetAddr].push_back(*instruction);
+                addOutputLine(line.text, line.unindentBefore, line.indentAfter);
+            }
+            for (const auto& sp : hit->second->spawnPoints)
+            {
+                mFormatter.AddSpawnPoint(sp.targetMapId, sp.entity, sp.funcName, sp.address, sp.x, sp.y, sp.triangleId, sp.angle);
             }
+            return;
         }
+    }
+
+    // Only keep the spawn points of this function, not ones replayed from the cache before it
+    mRecorder.TakeSpawnPoints();
+    const size_t firstLine = mLines.size();
+    onBeforeStartFunction(func);
+    auto signature = constructFuncSignature(func);
+    addOutputLine(signature, false, true);
+    onStartFunction(func);
+
+    if (!generateStructuredBody(func))
+    {
+        generateGotoBody(func, body);
+    }
+
+    onEndFunction(func);
+
+    if (mCacheLookup)
+    {
+        cacheFunction(func, firstLine);
+    }
+}
+
+bool FF7::FF7SimpleCodeGenerator::generateStructuredBody(Function& func)
+{
+    if (!_g || num_vertices(*_g) == 0)
+    {
+        return false;
+    }
 
-        for (auto instruction = function->second.begin(); instruction != function->second.end(); ++instruction)
+    // createGroups never merges a group across a function start, so the function's groups are the ones
+    // from its entry point up to its last instruction
+    std::vector<Group*> groups;
+    for (Group* group = get(boost::vertex_name, *_g, func._v).get(); group && (*group->_start)->_address <= func.mEndAddr; group = group->_next)
+    {
+        // Unreachable groups aren't generated at all, and a do-while condition that doesn't end in a
+        // conditional jump is an infinite loop from postCFG, which repeat ... until can't express
+        if (group->_stackLevel < 0 || group->_type == kContinueGroupType ||
+            (group->_type == kDoWhileCondGroupType && !(*group->_end)->isCondJump()))
         {
-            auto label = labels.find((*instruction)->_address);
-            if (label != labels.end())
-            {
-                bool needLabel = false, needNewline = false;
-                for (auto origin = label->second.begin(); origin != label->second.end(); ++origin)
-                {
-                    if ((*origin)->isCondJump())
-                    {
-                        addOutputLine("end", true, false);
-                        needNewline = true;
-                    }
-                    else
-                    {
-                        needLabel = true;
-                    }
-                }
+            return false;
+        }
+        groups.push_back(group);
+    }
 
-                if (needNewline)
-                {
-                    addOutputLine("");
-                }
-                
-                if (needLabel)
-                {
-                    addOutputLine((boost::format("::label_0x%1$X::") % label->first).str());
-                }
+    // Spawn points of an attempt that is thrown away mustn't reach the formatter, the goto body adds them again
+    mRecorder.Hold();
+    mInGroups = true;
+    mNeedsGoto = false;
+    bool failed = false;
+    try
+    {
+        processFunction(func, *mScriptInsts);
+    }
+    catch (const InternalDecompilerError&)
+    {
+        failed = true;
+    }
+    mInGroups = false;
+
+    // Every block must be closed within the function
+    int depth = 0;
+    for (Group* group : groups)
+    {
+        for (const CodeLine& line : group->_code)
+        {
+            if (line._unindentBefore && --depth < 0)
+            {
+                failed = true;
+            }
+            if (line._indentAfter)
+            {
+                depth++;
             }
+        }
+    }
+    failed |= mNeedsGoto || depth != 0;
+
+    mRecorder.Release(!failed);
+    for (Group* group : groups)
+    {
+        if (!failed)
+        {
+            mLines.insert(mLines.end(), group->_code.begin(), group->_code.end());
+        }
+        group->_code.clear();
+    }
+    return !failed;
+}
+
+void FF7::FF7SimpleCodeGenerator::generateGotoBody(Function& func, const InstVec& body)
+{
+    for (auto instruction = body.begin(); instruction != body.end(); ++instruction)
+    {
+        // The disassembler marked which jumps of the function land here: each conditional one
+        // closes its if, and any unconditional one needs a label
+        const Instruction& inst = **instruction;
+        for (uint16 i = 0; i < inst.mCondJumpsIn; i++)
+        {
+            addOutputLine("end", true, false);
+        }
+        if (inst.mCondJumpsIn > 0)
+        {
+            addOutputLine("");
+        }
+        if (inst.mLabelRequired)
+        {
+            addOutputLine((boost::format("::label_0x%1$X::") % inst._address).str());
+        }
 
-            ValueStack stack;
-            (*instruction)->processInst(function->first, stack, _engine, this);
+        ValueStack stack;
+        (*instruction)->processInst(func, stack, _engine, this);
+
+        if ((*instruction)->isCondJump())
+        {
+            addOutputLine((boost::format("if (%s) then") % stack.pop()->getString()).str(), false, true);
 
-            if ((*instruction)->isCondJump())
+            // If there are no more instructions then ensure end is outputted
+            if (instruction + 1 == std::end(body))
             {
-                addOutputLine((boost::format("if (%s) then") % stack.pop()->getString()).str(), false, true);
+                addOutputLine("end", true, false);
+            }
+        }
+        else if ((*instruction)->isUncondJump())
+        {
+            addOutputLine((boost::format("goto label_0x%1$X") % (*instruction)->getDestAddress()).str());
+        }
+        // else, was already output'd
+    }
+}
 
-                // If there are no more instructions then ensure end is outputted
-                if (instruction + 1 == std::end(function->second))
+void FF7::FF7SimpleCodeGenerator::processCondJumpInst(const InstPtr)
+{
+    // Field conditional jumps leave the condition for not jumping on the stack, rather than the
+    // condition for jumping that CodeGenerator expects
+    ValuePtr condition = _stack.pop();
+    switch (mCurGroup->_type)
+    {
+    case kIfCondGroupType:
+    {
+        // An if that is the whole of an else is written as elseif, closed by the end of the else
+        bool elseIf = false;
+        if (mCurGroup->_startElse && mCurGroup->_code.size() == 1)
+        {
+            OutEdgeRange oer = out_edges(_curVertex, *_g);
+            for (OutEdgeIterator oe = oer.first; oe != oer.second; ++oe)
+            {
+                Group* oGr = get(boost::vertex_name, *_g, target(*oe, *_g))->_prev;
+                if (std::find(oGr->_endElse.begin(), oGr->_endElse.end(), mCurGroup.get()) != oGr->_endElse.end())
                 {
-                    addOutputLine("end", true, false);
+                    elseIf = true;
                 }
             }
-            else if ((*instruction)->isUncondJump())
-            {
-                addOutputLine((boost::format("goto label_0x%1$X") % (*instruction)->getDestAddress()).str());
-            }
-            // else, was already output'd
         }
+        if (elseIf)
+        {
+            mCurGroup->_code.clear();
+            mCurGroup->_coalescedElse = true;
+            addOutputLine((boost::format("elseif (%s) then") % condition->getString()).str(), true, true);
+        }
+        else
+        {
+            addOutputLine((boost::format("if (%s) then") % condition->getString()).str(), false, true);
+        }
+        break;
+    }
+    case kWhileCondGroupType:
+        // Each field instruction is a statement of its own, so any before the condition in its group
+        // are repeated with it, which a while can't say
+        if (mCurGroup->_start != mCurGroup->_end)
+        {
+            mNeedsGoto = true;
+            break;
+        }
+        addOutputLine((boost::format("while (%s) do") % condition->getString()).str(), false, true);
+        break;
+    case kDoWhileCondGroupType:
+        // Field conditional jumps only go forwards, so there is no condition jumping back to write as
+        // repeat ... until
+    case kNormalGroupType:
+    case kBreakGroupType:
+    case kContinueGroupType:
+        mNeedsGoto = true;
+        break;
+    }
+}
 
-        onEndFunction(function->first);
+void FF7::FF7SimpleCodeGenerator::processGoto(InstVec&, uint32)
+{
+    // The label could be inside a block the goto is outside of, which Lua doesn't allow
+    mNeedsGoto = true;
+}
+
+void FF7::FF7SimpleCodeGenerator::cacheFunction(const Function& func, size_t firstLine)
+{
+    auto cached = std::make_shared<SUDM::FF7::Field::CachedFunction>();
+    cached->lines.reserve(mLines.size() - firstLine);
+    for (size_t i = firstLine; i < mLines.size(); i++)
+    {
+        cached->lines.push_back({ mLines[i]._line, mLines[i]._unindentBefore, mLines[i]._indentAfter });
     }
+    cached->spawnPoints = mRecorder.TakeSpawnPoints();
+    mCacheLookup->mCache->Insert(mCacheLookup->mKeys.at(&func), cached);
+}
 
-    for (auto i = mLines.begin(); i != mLines.end(); ++i)
+void FF7::FF7SimpleCodeGenerator::generateEntitiesInParallel(FunctionBodies& functionsWithBodies)
+{
+    // Each entity is one table in the output that starts with its first function, so split there
+    std::vector<FunctionBodies::iterator> entityStarts;
+    for (auto function = functionsWithBodies.begin(); function != functionsWithBodies.end(); ++function)
     {
-        if (i->_unindentBefore)
+        if (entityStarts.empty() || function->first.mMetaData->IsStart())
         {
-            assert(_indentLevel > 0);
-            _indentLevel--;
+            entityStarts.push_back(function);
         }
-        _output << indentString(i->_line) << std::endl;
-        if (i->_indentAfter)
+    }
+    entityStarts.push_back(functionsWithBodies.end());
+
+    // Entities share the formatter, so keep the promise of one call at a time to it
+    SUDM::SynchronizedScriptFormatter formatter(mFormatter);
+    std::vector<std::unique_ptr<FF7SimpleCodeGenerator>> entityGenerators;
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i + 1 < entityStarts.size(); i++)
+    {
+        entityGenerators.push_back(std::make_unique<FF7SimpleCodeGenerator>(_engine, mInsts, _output, formatter, nullptr, mCacheLookup));
+        FF7SimpleCodeGenerator* generator = entityGenerators.back().get();
+        generator->_g = _g;
+        generator->mScriptInsts = mScriptInsts;
+        const FunctionBodies::iterator first = entityStarts[i];
+        const FunctionBodies::iterator last = entityStarts[i + 1];
+        tasks.push_back([generator, first, last]()
         {
-            _indentLevel++;
-        }
+            generator->generateFunctions(first, last);
+        });
+    }
+    mPool->Run(tasks);
+
+    for (const auto& generator : entityGenerators)
+    {
+        mLines.insert(mLines.end(), std::make_move_iterator(generator->mLines.begin()), std::make_move_iterator(generator->mLines.end()));
     }
 }
 
 void FF7::FF7SimpleCodeGenerator::addOutputLine(std::string s, bool unindentBefore, bool indentAfter)
 {
-    mLines.push_back(CodeLine(s, unindentBefore, indentAfter));
+    if (mInGroups)
+    {
+        mCurGroup->_code.push_back(CodeLine(s, unindentBefore, indentAfter));
+    }
+    else
+    {
+        mLines.push_back(CodeLine(s, unindentBefore, indentAfter));
+    }
 }
 
 float FF7::FF7SimpleCodeGenerator::ScaleFactor() const
@@ -171,7 +376,7 @@ float FF7::FF7SimpleCodeGenerator::ScaleFactor() const
 void FF7::FF7SimpleCodeGenerator::onBeforeStartFunction(const Function& func)
 {
     // Start class
-    FunctionMetaData metaData(func._metadata);
+    const FunctionMetaData& metaData = *func.mMetaData;
     if (metaData.IsStart())
     {
         addOutputLine("EntityContainer[ \"" + metaData.EntityName() + "\" ] = {", false, true);
@@ -191,14 +396,11 @@ void FF7::FF7SimpleCodeGenerator::onBeforeStartFunction(const Function& func)
 void FF7::FF7SimpleCodeGenerator::onStartFunction(const Function& func)
 {
     addOutputLine("--[[");
-    for (const auto& inst : mInsts)
+    for (uint32 i = func.mFirstInstruction; i < func.mFirstInstruction + func.mNumInstructions; ++i)
     {
-        if (inst->_address >= func.mStartAddr && inst->_address <= func.mEndAddr)
-        {
-            std::stringstream output;
-            output << inst;
-            addOutputLine(output.str());
-        }
+        std::stringstream output;
+        output << StackEffect(_engine->_outputStackEffect) << mInsts[i];
+        addOutputLine(output.str());
     }
     addOutputLine("]]\n");
 
@@ -216,7 +418,7 @@ void FF7::FF7SimpleCodeGenerator::onEndFunction(const Function& func)
     addOutputLine("end,", true, false);
 
     // End class
-    FunctionMetaData metaData(func._metadata);
+    const FunctionMetaData& metaData = *func.mMetaData;
     if (metaData.IsEnd())
     {
         addOutputLine("}\n\n\n", true, false);
@@ -230,7 +432,7 @@ void FF7::FF7SimpleCodeGenerator::onEndFunction(const Function& func)
 std::string FF7::FF7SimpleCodeGenerator::constructFuncSignature(const Function &func)
 {
     // Generate name
-    FunctionMetaData metaData(func._metadata);
+    const FunctionMetaData& metaData = *func.mMetaData;
     return mFormatter.FunctionName(metaData.EntityName(), func._name) + " = function( self )";
 }
 
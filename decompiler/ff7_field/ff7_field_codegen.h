@@ -3,10 +3,14 @@
 #include "decompiler_codegen.h"
 #include <boost/algorithm/string.hpp>
 #include <deque>
+#include <map>
+#include <memory>
 #include <unordered_map>
 #include "make_unique.h"
 #include "sudm.h"
 
+class ThreadPool;
+
 namespace FF7
 {
     class FunctionMetaData
@@ -16,9 +20,10 @@ namespace FF7
         // start_end_entityname
         // start_entityname
         // end_entity_name
-        FunctionMetaData(std::string metaData)
+        // The disassembler parses each function's metadata once, in to Function::mMetaData.
+        FunctionMetaData(const Symbol& metaData)
         {
-            Parse(metaData);
+            Parse(metaData.str());
         }
 
         bool IsStart() const
@@ -31,18 +36,18 @@ namespace FF7
             return mEnd;
         }
 
-        std::string EntityName()
+        const std::string& EntityName() const
         {
-            return mEntityName;
+            return mEntityName.str();
         }
 
-        int CharacterId()
+        int CharacterId() const
         {
             return mCharacterId;
         }
 
     private:
-        void Parse(std::string str)
+        void Parse(const std::string& str)
         {
             std::deque<std::string> strs;
             boost::split(strs, str, boost::is_any_of("_"), boost::token_compress_on);
@@ -106,19 +111,20 @@ namespace FF7
 
         void ParseEntity(const std::string& item, std::deque<std::string>& strs)
         {
-            mEntityName = item;
+            std::string entityName = item;
             for (auto& part : strs)
             {
                 if (!part.empty())
                 {
-                    mEntityName += "_" + part;
+                    entityName += "_" + part;
                 }
             }
+            mEntityName = entityName;
         }
 
         bool mEnd = false;
         bool mStart = false;
-        std::string mEntityName;
+        Symbol mEntityName;
         int mCharacterId = -1;
     };
 
@@ -142,15 +148,102 @@ namespace FF7
     };
 
 
+    // What one decompilation found in a SUDM::FF7::Field::FunctionCache. Functions with a hit have no
+    // Instruction objects and are spliced in from the cache, the rest are generated and then cached.
+    struct FunctionCacheLookup
+    {
+        SUDM::FF7::Field::FunctionCache* mCache = nullptr;
+        std::map<const Function*, uint64_t> mKeys;
+        std::map<const Function*, std::shared_ptr<const SUDM::FF7::Field::CachedFunction>> mHits;
+    };
+
+    // Passes calls on to another formatter, keeping the spawn points it is given so they can be cached
+    class SpawnPointRecorder : public SUDM::IScriptFormatter
+    {
+    public:
+        explicit SpawnPointRecorder(SUDM::IScriptFormatter& formatter)
+            : mFormatter(formatter)
+        {
+
+        }
+
+        virtual void AddSpawnPoint(unsigned int targetMapId, const std::string& entity, const std::string& funcName, unsigned int address, int x, int y, int triangleId, int angle) override
+        {
+            mSpawnPoints.push_back({ targetMapId, entity, funcName, address, x, y, triangleId, angle });
+            if (!mHolding)
+            {
+                mFormatter.AddSpawnPoint(targetMapId, entity, funcName, address, x, y, triangleId, angle);
+            }
+        }
+
+        virtual std::string SpawnPointName(unsigned int targetMapId, const std::string& entity, const std::string& funcName, unsigned int address) override
+        {
+            return mFormatter.SpawnPointName(targetMapId, entity, funcName, address);
+        }
+
+        virtual std::string MapName(unsigned int mapId) override { return mFormatter.MapName(mapId); }
+        virtual std::string VarName(unsigned int bank, unsigned int addr) override { return mFormatter.VarName(bank, addr); }
+        virtual std::string EntityName(const std::string& entity) override { return mFormatter.EntityName(entity); }
+        virtual std::string AnimationName(int charId, int id) override { return mFormatter.AnimationName(charId, id); }
+        virtual std::string CharName(int charId) override { return mFormatter.CharName(charId); }
+        virtual std::string FunctionName(const std::string& entity, const std::string& funcName) override { return mFormatter.FunctionName(entity, funcName); }
+        virtual std::string FunctionComment(const std::string& entity, const std::string& funcName) override { return mFormatter.FunctionComment(entity, funcName); }
+        virtual std::string Fingerprint() override { return mFormatter.Fingerprint(); }
+
+        // Returns the spawn points added since the last call
+        std::vector<SUDM::FF7::Field::CachedFunction::SpawnPoint> TakeSpawnPoints()
+        {
+            return std::move(mSpawnPoints);
+        }
+
+        // Until Release, spawn points are kept but not passed on
+        void Hold()
+        {
+            mHeldFrom = mSpawnPoints.size();
+            mHolding = true;
+        }
+
+        // Passes on the spawn points added since Hold, or forgets them
+        void Release(bool passOn)
+        {
+            mHolding = false;
+            if (!passOn)
+            {
+                mSpawnPoints.resize(mHeldFrom);
+                return;
+            }
+            for (size_t i = mHeldFrom; i < mSpawnPoints.size(); i++)
+            {
+                const auto& sp = mSpawnPoints[i];
+                mFormatter.AddSpawnPoint(sp.targetMapId, sp.entity, sp.funcName, sp.address, sp.x, sp.y, sp.triangleId, sp.angle);
+            }
+        }
+
+    private:
+        SUDM::IScriptFormatter& mFormatter;
+        std::vector<SUDM::FF7::Field::CachedFunction::SpawnPoint> mSpawnPoints;
+        bool mHolding = false;
+        size_t mHeldFrom = 0;
+    };
+
     class FF7SimpleCodeGenerator : public CodeGenerator
     {
     public:
-        FF7SimpleCodeGenerator(Engine *engine, const InstVec& insts, std::ostream &output, SUDM::IScriptFormatter& formatter)
+        // With a pool, each entity's functions are generated in to their own lines on the pool and the
+        // results joined in entity order, so the output is the same as generating serially.
+        // With a cache lookup, functions it has a hit for are copied from the cache instead.
+        FF7SimpleCodeGenerator(Engine *engine, const InstVec& insts, std::ostream &output, SUDM::IScriptFormatter& formatter,
+            ThreadPool* pool = nullptr, const FunctionCacheLookup* cacheLookup = nullptr)
             : CodeGenerator(engine, output, kFIFOArgOrder, kLIFOArgOrder),
-            mInsts(insts), mFormatter(formatter)
+            mInsts(insts), mPool(pool), mCacheLookup(cacheLookup), mRecorder(formatter),
+            mFormatter(mRecorder)
         {
             mTargetLang = std::make_unique<LuaTargetLanguage>();
         }
+
+        // Given an analyzed graph, functions are written with the loops and if/else chains it found. A
+        // function is written with gotos instead if any of it is unreachable, it has a construct Lua
+        // lacks, such as continue, or it still needs a goto. Given an empty graph, every function is.
         virtual void generate(InstVec& insts, const Graph &g) override;
         virtual void addOutputLine(std::string s, bool unindentBefore = false, bool indentAfter = false) override;
         float ScaleFactor() const;
@@ -159,10 +252,36 @@ namespace FF7
         virtual void onEndFunction(const Function& func) override;
         virtual void onBeforeStartFunction(const Function& func) override;
         virtual void onStartFunction(const Function& func) override;
-        virtual bool OutputOnlyRequiredLabels() const override { return true; }
+        virtual void processCondJumpInst(const InstPtr inst) override;
+        virtual void processGoto(InstVec& insts, uint32 dstAddr) override;
     private:
+        typedef std::vector<std::pair<Function&, InstVec>> FunctionBodies;
+
+        // Generates the lines for functions [first, last), which are independent of all other functions
+        // as long as they make up whole entities
+        void generateFunctions(FunctionBodies::iterator first, FunctionBodies::iterator last);
+        void generateEntitiesInParallel(FunctionBodies& functionsWithBodies);
+
+        // Generates func in to mLines from scratch, or from the cache if the lookup has it
+        void generateFunction(Function& func, const InstVec& body);
+        void cacheFunction(const Function& func, size_t firstLine);
+
+        // Generates the body of func in to mLines from the analyzed graph, returns false without
+        // generating anything if it can't be written without gotos
+        bool generateStructuredBody(Function& func);
+
+        // Generates the body of func in to mLines with an if for each forward conditional jump and a
+        // goto for everything else
+        void generateGotoBody(Function& func, const InstVec& body);
+
         const InstVec& mInsts;
+        InstVec* mScriptInsts = nullptr; // The instructions given to generate
         std::vector<CodeLine> mLines;
+        ThreadPool* mPool;
+        const FunctionCacheLookup* mCacheLookup;
+        SpawnPointRecorder mRecorder;
+        bool mInGroups = false; // Whether addOutputLine adds to the code of mCurGroup rather than mLines
+        bool mNeedsGoto = false;
     public:
         SUDM::IScriptFormatter& mFormatter;
     };
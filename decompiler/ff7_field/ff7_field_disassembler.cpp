@@ -15,8 +15,8 @@ FF7::FF7Disassembler::FF7Disassembler(SUDM::IScriptFormatter& formatter, FF7Fiel
 {
     mbFromRaw = true;
     kSectionPointersSize = 0; // If loading a raw section then we don't have a "sections header" to skip
-    auto dataCopy = rawScriptData;
-    mStream = std::make_unique<BinaryReader>(std::move(dataCopy));
+    // View the callers buffer rather than copying it, rawScriptData must outlive this disassembler
+    mStream = std::make_unique<BinaryReader>(rawScriptData.data(), rawScriptData.size());
     ReadHeader();
 }
 
@@ -62,8 +62,9 @@ void FF7::FF7Disassembler::ReadHeader()
 
 void FF7::FF7Disassembler::open(const char *filename)
 {
-    // Read all of the file, decompress it, then stuff it into a stream
-    mStream = std::make_unique<BinaryReader>(Lzs::Decompress(BinaryReader::ReadAll(filename)));
+    // Decompress from the mapped file as the reader needs it. Scripts end at mOffsetToStrings of the script
+    // section, so the sections that come after it are never decompressed.
+    mStream = std::make_unique<BinaryReader>(std::make_unique<Lzs::StreamDecompressor>(std::make_unique<MappedFile>(filename)));
     ReadHeader();
 }
 
@@ -115,6 +116,44 @@ struct ScriptInfo
 
 void FF7::FF7Disassembler::doDisassemble() throw(std::exception)
 {
+    DisassembleToStore();
+
+    // Callers of disassemble() want every Instruction, decompiling only creates the ones it needs
+    for (const auto& function : mEngine->_functions)
+    {
+        MaterializeFunction(function.second);
+    }
+}
+
+void FF7::FF7Disassembler::MaterializeFunction(const Function& func)
+{
+    const auto first = _insts.begin() + func.mFirstInstruction;
+    if (func.mNumInstructions == 0 || *first)
+    {
+        return;
+    }
+    for (size_t i = func.mFirstInstruction; i < func.mFirstInstruction + func.mNumInstructions; i++)
+    {
+        _insts[i] = mStore.Materialize(i);
+    }
+    markJumpTargets(first, first + func.mNumInstructions);
+}
+
+void FF7::FF7Disassembler::doDumpDisassembly(std::ostream& output)
+{
+    const bool streamStackEffect = outputStackEffect(output);
+    output << StackEffect(mEngine->_outputStackEffect);
+    SimpleDisassembler::doDumpDisassembly(output);
+    output << StackEffect(streamStackEffect);
+}
+
+void FF7::FF7Disassembler::DisassembleToStore()
+{
+    if (!mStore.Empty())
+    {
+        return;
+    }
+
     // Loop through the scripts for each entity
     for (size_t entityNumber = 0; entityNumber < mHeader.mEntityScripts.size(); entityNumber++)
     {
@@ -158,18 +197,18 @@ void FF7::FF7Disassembler::doDisassemble() throw(std::exception)
             DisassembleIndivdualScript(entityName, entityNumber, it->mIndex, it->mEntryPoint, it->mNextEntryPoint, isStart, isEnd);
         }
     }
+
+    // Null until MaterializeFunction creates them
+    _insts.resize(mStore.Size());
 }
 
-static int FindId(uint32 startAddr, uint32 endAddr, const InstVec& insts)
+static int FindId(const Function& func, const InstructionStore& store)
 {
-    for (const InstPtr& instruction : insts)
+    for (size_t i = func.mFirstInstruction; i < func.mFirstInstruction + func.mNumInstructions; i++)
     {
-        if (instruction->_address >= startAddr && instruction->_address <= endAddr)
+        if (store.Opcode(i) == FF7::eOpcodes::opCodeCHAR)
         {
-            if (instruction->_opcode == FF7::eOpcodes::opCodeCHAR)
-            {
-                return instruction->_params[0]->getSigned();
-            }
+            return store.Param(i, 0).mValue;
         }
     }
     return -1;
@@ -181,7 +220,7 @@ void FF7::FF7Disassembler::AddFunc(std::string entityName, size_t entityIndex, s
     const auto kScriptEntryPoint = mStream->Position();
 
     // Read each block of opcodes up to a return
-    const size_t oldNumInstructions = _insts.size();
+    const size_t oldNumInstructions = mStore.Size();
 
     auto func = StartFunction(scriptIndex);
     if (toReturnOnly)
@@ -221,31 +260,34 @@ void FF7::FF7Disassembler::AddFunc(std::string entityName, size_t entityIndex, s
     }
 
 
-    const size_t newNumInstructions = _insts.size();
+    const size_t newNumInstructions = mStore.Size();
+    func->mFirstInstruction = oldNumInstructions;
     func->mNumInstructions = newNumInstructions - oldNumInstructions;
-    func->mEndAddr = _insts.back()->_address;
+    // A function with no instructions ends where it starts
+    func->mEndAddr = func->mNumInstructions > 0 ? mStore.Address(newNumInstructions - 1) : func->mStartAddr;
     if (!funcName.empty())
     {
         func->_name = funcName;
     }
 
-    int id = FindId(func->mStartAddr, func->mEndAddr, _insts);
+    int id = FindId(*func, mStore);
     // If there is no ID check if there was an ID for this entity in any of its other functions and use that instead
+    auto entityId = mEntityCharacterIds.find(entityName);
     if (id == -1)
     {
-        for (auto& func : mEngine->_functions)
+        if (entityId != std::end(mEntityCharacterIds))
         {
-            FunctionMetaData metaData(func.second._metadata);
-            if (metaData.EntityName() == entityName && metaData.CharacterId() != -1)
-            {
-                id = metaData.CharacterId();
-                break;
-            }
+            id = entityId->second.second;
         }
     }
+    else if (entityId == std::end(mEntityCharacterIds) || static_cast<uint32>(kScriptEntryPoint) < entityId->second.first)
+    {
+        mEntityCharacterIds[entityName] = std::make_pair(static_cast<uint32>(kScriptEntryPoint), id);
+    }
 
     metaData += std::to_string(id) + "_" + entityName;
     func->_metadata = metaData;
+    func->mMetaData = std::make_shared<const FunctionMetaData>(func->_metadata);
 
     mEngine->_functions[kScriptEntryPoint] = *func;
     mEngine->AddEntityFunction(entityName, entityIndex, func->_name, scriptIndex);
@@ -306,411 +348,443 @@ void FF7::FF7Disassembler::DisassembleIndivdualScript(std::string entityName,
 }
 
 
-const FF7::TInstructRecord kOpcodes[] =
+namespace
 {
-    // Flow
-    { 1, FF7::eOpcodes::RET, "RET", "", FF7::FF7ControlFlowInstruction::Create },
-    { 1, FF7::eOpcodes::REQ, "REQ", "BU", FF7::FF7ControlFlowInstruction::Create },
-    { 1, FF7::eOpcodes::REQSW, "REQSW", "BU", FF7::FF7ControlFlowInstruction::Create },
-    { 1, FF7::eOpcodes::REQEW, "REQEW", "BU", FF7::FF7ControlFlowInstruction::Create },
-    { 1, FF7::eOpcodes::NOP, "NOP", "", FF7::FF7NoOperationInstruction::Create },
-    { 1, FF7::eOpcodes::IFUB, "IFUB", "NNBBBL", FF7::FF7NoOperationInstruction::Create }
-};
+    using namespace FF7;
 
-std::map<std::string, const FF7::TInstructRecord*> FF7::FieldInstructions()
-{
-    // Convert the array to a map that we can query on by mnemonic
-    std::map<std::string, const TInstructRecord*> mnemonicToInstructionRecords;
-    for (size_t i = 0; i < boost::size(kOpcodes); i++)
+    template<class T>
+    InstPtr Create()
     {
-        mnemonicToInstructionRecords[kOpcodes[i].mMnemonic] = &kOpcodes[i];
+        return new T();
     }
-    return mnemonicToInstructionRecords;
-}
 
-void FF7::FF7Disassembler::ReadOpCodesToPositionOrReturn(size_t endPos)
-{
-    /* Need all opcodes in the array before this will work
-    // Convert the array to a map that we can query on by opcode
-    std::map<unsigned int, const TInstructRecord*> opcodeToInstructionRecords;
-    for (size_t i = 0; i < boost::size(kOpcodes); i++)
+    // Indexed by the first byte of the opcode. The gaps are either unused or are
+    // SPECIAL and KAWAI, which are decoded through their own sub opcode tables.
+    constexpr TInstructRecord kOpcodes[] =
     {
-        opcodeToInstructionRecords[kOpcodes[i].mOpCode] = &kOpcodes[i];
+        { 1, eOpcodes::RET, "RET", "", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::REQ, "REQ", "BU", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::REQSW, "REQSW", "BU", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::REQEW, "REQEW", "BU", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::PREQ, "PREQ", "BU", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::PRQSW, "PRQSW", "BU", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::PRQEW, "PRQEW", "BU", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::RETTO, "RETTO", "U", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::JOIN, "JOIN", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::SPLIT, "SPLIT", "NNNssBssBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::SPTYE, "SPTYE", "NNBBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::GTPYE, "GTPYE", "NNBBB", &Create<FF7PartyInstruction> },
+        { 1, 0x0C, nullptr, nullptr, nullptr },
+        { 1, 0x0D, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::DSKCG, "DSKCG", "B", &Create<FF7ModuleInstruction> },
+        { 1, 0x0F, nullptr, nullptr, nullptr }, // SPECIAL, decoded through its sub opcode table
+        { 1, eOpcodes::JMPF, "JMPF", "B", &Create<FF7UncondJumpInstruction> },
+        { 1, eOpcodes::JMPFL, "JMPFL", "w", &Create<FF7UncondJumpInstruction> },
+        { 1, eOpcodes::JMPB, "JMPB", "B", &Create<FF7UncondJumpInstruction> },
+        { 1, eOpcodes::JMPBL, "JMPBL", "w", &Create<FF7UncondJumpInstruction> },
+        { 1, eOpcodes::IFUB, "IFUB", "NBBBB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFUBL, "IFUBL", "NBBBw", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFSW, "IFSW", "NwwBB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFSWL, "IFSWL", "NwwBw", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFUW, "IFUW", "NwwBB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFUWL, "IFUWL", "NwwBw", &Create<FF7CondJumpInstruction> },
+        { 1, 0x1A, nullptr, nullptr, nullptr },
+        { 1, 0x1B, nullptr, nullptr, nullptr },
+        { 1, 0x1C, nullptr, nullptr, nullptr },
+        { 1, 0x1D, nullptr, nullptr, nullptr },
+        { 1, 0x1E, nullptr, nullptr, nullptr },
+        { 1, 0x1F, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::MINIGAME, "MINIGAME", "wsswBB", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::TUTOR, "TUTOR", "B", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::BTMD2, "BTMD2", "d", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::BTRLD, "BTRLD", "NB", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::WAIT, "WAIT", "w", &Create<FF7ControlFlowInstruction> },
+        { 1, eOpcodes::NFADE, "NFADE", "NNBBBBBB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::BLINK, "BLINK", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::BGMOVIE, "BGMOVIE", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, 0x28, nullptr, nullptr, nullptr }, // KAWAI, decoded through its sub opcode table
+        { 1, eOpcodes::KAWIW, "KAWIW", "", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::PMOVA, "PMOVA", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::SLIP, "SLIP", "B", &Create<FF7WalkmeshInstruction> },
+        { 1, eOpcodes::BGPDH, "BGPDH", "NBs", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::BGSCR, "BGSCR", "NBss", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::WCLS, "WCLS", "B", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WSIZW, "WSIZW", "Bwwww", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::IFKEY, "IFKEY", "wB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFKEYON, "IFKEYON", "wB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFKEYOFF, "IFKEYOFF", "wB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::UC, "UC", "B", &Create<FF7WalkmeshInstruction> },
+        { 1, eOpcodes::PDIRA, "PDIRA", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::PTURA, "PTURA", "BBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::WSPCL, "WSPCL", "BBBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WNUMB, "WNUMB", "NBwwB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::STTIM, "STTIM", "NNBBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::GOLDU, "GOLDU", "Nww", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::GOLDD, "GOLDD", "Nww", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::CHGLD, "CHGLD", "NBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::HMPMAX1, "HMPMAX1", "", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::HMPMAX2, "HMPMAX2", "", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::MHMMX, "MHMMX", "", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::HMPMAX3, "HMPMAX3", "", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::MESSAGE, "MESSAGE", "BB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::MPARA, "MPARA", "NBBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::MPRA2, "MPRA2", "NBBw", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::MPNAM, "MPNAM", "B", &Create<FF7WindowInstruction> },
+        { 1, 0x44, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::MPU, "MPU", "NBw", &Create<FF7PartyInstruction> },
+        { 1, 0x46, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::MPD, "MPD", "NBw", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::ASK, "ASK", "NBBBBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::MENU, "MENU", "NBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::MENU2, "MENU2", "B", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::BTLTB, "BTLTB", "B", &Create<FF7ModuleInstruction> },
+        { 1, 0x4C, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::HPU, "HPU", "NBw", &Create<FF7PartyInstruction> },
+        { 1, 0x4E, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::HPD, "HPD", "NBw", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::WINDOW, "WINDOW", "Bwwww", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WMOVE, "WMOVE", "Bss", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WMODE, "WMODE", "BBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WREST, "WREST", "B", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WCLSE, "WCLSE", "B", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::WROW, "WROW", "BB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::GWCOL, "GWCOL", "NNBBBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::SWCOL, "SWCOL", "NNBBBB", &Create<FF7WindowInstruction> },
+        { 1, eOpcodes::STITM, "STITM", "NwB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::DLITM, "DLITM", "NwB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::CKITM, "CKITM", "NwB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::SMTRA, "SMTRA", "NNBBBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::DMTRA, "DMTRA", "NNBBBBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::CMTRA, "CMTRA", "NNNBBBBBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::SHAKE, "SHAKE", "BBBBBBB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::NOP, "NOP", "", &Create<FF7NoOperationInstruction> },
+        { 1, eOpcodes::MAPJUMP, "MAPJUMP", "wsswB", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::SCRLO, "SCRLO", "B", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCRLC, "SCRLC", "BBBB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCRLA, "SCRLA", "NwBB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCR2D, "SCR2D", "Nss", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCRCC, "SCRCC", "", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCR2DC, "SCR2DC", "NNssw", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCRLW, "SCRLW", "", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::SCR2DL, "SCR2DL", "NNssw", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::MPDSP, "MPDSP", "B", &Create<FF7UncategorizedInstruction> },
+        { 1, eOpcodes::VWOFT, "VWOFT", "NssB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::FADE, "FADE", "NNBBBBBB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::FADEW, "FADEW", "", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::IDLCK, "IDLCK", "wB", &Create<FF7WalkmeshInstruction> },
+        { 1, eOpcodes::LSTMP, "LSTMP", "NB", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::SCRLP, "SCRLP", "NwBB", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::BATTLE, "BATTLE", "Nw", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::BTLON, "BTLON", "B", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::BTLMD, "BTLMD", "w", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::PGTDR, "PGTDR", "NBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::GETPC, "GETPC", "NBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::PXYZI, "PXYZI", "NNBBBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::PLUS_, "PLUS!", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::PLUS2_, "PLUS2!", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MINUS_, "MINUS!", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MINUS2_, "MINUS2!", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::INC_, "INC!", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::INC2_, "INC2!", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::DEC_, "DEC!", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::DEC2_, "DEC2!", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::TLKON, "TLKON", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::RDMSD, "RDMSD", "NB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::SETBYTE, "SETBYTE", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::SETWORD, "SETWORD", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::BITON, "BITON", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::BITOFF, "BITOFF", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::BITXOR, "BITXOR", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::PLUS, "PLUS", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::PLUS2, "PLUS2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MINUS, "MINUS", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MINUS2, "MINUS2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MUL, "MUL", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MUL2, "MUL2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::DIV, "DIV", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::DIV2, "DIV2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MOD, "MOD", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::MOD2, "MOD2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::AND, "AND", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::AND2, "AND2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::OR, "OR", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::OR2, "OR2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::XOR, "XOR", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::XOR2, "XOR2", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::INC, "INC", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::INC2, "INC2", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::DEC, "DEC", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::DEC2, "DEC2", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::RANDOM, "RANDOM", "BB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::LBYTE, "LBYTE", "NBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::HBYTE, "HBYTE", "NBw", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::TWOBYTE, "2BYTE", "NNBBB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::SETX, "SETX", "BBBBBB", &Create<FF7UncategorizedInstruction> },
+        { 1, eOpcodes::GETX, "GETX", "BBBBBB", &Create<FF7UncategorizedInstruction> },
+        { 1, eOpcodes::SEARCHX, "SEARCHX", "BBBBBBBBBB", &Create<FF7UncategorizedInstruction> },
+        { 1, eOpcodes::PC, "PC", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::opCodeCHAR, "CHAR", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::DFANM, "DFANM", "BB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ANIME1, "ANIME1", "BB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::VISI, "VISI", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::XYZI, "XYZI", "NNsssw", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::XYI, "XYI", "NNssw", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::XYZ, "XYZ", "NNsss", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::MOVE, "MOVE", "Nss", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::CMOVE, "CMOVE", "Nss", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::MOVA, "MOVA", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::TURA, "TURA", "BBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ANIMW, "ANIMW", "", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::FMOVE, "FMOVE", "Nss", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ANIME2, "ANIME2", "BB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ANIM_1, "ANIM!1", "BB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::CANIM1, "CANIM1", "BBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::CANM_1, "CANM!1", "BBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::MSPED, "MSPED", "Nw", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::DIR, "DIR", "BB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::TURNGEN, "TURNGEN", "NBBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::TURN, "TURN", "NBBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::DIRA, "DIRA", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::GETDIR, "GETDIR", "NBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::GETAXY, "GETAXY", "NBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::GETAI, "GETAI", "NBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ANIM_2, "ANIM!2", "BB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::CANIM2, "CANIM2", "BBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::CANM_2, "CANM!2", "BBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ASPED, "ASPED", "Nw", &Create<FF7ModelInstruction> },
+        { 1, 0xBE, nullptr, nullptr, nullptr },
+        { 1, eOpcodes::CC, "CC", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::JUMP, "JUMP", "NNssww", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::AXYZI, "AXYZI", "NNBBBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::LADER, "LADER", "NNssswBBBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::OFST, "OFST", "NNBsssw", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::OFSTW, "OFSTW", "", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::TALKR, "TALKR", "NB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::SLIDR, "SLIDR", "NB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::SOLID, "SOLID", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::PRTYP, "PRTYP", "B", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::PRTYM, "PRTYM", "B", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::PRTYE, "PRTYE", "BBB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::IFPRTYQ, "IFPRTYQ", "BB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::IFMEMBQ, "IFMEMBQ", "BB", &Create<FF7CondJumpInstruction> },
+        { 1, eOpcodes::MMBUD, "MMBUD", "BB", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::MMBLK, "MMBLK", "B", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::MMBUK, "MMBUK", "B", &Create<FF7PartyInstruction> },
+        { 1, eOpcodes::LINE, "LINE", "ssssss", &Create<FF7WalkmeshInstruction> },
+        { 1, eOpcodes::LINON, "LINON", "B", &Create<FF7WalkmeshInstruction> },
+        { 1, eOpcodes::MPJPO, "MPJPO", "B", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::SLINE, "SLINE", "NNNssssss", &Create<FF7WalkmeshInstruction> },
+        { 1, eOpcodes::SIN, "SIN", "NNwwwB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::COS, "COS", "NNwwwB", &Create<FF7MathInstruction> },
+        { 1, eOpcodes::TLKR2, "TLKR2", "Nw", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::SLDR2, "SLDR2", "Nw", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::PMJMP, "PMJMP", "w", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::PMJMP2, "PMJMP2", "", &Create<FF7ModuleInstruction> },
+        { 1, eOpcodes::AKAO2, "AKAO2", "NNNBwwwww", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::FCFIX, "FCFIX", "B", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::CCANM, "CCANM", "BBB", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::ANIMB, "ANIMB", "", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::TURNW, "TURNW", "", &Create<FF7ModelInstruction> },
+        { 1, eOpcodes::MPPAL, "MPPAL", "NNNBBBBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::BGON, "BGON", "NBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::BGOFF, "BGOFF", "NBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::BGROL, "BGROL", "NB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::BGROL2, "BGROL2", "NB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::BGCLR, "BGCLR", "NB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::STPAL, "STPAL", "NBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::LDPAL, "LDPAL", "NBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::CPPAL, "CPPAL", "NBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::RTPAL, "RTPAL", "NNBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::ADPAL, "ADPAL", "NNNBBBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::MPPAL2, "MPPAL2", "NNNBBBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::STPLS, "STPLS", "BBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::LDPLS, "LDPLS", "BBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::CPPAL2, "CPPAL2", "BBBBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::RTPAL2, "RTPAL2", "BBBBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::ADPAL2, "ADPAL2", "BBBBBBBBBB", &Create<FF7BackgroundInstruction> },
+        { 1, eOpcodes::MUSIC, "MUSIC", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::SOUND, "SOUND", "NwB", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::AKAO, "AKAO", "NNNBBwwww", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::MUSVT, "MUSVT", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::MUSVM, "MUSVM", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::MULCK, "MULCK", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::BMUSC, "BMUSC", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::CHMPH, "CHMPH", "BBB", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::PMVIE, "PMVIE", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::MOVIE, "MOVIE", "", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::MVIEF, "MVIEF", "NB", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::MVCAM, "MVCAM", "B", &Create<FF7CameraInstruction> },
+        { 1, eOpcodes::FMUSC, "FMUSC", "B", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::CMUSC, "CMUSC", "BBBBBBB", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::CHMST, "CHMST", "NB", &Create<FF7AudioVideoInstruction> },
+        { 1, eOpcodes::GAMEOVER, "GAMEOVER", "", &Create<FF7ModuleInstruction> },
+    };
+
+    constexpr TInstructRecord kSpecialOpcodes[] =
+    {
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::ARROW, "ARROW", "B", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::PNAME, "PNAME", "B", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::GMSPD, "GMSPD", "B", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::SMSPD, "SMSPD", "BB", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::FLMAT, "FLMAT", "", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::FLITM, "FLITM", "", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::BTLCK, "BTLCK", "B", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::MVLCK, "MVLCK", "B", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::SPCNM, "SPCNM", "BB", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::RSGLB, "RSGLB", "", &Create<FF7ModuleInstruction> },
+        { 2, (eOpcodes::SPECIAL << 8) | eSpecialOpcodes::CLITM, "CLITM", "", &Create<FF7ModuleInstruction> },
+    };
+
+    constexpr TInstructRecord kKawaiOpcodes[] =
+    {
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::EYETX, "EYETX", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::TRNSP, "TRNSP", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::AMBNT, "AMBNT", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown03, "Unknown03", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown04, "Unknown04", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown05, "Unknown05", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::LIGHT, "LIGHT", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown07, "Unknown07", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown08, "Unknown08", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown09, "Unknown09", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::SBOBJ, "SBOBJ", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown0B, "Unknown0B", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::Unknown0C, "Unknown0C", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::SHINE, "SHINE", "", &Create<FF7ModelInstruction> },
+        { 2, (eOpcodes::KAWAI << 8) | eKawaiOpcodes::RESET, "RESET", "", &Create<FF7ModelInstruction> },
+    };
+
+    const unsigned int kNumOpcodes = 256;
+    static_assert(sizeof(kOpcodes) / sizeof(kOpcodes[0]) == kNumOpcodes, "kOpcodes must have an entry for every opcode");
+
+    constexpr bool IsIndexedByOpcode(unsigned int opcode)
+    {
+        return opcode == kNumOpcodes || (kOpcodes[opcode].mOpCode == opcode && IsIndexedByOpcode(opcode + 1));
     }
+    static_assert(IsIndexedByOpcode(0), "kOpcodes must be in opcode order");
 
-    while (mStream->Position() < endPos)
+    // Sub opcode tables are dense from their first entry, so this is normally a direct index. The
+    // scan only picks up stragglers such as KAWAI RESET that sit after a gap.
+    template<size_t N>
+    const TInstructRecord* FindSubOpcode(const TInstructRecord(&records)[N], unsigned int fullOpcode)
     {
-        // See if the next data is a 1 byte opcode
-        uint16 opcode = mStream->ReadU8();
-        auto it = opcodeToInstructionRecords.find(opcode);
-        _address++;
-        if (it == std::end(opcodeToInstructionRecords))
+        const unsigned int index = fullOpcode - records[0].mOpCode;
+        if (index < N && records[index].mOpCode == fullOpcode)
         {
-            // No, is it a 2 byte opcode?
-            opcode = (mStream->ReadU8() << 8) + opcode;
-            _address++;
-            it = opcodeToInstructionRecords.find(opcode);
-            if (it == std::end(opcodeToInstructionRecords))
+            return &records[index];
+        }
+        for (const TInstructRecord& record : records)
+        {
+            if (record.mOpCode == fullOpcode)
             {
-                // There are no instructions bigger than 2 bytes, so fail
-                throw UnknownSubOpcodeException(_address, opcode);
+                return &record;
             }
         }
+        return nullptr;
+    }
+
+}
+
+void FF7::FF7Disassembler::AddInstruction(const TInstructRecord& record, uint32 address)
+{
+    mStore.Add(record.mFactoryFunc, record.mOpCode, address, 0, record.mMnemonic);
+}
 
-        InstPtr inst = it->second->mFactoryFunc();
-        inst->_opcode = opcode;
-        inst->_address = _address;
-        inst->_stackChange = 0;
-        inst->_name = it->second->mMnemonic;
-        readParams(inst, it->second->mArgumentFormat);
-        _insts.push_back(inst);
+std::map<std::string, const FF7::TInstructRecord*> FF7::FieldInstructions()
+{
+    // Convert the tables to a map that we can query on by mnemonic
+    std::map<std::string, const TInstructRecord*> mnemonicToInstructionRecords;
+    for (const TInstructRecord& record : kOpcodes)
+    {
+        if (record.mMnemonic)
+        {
+            mnemonicToInstructionRecords[record.mMnemonic] = &record;
+        }
+    }
+    for (const TInstructRecord& record : kSpecialOpcodes)
+    {
+        mnemonicToInstructionRecords[record.mMnemonic] = &record;
+    }
+    for (const TInstructRecord& record : kKawaiOpcodes)
+    {
+        mnemonicToInstructionRecords[record.mMnemonic] = &record;
     }
-    */
+    return mnemonicToInstructionRecords;
+}
 
+void FF7::FF7Disassembler::ReadOpCodesToPositionOrReturn(size_t endPos)
+{
     std::vector<unsigned int> exitAddrs;
 
     while (mStream->Position() < endPos)
     {
-        uint8 opcode = mStream->ReadU8();
-        uint32 full_opcode = 0;
-        std::string opcodePrefix;
-        switch (opcode)
+        const uint32 instAddress = _address;
+        const uint8 opcode = mStream->ReadU8();
+        const TInstructRecord* record = &kOpcodes[opcode];
+        if (opcode == eOpcodes::SPECIAL)
         {
-            // Flow
-            OPCODE(eOpcodes::IFUB, "IFUB", FF7CondJumpInstruction, 0, "NBBBB");
-            OPCODE(eOpcodes::RET, "RET", FF7ControlFlowInstruction, 0, "");
-            OPCODE(eOpcodes::REQ, "REQ", FF7ControlFlowInstruction, 0, "BU");
-            OPCODE(eOpcodes::REQSW, "REQSW", FF7ControlFlowInstruction, 0, "BU");
-            OPCODE(eOpcodes::REQEW, "REQEW", FF7ControlFlowInstruction, 0, "BU");
-            OPCODE(eOpcodes::PREQ, "PREQ", FF7ControlFlowInstruction, 0, "BU");
-            OPCODE(eOpcodes::PRQSW, "PRQSW", FF7ControlFlowInstruction, 0, "BU");
-            OPCODE(eOpcodes::PRQEW, "PRQEW", FF7ControlFlowInstruction, 0, "BU");
-            OPCODE(eOpcodes::RETTO, "RETTO", FF7ControlFlowInstruction, 0, "U");
-            OPCODE(eOpcodes::JMPF, "JMPF", FF7UncondJumpInstruction, 0, "B");
-            OPCODE(eOpcodes::JMPFL, "JMPFL", FF7UncondJumpInstruction, 0, "w");
-            OPCODE(eOpcodes::JMPB, "JMPB", FF7UncondJumpInstruction, 0, "B");
-            OPCODE(eOpcodes::JMPBL, "JMPBL", FF7UncondJumpInstruction, 0, "w");
-            OPCODE(eOpcodes::IFUBL, "IFUBL", FF7CondJumpInstruction, 0, "NBBBw");
-            OPCODE(eOpcodes::IFSW, "IFSW", FF7CondJumpInstruction, 0, "NwwBB");
-            OPCODE(eOpcodes::IFSWL, "IFSWL", FF7CondJumpInstruction, 0, "NwwBw");
-            OPCODE(eOpcodes::IFUW, "IFUW", FF7CondJumpInstruction, 0, "NwwBB");
-            OPCODE(eOpcodes::IFUWL, "IFUWL", FF7CondJumpInstruction, 0, "NwwBw");
-            OPCODE(eOpcodes::WAIT, "WAIT", FF7ControlFlowInstruction, 0, "w");
-            OPCODE(eOpcodes::IFKEY, "IFKEY", FF7CondJumpInstruction, 0, "wB");
-            OPCODE(eOpcodes::IFKEYON, "IFKEYON", FF7CondJumpInstruction, 0, "wB");
-            OPCODE(eOpcodes::IFKEYOFF, "IFKEYOFF", FF7CondJumpInstruction, 0, "wB");
-            OPCODE(eOpcodes::NOP, "NOP", FF7NoOperationInstruction, 0, "");
-            OPCODE(eOpcodes::IFPRTYQ, "IFPRTYQ", FF7CondJumpInstruction, 0, "BB");
-            OPCODE(eOpcodes::IFMEMBQ, "IFMEMBQ", FF7CondJumpInstruction, 0, "BB");
-
-            // Module
-            OPCODE(eOpcodes::DSKCG, "DSKCG", FF7ModuleInstruction, 0, "B");
-            START_SUBOPCODE(eOpcodes::SPECIAL)
-                OPCODE(eSpecialOpcodes::ARROW, "ARROW", FF7ModuleInstruction, 0, "B");
-            OPCODE(eSpecialOpcodes::PNAME, "PNAME", FF7ModuleInstruction, 0, "B");
-            OPCODE(eSpecialOpcodes::GMSPD, "GMSPD", FF7ModuleInstruction, 0, "B");
-            OPCODE(eSpecialOpcodes::SMSPD, "SMSPD", FF7ModuleInstruction, 0, "BB");
-            OPCODE(eSpecialOpcodes::FLMAT, "FLMAT", FF7ModuleInstruction, 0, "");
-            OPCODE(eSpecialOpcodes::FLITM, "FLITM", FF7ModuleInstruction, 0, "");
-            OPCODE(eSpecialOpcodes::BTLCK, "BTLCK", FF7ModuleInstruction, 0, "B");
-            OPCODE(eSpecialOpcodes::MVLCK, "MVLCK", FF7ModuleInstruction, 0, "B");
-            OPCODE(eSpecialOpcodes::SPCNM, "SPCNM", FF7ModuleInstruction, 0, "BB");
-            OPCODE(eSpecialOpcodes::RSGLB, "RSGLB", FF7ModuleInstruction, 0, "");
-            OPCODE(eSpecialOpcodes::CLITM, "CLITM", FF7ModuleInstruction, 0, "");
-            END_SUBOPCODE
-                OPCODE(eOpcodes::MINIGAME, "MINIGAME", FF7ModuleInstruction, 0, "wsswBB");
-            OPCODE(eOpcodes::BTMD2, "BTMD2", FF7ModuleInstruction, 0, "d");
-            OPCODE(eOpcodes::BTRLD, "BTRLD", FF7ModuleInstruction, 0, "NB");
-            OPCODE(eOpcodes::BTLTB, "BTLTB", FF7ModuleInstruction, 0, "B");
-            OPCODE(eOpcodes::MAPJUMP, "MAPJUMP", FF7ModuleInstruction, 0, "wsswB");
-            OPCODE(eOpcodes::LSTMP, "LSTMP", FF7ModuleInstruction, 0, "NB");
-            OPCODE(eOpcodes::BATTLE, "BATTLE", FF7ModuleInstruction, 0, "Nw");
-            OPCODE(eOpcodes::BTLON, "BTLON", FF7ModuleInstruction, 0, "B");
-            OPCODE(eOpcodes::BTLMD, "BTLMD", FF7ModuleInstruction, 0, "w");
-            OPCODE(eOpcodes::MPJPO, "MPJPO", FF7ModuleInstruction, 0, "B");
-            OPCODE(eOpcodes::PMJMP, "PMJMP", FF7ModuleInstruction, 0, "w");
-            OPCODE(eOpcodes::PMJMP2, "PMJMP2", FF7ModuleInstruction, 0, "");
-            OPCODE(eOpcodes::GAMEOVER, "GAMEOVER", FF7ModuleInstruction, 0, "");
-
-            // Math
-            OPCODE(eOpcodes::PLUS_, "PLUS!", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::PLUS2_, "PLUS2!", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::MINUS_, "MINUS!", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::MINUS2_, "MINUS2!", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::INC_, "INC!", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::INC2_, "INC2!", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::DEC_, "DEC!", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::DEC2_, "DEC2!", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::RDMSD, "RDMSD", FF7MathInstruction, 0, "NB");
-            OPCODE(eOpcodes::SETBYTE, "SETBYTE", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::SETWORD, "SETWORD", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::BITON, "BITON", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::BITOFF, "BITOFF", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::BITXOR, "BITXOR", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::PLUS, "PLUS", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::PLUS2, "PLUS2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::MINUS, "MINUS", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::MINUS2, "MINUS2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::MUL, "MUL", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::MUL2, "MUL2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::DIV, "DIV", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::DIV2, "DIV2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::MOD, "MOD", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::MOD2, "MOD2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::AND, "AND", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::AND2, "AND2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::OR, "OR", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::OR2, "OR2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::XOR, "XOR", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::XOR2, "XOR2", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::INC, "INC", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::INC2, "INC2", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::DEC, "DEC", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::DEC2, "DEC2", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::RANDOM, "RANDOM", FF7MathInstruction, 0, "BB");
-            OPCODE(eOpcodes::LBYTE, "LBYTE", FF7MathInstruction, 0, "NBB");
-            OPCODE(eOpcodes::HBYTE, "HBYTE", FF7MathInstruction, 0, "NBw");
-            OPCODE(eOpcodes::TWOBYTE, "2BYTE", FF7MathInstruction, 0, "NNBBB");
-            OPCODE(eOpcodes::SIN, "SIN", FF7MathInstruction, 0, "NNwwwB");
-            OPCODE(eOpcodes::COS, "COS", FF7MathInstruction, 0, "NNwwwB");
-
-            // Window
-            OPCODE(eOpcodes::TUTOR, "TUTOR", FF7WindowInstruction, 0, "B");
-            OPCODE(eOpcodes::WCLS, "WCLS", FF7WindowInstruction, 0, "B");
-            OPCODE(eOpcodes::WSIZW, "WSIZW", FF7WindowInstruction, 0, "Bwwww");
-            OPCODE(eOpcodes::WSPCL, "WSPCL", FF7WindowInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::WNUMB, "WNUMB", FF7WindowInstruction, 0, "NBwwB"); // NBdB when N == 0
-            OPCODE(eOpcodes::STTIM, "STTIM", FF7WindowInstruction, 0, "NNBBB");
-            OPCODE(eOpcodes::MESSAGE, "MESSAGE", FF7WindowInstruction, 0, "BB");
-            OPCODE(eOpcodes::MPARA, "MPARA", FF7WindowInstruction, 0, "NBBB");
-            OPCODE(eOpcodes::MPRA2, "MPRA2", FF7WindowInstruction, 0, "NBBw");
-            OPCODE(eOpcodes::MPNAM, "MPNAM", FF7WindowInstruction, 0, "B");
-            OPCODE(eOpcodes::ASK, "ASK", FF7WindowInstruction, 0, "NBBBBB");
-            OPCODE(eOpcodes::MENU, "MENU", FF7WindowInstruction, 0, "NBB");
-            OPCODE(eOpcodes::MENU2, "MENU2", FF7WindowInstruction, 0, "B");
-            OPCODE(eOpcodes::WINDOW, "WINDOW", FF7WindowInstruction, 0, "Bwwww");
-            OPCODE(eOpcodes::WMOVE, "WMOVE", FF7WindowInstruction, 0, "Bss");
-            OPCODE(eOpcodes::WMODE, "WMODE", FF7WindowInstruction, 0, "BBB");
-            OPCODE(eOpcodes::WREST, "WREST", FF7WindowInstruction, 0, "B");
-            OPCODE(eOpcodes::WCLSE, "WCLSE", FF7WindowInstruction, 0, "B");
-            OPCODE(eOpcodes::WROW, "WROW", FF7WindowInstruction, 0, "BB");
-            OPCODE(eOpcodes::GWCOL, "GWCOL", FF7WindowInstruction, 0, "NNBBBB");
-            OPCODE(eOpcodes::SWCOL, "SWCOL", FF7WindowInstruction, 0, "NNBBBB");
-
-            // Party
-            OPCODE(eOpcodes::SPTYE, "SPTYE", FF7PartyInstruction, 0, "NNBBB");
-            OPCODE(eOpcodes::GTPYE, "GTPYE", FF7PartyInstruction, 0, "NNBBB");
-            OPCODE(eOpcodes::GOLDU, "GOLDU", FF7PartyInstruction, 0, "Nww"); // Nd when N == 0
-            OPCODE(eOpcodes::GOLDD, "GOLDD", FF7PartyInstruction, 0, "Nww"); // Nd when N == 0
-            OPCODE(eOpcodes::CHGLD, "CHGLD", FF7PartyInstruction, 0, "NBB");
-            OPCODE(eOpcodes::HMPMAX1, "HMPMAX1", FF7PartyInstruction, 0, "");
-            OPCODE(eOpcodes::HMPMAX2, "HMPMAX2", FF7PartyInstruction, 0, "");
-            OPCODE(eOpcodes::MHMMX, "MHMMX", FF7PartyInstruction, 0, "");
-            OPCODE(eOpcodes::HMPMAX3, "HMPMAX3", FF7PartyInstruction, 0, "");
-            OPCODE(eOpcodes::MPU, "MPU", FF7PartyInstruction, 0, "NBw");
-            OPCODE(eOpcodes::MPD, "MPD", FF7PartyInstruction, 0, "NBw");
-            OPCODE(eOpcodes::HPU, "HPU", FF7PartyInstruction, 0, "NBw");
-            OPCODE(eOpcodes::HPD, "HPD", FF7PartyInstruction, 0, "NBw");
-            OPCODE(eOpcodes::STITM, "STITM", FF7PartyInstruction, 0, "NwB");
-            OPCODE(eOpcodes::DLITM, "DLITM", FF7PartyInstruction, 0, "NwB");
-            OPCODE(eOpcodes::CKITM, "CKITM", FF7PartyInstruction, 0, "NwB");
-            OPCODE(eOpcodes::SMTRA, "SMTRA", FF7PartyInstruction, 0, "NNBBBB");
-            OPCODE(eOpcodes::DMTRA, "DMTRA", FF7PartyInstruction, 0, "NNBBBBB");
-            OPCODE(eOpcodes::CMTRA, "CMTRA", FF7PartyInstruction, 0, "NNNBBBBBB");
-            OPCODE(eOpcodes::GETPC, "GETPC", FF7PartyInstruction, 0, "NBB");
-            OPCODE(eOpcodes::PRTYP, "PRTYP", FF7PartyInstruction, 0, "B");
-            OPCODE(eOpcodes::PRTYM, "PRTYM", FF7PartyInstruction, 0, "B");
-            OPCODE(eOpcodes::PRTYE, "PRTYE", FF7PartyInstruction, 0, "BBB");
-            OPCODE(eOpcodes::MMBUD, "MMBUD", FF7PartyInstruction, 0, "BB");
-            OPCODE(eOpcodes::MMBLK, "MMBLK", FF7PartyInstruction, 0, "B");
-            OPCODE(eOpcodes::MMBUK, "MMBUK", FF7PartyInstruction, 0, "B");
-
-            // Model
-            OPCODE(eOpcodes::JOIN, "JOIN", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::SPLIT, "SPLIT", FF7ModelInstruction, 0, "NNNssBssBB");
-            OPCODE(eOpcodes::BLINK, "BLINK", FF7ModelInstruction, 0, "B");
-            OPCODE_BASE(eOpcodes::KAWAI)
+            const uint8 subOpcode = mStream->ReadU8();
+            record = FindSubOpcode(kSpecialOpcodes, (opcode << 8) | subOpcode);
+            if (!record)
             {
-                int length = this->mStream->ReadU8();
-                assert(length >= 3);
-                std::ostringstream paramStream;
-                for (int i = 3; i < length; ++i)
-                {
-                    paramStream << "B";
-                }
-                auto parameters = paramStream.str();
-
-                opcode = this->mStream->ReadU8();
-                switch (opcode)
-                {
-                    OPCODE(eKawaiOpcodes::EYETX, "EYETX", FF7ModelInstruction, 0, parameters.c_str()); // was BBBB
-                    OPCODE(eKawaiOpcodes::TRNSP, "TRNSP", FF7ModelInstruction, 0, parameters.c_str()); // was B
-                    OPCODE(eKawaiOpcodes::AMBNT, "AMBNT", FF7ModelInstruction, 0, parameters.c_str()); // was BBBBBBB
-                    OPCODE(eKawaiOpcodes::Unknown03, "Unknown03", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown04, "Unknown04", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown05, "Unknown05", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::LIGHT, "LIGHT", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown07, "Unknown07", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown08, "Unknown08", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown09, "Unknown09", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::SBOBJ, "SBOBJ", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown0B, "Unknown0B", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::Unknown0C, "Unknown0C", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::SHINE, "SHINE", FF7ModelInstruction, 0, parameters.c_str());
-                    OPCODE(eKawaiOpcodes::RESET, "RESET", FF7ModelInstruction, 0, parameters.c_str());
-                default:
-                    throw UnknownSubOpcodeException(this->_address, opcode);
-                }
-                INC_ADDR;
-                INC_ADDR;
+                throw UnknownSubOpcodeException(instAddress, subOpcode);
             }
-            OPCODE_END
-                OPCODE(eOpcodes::KAWIW, "KAWIW", FF7ModelInstruction, 0, "");
-            OPCODE(eOpcodes::PMOVA, "PMOVA", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::PDIRA, "PDIRA", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::PTURA, "PTURA", FF7ModelInstruction, 0, "BBB");
-            OPCODE(eOpcodes::PGTDR, "PGTDR", FF7ModelInstruction, 0, "NBB");
-            OPCODE(eOpcodes::PXYZI, "PXYZI", FF7ModelInstruction, 0, "NNBBBBB");
-            OPCODE(eOpcodes::TLKON, "TLKON", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::PC, "PC", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::opCodeCHAR, "CHAR", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::DFANM, "DFANM", FF7ModelInstruction, 0, "BB");
-            OPCODE(eOpcodes::ANIME1, "ANIME1", FF7ModelInstruction, 0, "BB");
-            OPCODE(eOpcodes::VISI, "VISI", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::XYZI, "XYZI", FF7ModelInstruction, 0, "NNsssw");
-            OPCODE(eOpcodes::XYI, "XYI", FF7ModelInstruction, 0, "NNssw");
-            OPCODE(eOpcodes::XYZ, "XYZ", FF7ModelInstruction, 0, "NNsss");
-            OPCODE(eOpcodes::MOVE, "MOVE", FF7ModelInstruction, 0, "Nss");
-            OPCODE(eOpcodes::CMOVE, "CMOVE", FF7ModelInstruction, 0, "Nss");
-            OPCODE(eOpcodes::MOVA, "MOVA", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::TURA, "TURA", FF7ModelInstruction, 0, "BBB");
-            OPCODE(eOpcodes::ANIMW, "ANIMW", FF7ModelInstruction, 0, "");
-            OPCODE(eOpcodes::FMOVE, "FMOVE", FF7ModelInstruction, 0, "Nss");
-            OPCODE(eOpcodes::ANIME2, "ANIME2", FF7ModelInstruction, 0, "BB");
-            OPCODE(eOpcodes::ANIM_1, "ANIM!1", FF7ModelInstruction, 0, "BB");
-            OPCODE(eOpcodes::CANIM1, "CANIM1", FF7ModelInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::CANM_1, "CANM!1", FF7ModelInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::MSPED, "MSPED", FF7ModelInstruction, 0, "Nw");
-            OPCODE(eOpcodes::DIR, "DIR", FF7ModelInstruction, 0, "BB");
-            OPCODE(eOpcodes::TURNGEN, "TURNGEN", FF7ModelInstruction, 0, "NBBBB");
-            OPCODE(eOpcodes::TURN, "TURN", FF7ModelInstruction, 0, "NBBBB");
-            OPCODE(eOpcodes::DIRA, "DIRA", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::GETDIR, "GETDIR", FF7ModelInstruction, 0, "NBB");
-            OPCODE(eOpcodes::GETAXY, "GETAXY", FF7ModelInstruction, 0, "NBBB");
-            OPCODE(eOpcodes::GETAI, "GETAI", FF7ModelInstruction, 0, "NBB");
-            OPCODE(eOpcodes::ANIM_2, "ANIM!2", FF7ModelInstruction, 0, "BB");
-            OPCODE(eOpcodes::CANIM2, "CANIM2", FF7ModelInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::CANM_2, "CANM!2", FF7ModelInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::ASPED, "ASPED", FF7ModelInstruction, 0, "Nw");
-            OPCODE(eOpcodes::CC, "CC", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::JUMP, "JUMP", FF7ModelInstruction, 0, "NNssww");
-            OPCODE(eOpcodes::AXYZI, "AXYZI", FF7ModelInstruction, 0, "NNBBBBB");
-            OPCODE(eOpcodes::LADER, "LADER", FF7ModelInstruction, 0, "NNssswBBBB");
-            OPCODE(eOpcodes::OFST, "OFST", FF7ModelInstruction, 0, "NNBsssw");
-            OPCODE(eOpcodes::OFSTW, "OFSTW", FF7ModelInstruction, 0, "");
-            OPCODE(eOpcodes::TALKR, "TALKR", FF7ModelInstruction, 0, "NB");
-            OPCODE(eOpcodes::SLIDR, "SLIDR", FF7ModelInstruction, 0, "NB");
-            OPCODE(eOpcodes::SOLID, "SOLID", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::TLKR2, "TLKR2", FF7ModelInstruction, 0, "Nw");
-            OPCODE(eOpcodes::SLDR2, "SLDR2", FF7ModelInstruction, 0, "Nw");
-            OPCODE(eOpcodes::CCANM, "CCANM", FF7ModelInstruction, 0, "BBB");
-            OPCODE(eOpcodes::FCFIX, "FCFIX", FF7ModelInstruction, 0, "B");
-            OPCODE(eOpcodes::ANIMB, "ANIMB", FF7ModelInstruction, 0, "");
-            OPCODE(eOpcodes::TURNW, "TURNW", FF7ModelInstruction, 0, "");
-
-            // Walkmesh
-            OPCODE(eOpcodes::SLIP, "SLIP", FF7WalkmeshInstruction, 0, "B");
-            OPCODE(eOpcodes::UC, "UC", FF7WalkmeshInstruction, 0, "B");
-            OPCODE(eOpcodes::IDLCK, "IDLCK", FF7WalkmeshInstruction, 0, "wB");
-            OPCODE(eOpcodes::LINE, "LINE", FF7WalkmeshInstruction, 0, "ssssss");
-            OPCODE(eOpcodes::LINON, "LINON", FF7WalkmeshInstruction, 0, "B");
-            OPCODE(eOpcodes::SLINE, "SLINE", FF7WalkmeshInstruction, 0, "NNNssssss");
-
-            // Backgnd
-            OPCODE(eOpcodes::BGPDH, "BGPDH", FF7BackgroundInstruction, 0, "NBs");
-            OPCODE(eOpcodes::BGSCR, "BGSCR", FF7BackgroundInstruction, 0, "NBss");
-            OPCODE(eOpcodes::MPPAL, "MPPAL", FF7BackgroundInstruction, 0, "NNNBBBBBBB");
-            OPCODE(eOpcodes::BGON, "BGON", FF7BackgroundInstruction, 0, "NBB");
-            OPCODE(eOpcodes::BGOFF, "BGOFF", FF7BackgroundInstruction, 0, "NBB");
-            OPCODE(eOpcodes::BGROL, "BGROL", FF7BackgroundInstruction, 0, "NB");
-            OPCODE(eOpcodes::BGROL2, "BGROL2", FF7BackgroundInstruction, 0, "NB");
-            OPCODE(eOpcodes::BGCLR, "BGCLR", FF7BackgroundInstruction, 0, "NB");
-            OPCODE(eOpcodes::STPAL, "STPAL", FF7BackgroundInstruction, 0, "NBBB");
-            OPCODE(eOpcodes::LDPAL, "LDPAL", FF7BackgroundInstruction, 0, "NBBB");
-            OPCODE(eOpcodes::CPPAL, "CPPAL", FF7BackgroundInstruction, 0, "NBBB");
-            OPCODE(eOpcodes::RTPAL, "RTPAL", FF7BackgroundInstruction, 0, "NNBBBB");
-            OPCODE(eOpcodes::ADPAL, "ADPAL", FF7BackgroundInstruction, 0, "NNNBBBBBB");
-            OPCODE(eOpcodes::MPPAL2, "MPPAL2", FF7BackgroundInstruction, 0, "NNNBBBBBB");
-            OPCODE(eOpcodes::STPLS, "STPLS", FF7BackgroundInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::LDPLS, "LDPLS", FF7BackgroundInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::CPPAL2, "CPPAL2", FF7BackgroundInstruction, 0, "BBBBBBB");
-            OPCODE(eOpcodes::RTPAL2, "RTPAL2", FF7BackgroundInstruction, 0, "BBBBBBB");
-            OPCODE(eOpcodes::ADPAL2, "ADPAL2", FF7BackgroundInstruction, 0, "BBBBBBBBBB");
-
-            // Camera
-            OPCODE(eOpcodes::NFADE, "NFADE", FF7CameraInstruction, 0, "NNBBBBBB");
-            OPCODE(eOpcodes::SHAKE, "SHAKE", FF7CameraInstruction, 0, "BBBBBBB");
-            OPCODE(eOpcodes::SCRLO, "SCRLO", FF7CameraInstruction, 0, "B");
-            OPCODE(eOpcodes::SCRLC, "SCRLC", FF7CameraInstruction, 0, "BBBB");
-            OPCODE(eOpcodes::SCRLA, "SCRLA", FF7CameraInstruction, 0, "NwBB");
-            OPCODE(eOpcodes::SCR2D, "SCR2D", FF7CameraInstruction, 0, "Nss");
-            OPCODE(eOpcodes::SCRCC, "SCRCC", FF7CameraInstruction, 0, "");
-            OPCODE(eOpcodes::SCR2DC, "SCR2DC", FF7CameraInstruction, 0, "NNssw");
-            OPCODE(eOpcodes::SCRLW, "SCRLW", FF7CameraInstruction, 0, "");
-            OPCODE(eOpcodes::SCR2DL, "SCR2DL", FF7CameraInstruction, 0, "NNssw");
-            OPCODE(eOpcodes::VWOFT, "VWOFT", FF7CameraInstruction, 0, "NssB");
-            OPCODE(eOpcodes::FADE, "FADE", FF7CameraInstruction, 0, "NNBBBBBB");
-            OPCODE(eOpcodes::FADEW, "FADEW", FF7CameraInstruction, 0, "");
-            OPCODE(eOpcodes::SCRLP, "SCRLP", FF7CameraInstruction, 0, "NwBB");
-            OPCODE(eOpcodes::MVCAM, "MVCAM", FF7CameraInstruction, 0, "B");
-
-            // AV
-            OPCODE(eOpcodes::BGMOVIE, "BGMOVIE", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::AKAO2, "AKAO2", FF7AudioVideoInstruction, 0, "NNNBwwwww");
-            OPCODE(eOpcodes::MUSIC, "MUSIC", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::SOUND, "SOUND", FF7AudioVideoInstruction, 0, "NwB");
-            OPCODE(eOpcodes::AKAO, "AKAO", FF7AudioVideoInstruction, 0, "NNNBBwwww");
-            OPCODE(eOpcodes::MUSVT, "MUSVT", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::MUSVM, "MUSVM", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::MULCK, "MULCK", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::BMUSC, "BMUSC", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::CHMPH, "CHMPH", FF7AudioVideoInstruction, 0, "BBB");
-            OPCODE(eOpcodes::PMVIE, "PMVIE", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::MOVIE, "MOVIE", FF7AudioVideoInstruction, 0, "");
-            OPCODE(eOpcodes::MVIEF, "MVIEF", FF7AudioVideoInstruction, 0, "NB");
-            OPCODE(eOpcodes::FMUSC, "FMUSC", FF7AudioVideoInstruction, 0, "B");
-            OPCODE(eOpcodes::CMUSC, "CMUSC", FF7AudioVideoInstruction, 0, "BBBBBBB");
-            OPCODE(eOpcodes::CHMST, "CHMST", FF7AudioVideoInstruction, 0, "NB");
-
-            // Uncat
-            OPCODE(eOpcodes::MPDSP, "MPDSP", FF7UncategorizedInstruction, 0, "B");
-            OPCODE(eOpcodes::SETX, "SETX", FF7UncategorizedInstruction, 0, "BBBBBB");
-            OPCODE(eOpcodes::GETX, "GETX", FF7UncategorizedInstruction, 0, "BBBBBB");
-            OPCODE(eOpcodes::SEARCHX, "SEARCHX", FF7UncategorizedInstruction, 0, "BBBBBBBBBB");
-
-        default:
-            throw UnknownOpcodeException(this->_address, opcode);
+            AddInstruction(*record, instAddress);
+            readParams(mStore, record->mLayout);
+            _address++;
         }
-        INC_ADDR;
+        else if (opcode == eOpcodes::KAWAI)
+        {
+            // The length counts the opcode, itself and the sub opcode, the rest are byte parameters
+            const uint8 length = mStream->ReadU8();
+            assert(length >= 3);
+            const uint8 subOpcode = mStream->ReadU8();
+            record = FindSubOpcode(kKawaiOpcodes, (opcode << 8) | subOpcode);
+            if (!record)
+            {
+                throw UnknownSubOpcodeException(instAddress, subOpcode);
+            }
+            AddInstruction(*record, instAddress);
+            for (int i = 3; i < length; ++i)
+            {
+                const ParamValue param = { mStream->ReadU8(), false };
+                mStore.AddParam(param);
+                _address++;
+            }
+            _address += 2;
+        }
+        else
+        {
+            if (!record->mMnemonic)
+            {
+                throw UnknownOpcodeException(instAddress, opcode);
+            }
+            AddInstruction(*record, instAddress);
+            readParams(mStore, record->mLayout);
+        }
+        _address++;
 
         // Are we within an "if" statement tracking
-        InstPtr i = this->_insts.back();
-        if (i->isCondJump())
+        if (record->mFactoryFunc == &Create<FF7CondJumpInstruction>)
         {
-            exitAddrs.push_back(i->getDestAddress());
+            const size_t index = mStore.Size() - 1;
+            uint32 paramsSize = 0;
+            size_t jumpParamIndex = 0;
+            FF7CondJumpInstruction::JumpLayout(mStore.Address(index), mStore.Opcode(index), paramsSize, jumpParamIndex);
+            exitAddrs.push_back(mStore.Address(index) + static_cast<uint32>(mStore.Param(index, jumpParamIndex).mValue) + paramsSize);
         }
         if (!exitAddrs.empty())
         {
-            if (i->_address == exitAddrs.back())
+            if (instAddress == exitAddrs.back())
             {
                 exitAddrs.pop_back();
             }
         }
 
         // Only bail if its the first RET that isn't within an "if" block
-        if (full_opcode == eOpcodes::RET && exitAddrs.empty())
+        if (record->mOpCode == eOpcodes::RET && exitAddrs.empty())
         {
             return;
         }
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "simple_disassembler.h"
+#include "param_layout.h"
 #include "sudm.h"
 #include <array>
 
@@ -292,11 +293,19 @@ namespace FF7
 
     struct TInstructRecord
     {
+        constexpr TInstructRecord(unsigned char opCodeSize, unsigned int opCode, const char* mnemonic, const char* argumentFormat, InstPtr (*factoryFunc)())
+            : mOpCodeSize(opCodeSize), mOpCode(opCode), mMnemonic(mnemonic), mArgumentFormat(argumentFormat), mFactoryFunc(factoryFunc),
+              mLayout(argumentFormat ? ParamLayout(argumentFormat) : ParamLayout())
+        {
+
+        }
+
         unsigned char mOpCodeSize;
-        unsigned int mOpCode;
-        const char* mMnemonic;
+        unsigned int mOpCode;       // Includes the sub opcode in the low byte when mOpCodeSize is 2
+        const char* mMnemonic;      // nullptr for opcodes that don't exist
         const char* mArgumentFormat;
-        std::function<InstPtr()> mFactoryFunc;
+        InstPtr (*mFactoryFunc)();
+        ParamLayout mLayout;        // Compiled from mArgumentFormat, at compile time for the opcode tables
     };
 
     std::map<std::string, const TInstructRecord*> FieldInstructions();
@@ -314,6 +323,17 @@ namespace FF7
         virtual void open(const char *filename) override;
     public:
         virtual void doDisassemble() throw(std::exception) override;
+
+        // Dumps with the engine's stack effect setting, leaving the stream's own as it was
+        virtual void doDumpDisassembly(std::ostream& output) override;
+
+        // Disassembles in to Store() only, leaving a null Instruction for each one
+        void DisassembleToStore();
+
+        // Creates the Instruction objects of a function from Store(), unless they were already, and marks its jump targets
+        void MaterializeFunction(const Function& func);
+        const InstructionStore& Store() const { return mStore; }
+
         float ScaleFactor() const { return mScaleFactor; }
     private:
         void DisassembleIndivdualScript(std::string entityName,
@@ -327,9 +347,14 @@ namespace FF7
         void AddFunc(std::string entityName, size_t entityIndex, size_t scriptIndex, uint32 nextScriptEntryPoint, const bool isStart, const bool isEnd, bool toReturnOnly, std::string funcName);
 
         void ReadOpCodesToPositionOrReturn(size_t endPos);
+        void AddInstruction(const TInstructRecord& record, uint32 address);
         std::unique_ptr<Function> StartFunction(size_t scriptIndex);
 
         FF7FieldEngine* mEngine;
+        InstructionStore mStore;
+
+        // For each entity, the entry point and character id of its first function that has an id
+        std::map<std::string, std::pair<uint32, int>> mEntityCharacterIds;
 
         uint32 mHeaderEndPos = 0;
         void ReadHeader();
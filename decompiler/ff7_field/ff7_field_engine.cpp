@@ -1,13 +1,14 @@
 #include "ff7_field_engine.h"
 #include "ff7_field_disassembler.h"
 #include "ff7_field_codegen.h" 
+#include "decompiler/control_flow.h"
 
 #include <iostream>
 #include <sstream>
 #include <boost/format.hpp>
 #include "make_unique.h"
 
-#define GET(vertex) (boost::get(boost::vertex_name, g, vertex))
+#define GET(vertex) (get(boost::vertex_name, g, vertex))
 
 /*
 OpCodes which need implementing (already done in DAT dumper)
@@ -56,7 +57,7 @@ std::unique_ptr<CodeGenerator> FF7::FF7FieldEngine::getCodeGenerator(const InstV
     //return std::make_unique<FF7CodeGenerator>(this, insts, output);
 
     // dessert: the not-as-nice-but-at-least-it-works version
-    return std::make_unique<FF7SimpleCodeGenerator>(this, insts, output, mFormatter);
+    return std::make_unique<FF7SimpleCodeGenerator>(this, insts, output, mFormatter, mThreadPool, mCacheLookup);
 }
 
 void FF7::FF7FieldEngine::postCFG(InstVec& /*insts*/, Graph /*g*/)
@@ -76,13 +77,36 @@ void FF7::FF7FieldEngine::postCFG(InstVec& /*insts*/, Graph /*g*/)
     */
 }
 
+bool FF7::FF7FieldEngine::AnalyzeControlFlow(ControlFlow& controlFlow, InstVec& insts, SUDM::FF7::Field::ControlFlowMode mode, size_t budget)
+{
+    controlFlow.setAnalysisBudget(budget);
+    try
+    {
+        if (mode == SUDM::FF7::Field::ControlFlowMode::StructuredByDominators)
+        {
+            controlFlow.analyzeWithDominators();
+        }
+        else
+        {
+            controlFlow.analyze();
+        }
+        postCFG(insts, controlFlow.getGraph());
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        // Running out of budget or anything else, the code generator copes with no graph
+        return false;
+    }
+}
+
 std::map<std::string, int> FF7::FF7FieldEngine::GetEntities() const
 {
     std::map<std::string, int> r;
     for (auto& f : _functions)
     {
         const Function& func = f.second;
-        FF7::FunctionMetaData meta(func._metadata);
+        const FF7::FunctionMetaData& meta = *func.mMetaData;
         auto it = r.find(meta.EntityName());
         if (it != std::end(r))
         {
@@ -184,7 +208,7 @@ void FF7::FF7FieldEngine::MarkInfiniteLoopGroups(InstVec& insts, Graph g)
                 if ((*it)->isUncondJump())
                 {
                     // Then assume its an infinite do { } while(true) loop that wraps part of the script
-                    VertexRange vr = boost::vertices(g);
+                    VertexRange vr = vertices(g);
                     for (VertexIterator v = vr.first; v != vr.second; ++v)
                     {
                         GroupPtr gr = GET(*v);
@@ -302,11 +326,11 @@ void FF7::FF7CondJumpInstruction::processInst(Function&, ValueStack &stack, Engi
     stack.push(v); 
 }
 
-uint32 FF7::FF7CondJumpInstruction::getDestAddress() const
+void FF7::FF7CondJumpInstruction::JumpLayout(uint32 address, uint32 opcode, uint32& paramsSize, size_t& jumpParamIndex)
 {
-    uint32 paramsSize = 0;
-    uint32 jumpParamIndex = 5;
-    switch (_opcode)
+    paramsSize = 0;
+    jumpParamIndex = 5;
+    switch (opcode)
     {
     case eOpcodes::IFUB:
         paramsSize = 5;
@@ -346,9 +370,15 @@ uint32 FF7::FF7CondJumpInstruction::getDestAddress() const
         break;
 
     default:
-        throw UnknownJumpTypeException(_address, _opcode);
+        throw UnknownJumpTypeException(address, opcode);
     }
+}
 
+uint32 FF7::FF7CondJumpInstruction::getDestAddress() const
+{
+    uint32 paramsSize = 0;
+    size_t jumpParamIndex = 0;
+    JumpLayout(_address, _opcode, paramsSize, jumpParamIndex);
     return _address + _params[jumpParamIndex]->getUnsigned() + paramsSize;
 }
 
@@ -411,7 +441,7 @@ void FF7::FF7ControlFlowInstruction::processInst(Function& func, ValueStack&, En
 {
     FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -507,7 +537,7 @@ void FF7::FF7ModuleInstruction::processInst(Function& func, ValueStack&, Engine*
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -636,7 +666,7 @@ void FF7::FF7ModuleInstruction::processMAPJUMP(CodeGenerator* codeGen, Function&
     FF7SimpleCodeGenerator* cg = static_cast<FF7SimpleCodeGenerator*>(codeGen);
     const auto targetMapId = _params[0]->getUnsigned();
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
     const std::string sourceSpawnPointName = cg->mFormatter.SpawnPointName(targetMapId, md.EntityName(), func._name, _address);
 
     cg->mFormatter.AddSpawnPoint(targetMapId,
@@ -657,7 +687,7 @@ void FF7::FF7MathInstruction::processInst(Function& func, ValueStack&, Engine* /
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
     FF7SimpleCodeGenerator* cg = static_cast<FF7SimpleCodeGenerator*>(codeGen);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -980,7 +1010,7 @@ void FF7::FF7WindowInstruction::processInst(Function& func, ValueStack&, Engine*
 {
     FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -1119,7 +1149,7 @@ void FF7::FF7PartyInstruction::processInst(Function& func, ValueStack&, Engine*
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -1257,7 +1287,7 @@ void FF7::FF7ModelInstruction::processInst(Function& func, ValueStack&, Engine*
 {
     FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -1766,7 +1796,7 @@ void FF7::FF7WalkmeshInstruction::processInst(Function& func, ValueStack&, Engin
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -1812,7 +1842,7 @@ void FF7::FF7BackgroundInstruction::processInst(Function& func, ValueStack&, Eng
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -1993,7 +2023,7 @@ void FF7::FF7CameraInstruction::processInst(Function& func, ValueStack&, Engine*
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -2134,7 +2164,7 @@ void FF7::FF7AudioVideoInstruction::processInst(Function& func, ValueStack&, Eng
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
@@ -2271,7 +2301,7 @@ void FF7::FF7UncategorizedInstruction::processInst(Function& func, ValueStack&,
 {
     //FF7::FF7FieldEngine& eng = static_cast<FF7::FF7FieldEngine&>(*engine);
 
-    FunctionMetaData md(func._metadata);
+    const FunctionMetaData& md = *func.mMetaData;
 
     switch (_opcode)
     {
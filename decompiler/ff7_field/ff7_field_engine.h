@@ -5,8 +5,13 @@
 #include <vector>
 #include "sudm.h"
 
+class ThreadPool;
+template <class TGraph> class BasicControlFlow;
+
 namespace FF7
 {
+    struct FunctionCacheLookup;
+
     class FF7FieldEngine : public Engine
     {
     public:
@@ -41,6 +46,11 @@ namespace FF7
                 mFunctions[funcIndex] = funcName;
             }
 
+            const std::map< size_t, std::string >& Functions() const
+            {
+                return mFunctions;
+            }
+
         private:
             std::string mName;
             std::map< size_t, std::string > mFunctions;
@@ -52,13 +62,19 @@ namespace FF7
         FF7FieldEngine(SUDM::IScriptFormatter& formatter, std::string scriptName)
             : mFormatter(formatter), mScriptName(scriptName)
         {
-            setOutputStackEffect(false);
+            _outputStackEffect = false;
         }
         virtual std::unique_ptr<Disassembler> getDisassembler(InstVec &insts, const std::vector<unsigned char>& rawScriptData) override;
         virtual std::unique_ptr<Disassembler> getDisassembler(InstVec &insts) override;
         virtual std::unique_ptr<CodeGenerator> getCodeGenerator(const InstVec& insts, std::ostream &output) override;
         virtual void postCFG(InstVec &insts, Graph g) override;
         virtual bool usePureGrouping() const override { return false; }
+
+        // Analyzes the groups controlFlow made from insts the way mode says, which mustn't be Gotos, and runs
+        // postCFG on the result, taking at most budget steps. Returns false if any of that fails, as for a
+        // malformed script, in which case the graph is left partially analyzed and the script should be
+        // written with gotos.
+        bool AnalyzeControlFlow(BasicControlFlow<Graph>& controlFlow, InstVec& insts, SUDM::FF7::Field::ControlFlowMode mode, size_t budget);
         std::map<std::string, int> GetEntities() const;
         void AddEntityFunction(const std::string& entityName, size_t entityIndex, const std::string& funcName, size_t funcIndex);
 
@@ -71,8 +87,15 @@ namespace FF7
             }
             return it->second;
         }
+        const std::map<size_t, Entity>& Entities() const { return mEntityIndexMap; }
         float ScaleFactor() const { return mScaleFactor; }
         const std::string& ScriptName() const { return mScriptName; }
+
+        // Code generators made after this share out the entities of the script on pool, null generates serially
+        void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+        // Code generators made after this take the functions lookup has hits for from its cache
+        void SetFunctionCache(const FunctionCacheLookup* lookup) { mCacheLookup = lookup; }
     private:
         void RemoveExtraneousReturnStatements(InstVec& insts, Graph g);
         void RemoveTrailingInfiniteLoops(InstVec& insts, Graph g);
@@ -81,6 +104,8 @@ namespace FF7
         std::map<size_t, Entity> mEntityIndexMap;
         float mScaleFactor = 1.0f;
         std::string mScriptName;
+        ThreadPool* mThreadPool = nullptr;
+        const FunctionCacheLookup* mCacheLookup = nullptr;
     };
 
     class FF7UncondJumpInstruction : public UncondJumpInstruction
@@ -101,12 +126,14 @@ namespace FF7
         virtual void processInst(Function& func, ValueStack &stack, Engine *engine, CodeGenerator *codeGen) override;
         virtual uint32 getDestAddress() const override;
         virtual std::ostream& print(std::ostream &output) const override;
+
+        // Size of the parameters the jump is relative to and which parameter holds the offset, by opcode
+        static void JumpLayout(uint32 address, uint32 opcode, uint32& paramsSize, size_t& jumpParamIndex);
     };
 
     class FF7ControlFlowInstruction : public KernelCallInstruction
     {
     public:
-        static InstPtr Create() { return new FF7ControlFlowInstruction(); }
         virtual void processInst(Function& func, ValueStack &stack, Engine *engine, CodeGenerator *codeGen) override;
     private:
         void processREQ(CodeGenerator* codeGen, const FF7FieldEngine& engine);
@@ -252,7 +279,6 @@ namespace FF7
     class FF7NoOperationInstruction : public Instruction
     {
     public:
-        static InstPtr Create() { return new FF7NoOperationInstruction(); }
         virtual void processInst(Function& func, ValueStack &stack, Engine *engine, CodeGenerator *codeGen) override;
     };
 }
@@ -7,7 +7,7 @@
 #include <boost/format.hpp>
 #include "make_unique.h"
 
-#define GET(vertex) (boost::get(boost::vertex_name, g, vertex))
+#define GET(vertex) (get(boost::vertex_name, g, vertex))
 
 std::unique_ptr<Disassembler> FF7::FF7WorldEngine::getDisassembler(InstVec &insts)
 {
@@ -22,7 +22,7 @@ std::unique_ptr<CodeGenerator> FF7::FF7WorldEngine::getCodeGenerator(const InstV
 void FF7::FF7WorldEngine::postCFG(InstVec&, Graph g)
 {
     /*
-    VertexRange vr = boost::vertices(g);
+    VertexRange vr = vertices(g);
     for (VertexIterator v = vr.first; v != vr.second; ++v) 
     {
         GroupPtr gr = GET(*v);
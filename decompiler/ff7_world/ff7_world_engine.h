@@ -12,7 +12,7 @@ namespace FF7
         FF7WorldEngine(int scriptNumber)
             : mScriptNumber(scriptNumber)
         {
-            setOutputStackEffect(true);
+            _outputStackEffect = true;
         }
         std::unique_ptr<Disassembler> getDisassembler(InstVec &insts) override;
         std::unique_ptr<CodeGenerator> getCodeGenerator(const InstVec& insts, std::ostream &output) override;
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <boost/graph/properties.hpp>
+#include <boost/graph/graphviz.hpp> // edge_attribute_t
+
+/**
+ * Directed graph with integer vertex ids and flat adjacency storage, used for the control
+ * flow graph instead of a boost::adjacency_list of linked list vertices and std::set edges.
+ *
+ * Vertices are numbered from 0 in the order they're added and keep their number when others
+ * are removed, so a vertex is also its own vertex_index. Vertex properties live in one array
+ * indexed by vertex. Each vertex's out edges, and separately its in edges, are a run sorted by
+ * the vertex at the other end, CSR style, inside one shared array per direction. Runs have room
+ * to grow and one that runs out of room moves to the end of its array, so edges can still be
+ * added after construction. Like boost::setS there is at most one edge from a vertex to another.
+ *
+ * The free functions below are the part of the Boost.Graph interface the decompiler uses, so
+ * code calling them unqualified works on this and on a boost::adjacency_list alike. contract
+ * merges one vertex into another, which for the common case of a vertex whose only edge is to
+ * the one merged into it just hands over that vertex's out edges.
+ *
+ * TVertexProperty is the vertex_name property and TEdgeProperty the edge_attribute property.
+ */
+template <class TVertexProperty, class TEdgeProperty>
+class FlatGraph
+{
+public:
+    typedef uint32_t vertex_descriptor;
+    typedef TVertexProperty vertex_property_type;
+    typedef TEdgeProperty edge_property_type;
+
+    // Never a vertex of the graph, as boost::adjacency_list::null_vertex
+    static vertex_descriptor null_vertex() { return ~vertex_descriptor(0); }
+
+    struct edge_descriptor
+    {
+        vertex_descriptor mSource;
+        vertex_descriptor mTarget;
+
+        bool operator == (const edge_descriptor& rhs) const { return mSource == rhs.mSource && mTarget == rhs.mTarget; }
+        bool operator != (const edge_descriptor& rhs) const { return !(*this == rhs); }
+    };
+
+private:
+    struct OutEdge
+    {
+        vertex_descriptor mTarget;
+        TEdgeProperty mProperty;
+    };
+
+    // Where a vertex's edges are in mOutEdges or mInEdges
+    struct Run
+    {
+        uint32_t mBegin;
+        uint32_t mSize;
+        uint32_t mCapacity;
+    };
+
+public:
+    // Visits the vertices that haven't been removed, in the order they were added
+    class vertex_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef vertex_descriptor value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const vertex_descriptor* pointer;
+        typedef vertex_descriptor reference;
+
+        vertex_iterator() = default;
+
+        vertex_iterator(const FlatGraph* graph, vertex_descriptor v)
+            : mGraph(graph), mVertex(v)
+        {
+            skipRemoved();
+        }
+
+        vertex_descriptor operator * () const { return mVertex; }
+        vertex_iterator& operator ++ () { ++mVertex; skipRemoved(); return *this; }
+        vertex_iterator operator ++ (int) { vertex_iterator old = *this; ++*this; return old; }
+        bool operator == (const vertex_iterator& rhs) const { return mVertex == rhs.mVertex; }
+        bool operator != (const vertex_iterator& rhs) const { return mVertex != rhs.mVertex; }
+
+    private:
+        void skipRemoved()
+        {
+            while (mVertex < mGraph->mRemoved.size() && mGraph->mRemoved[mVertex])
+            {
+                ++mVertex;
+            }
+        }
+
+        const FlatGraph* mGraph = nullptr;
+        vertex_descriptor mVertex = 0;
+    };
+
+    class out_edge_iterator
+    {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef edge_descriptor value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const edge_descriptor* pointer;
+        typedef edge_descriptor reference;
+
+        out_edge_iterator() = default;
+
+        out_edge_iterator(vertex_descriptor source, const OutEdge* edge)
+            : mSource(source), mEdge(edge)
+        {
+
+        }
+
+        edge_descriptor operator * () const { return edge_descriptor{ mSource, mEdge->mTarget }; }
+        out_edge_iterator& operator ++ () { ++mEdge; return *this; }
+        out_edge_iterator operator ++ (int) { out_edge_iterator old = *this; ++mEdge; return old; }
+        std::ptrdiff_t operator - (const out_edge_iterator& rhs) const { return mEdge - rhs.mEdge; }
+        bool operator == (const out_edge_iterator& rhs) const { return mEdge == rhs.mEdge; }
+        bool operator != (const out_edge_iterator& rhs) const { return mEdge != rhs.mEdge; }
+
+    private:
+        vertex_descriptor mSource = 0;
+        const OutEdge* mEdge = nullptr;
+    };
+
+    class in_edge_iterator
+    {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef edge_descriptor value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const edge_descriptor* pointer;
+        typedef edge_descriptor reference;
+
+        in_edge_iterator() = default;
+
+        in_edge_iterator(vertex_descriptor target, const vertex_descriptor* source)
+            : mTarget(target), mSource(source)
+        {
+
+        }
+
+        edge_descriptor operator * () const { return edge_descriptor{ *mSource, mTarget }; }
+        in_edge_iterator& operator ++ () { ++mSource; return *this; }
+        in_edge_iterator operator ++ (int) { in_edge_iterator old = *this; ++mSource; return old; }
+        std::ptrdiff_t operator - (const in_edge_iterator& rhs) const { return mSource - rhs.mSource; }
+        bool operator == (const in_edge_iterator& rhs) const { return mSource == rhs.mSource; }
+        bool operator != (const in_edge_iterator& rhs) const { return mSource != rhs.mSource; }
+
+    private:
+        vertex_descriptor mTarget = 0;
+        const vertex_descriptor* mSource = nullptr;
+    };
+
+    // Make room for a graph of about this size up front, the graph works without it
+    void reserve(size_t numVertices, size_t numEdges)
+    {
+        mVertexProperties.reserve(numVertices);
+        mRemoved.reserve(numVertices);
+        mOutRuns.reserve(numVertices);
+        mInRuns.reserve(numVertices);
+        mOutEdges.reserve(2 * numEdges);
+        mInEdges.reserve(2 * numEdges);
+    }
+
+    vertex_descriptor addVertex()
+    {
+        const vertex_descriptor v = static_cast<vertex_descriptor>(mVertexProperties.size());
+        mVertexProperties.push_back(TVertexProperty());
+        mRemoved.push_back(false);
+        mOutRuns.push_back(Run{ 0, 0, 0 });
+        mInRuns.push_back(Run{ 0, 0, 0 });
+        mNumVertices++;
+        return v;
+    }
+
+    // Returns the edge from u to v and whether it was added, false if it was already there
+    std::pair<edge_descriptor, bool> addEdge(vertex_descriptor u, vertex_descriptor v)
+    {
+        OutEdge* begin = outBegin(u);
+        OutEdge* end = begin + mOutRuns[u].mSize;
+        OutEdge* pos = std::lower_bound(begin, end, v, [](const OutEdge& e, vertex_descriptor target) { return e.mTarget < target; });
+        if (pos != end && pos->mTarget == v)
+        {
+            return std::make_pair(edge_descriptor{ u, v }, false);
+        }
+
+        insert(mOutRuns[u], mOutEdges, static_cast<uint32_t>(pos - begin), OutEdge{ v, TEdgeProperty() });
+        insertSorted(mInRuns[v], mInEdges, u);
+        return std::make_pair(edge_descriptor{ u, v }, true);
+    }
+
+    // Removes every edge to and from v
+    void clearVertex(vertex_descriptor v)
+    {
+        Run& out = mOutRuns[v];
+        for (uint32_t i = 0; i < out.mSize; i++)
+        {
+            const vertex_descriptor target = mOutEdges[out.mBegin + i].mTarget;
+            if (target != v)
+            {
+                eraseSorted(mInRuns[target], mInEdges, v);
+            }
+        }
+        out.mSize = 0;
+
+        Run& in = mInRuns[v];
+        for (uint32_t i = 0; i < in.mSize; i++)
+        {
+            const vertex_descriptor source = mInEdges[in.mBegin + i];
+            if (source != v)
+            {
+                eraseOut(source, v);
+            }
+        }
+        in.mSize = 0;
+    }
+
+    // v must have no edges left, its number isn't reused
+    void removeVertex(vertex_descriptor v)
+    {
+        assert(mOutRuns[v].mSize == 0 && mInRuns[v].mSize == 0);
+        mVertexProperties[v] = TVertexProperty();
+        mRemoved[v] = true;
+        mNumVertices--;
+    }
+
+    /**
+     * Merges v into u: u gets v's out edges in place of its own edge to v, with v's edge
+     * property where both had an edge to the same vertex, then v is cleared and removed.
+     */
+    void contract(vertex_descriptor u, vertex_descriptor v)
+    {
+        Run& uOut = mOutRuns[u];
+        Run& vIn = mInRuns[v];
+        const bool onlyEdgeBetween = uOut.mSize == 1 && mOutEdges[uOut.mBegin].mTarget == v && vIn.mSize == 1;
+        if (onlyEdgeBetween)
+        {
+            // v's out edges become u's without copying them, their targets just need telling
+            std::swap(uOut, mOutRuns[v]);
+            mOutRuns[v].mSize = 0;
+            vIn.mSize = 0;
+            for (uint32_t i = 0; i < uOut.mSize; i++)
+            {
+                replaceSorted(mInRuns[mOutEdges[uOut.mBegin + i].mTarget], mInEdges, v, u);
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < mOutRuns[v].mSize; i++)
+            {
+                const OutEdge edge = mOutEdges[mOutRuns[v].mBegin + i];
+                if (edge.mTarget != v)
+                {
+                    addEdge(u, edge.mTarget);
+                    edgeProperty(edge_descriptor{ u, edge.mTarget }) = edge.mProperty;
+                }
+            }
+            clearVertex(v);
+        }
+        removeVertex(v);
+    }
+
+    size_t numVertices() const { return mNumVertices; }
+    size_t numVertexIds() const { return mVertexProperties.size(); }
+    bool isRemoved(vertex_descriptor v) const { return mRemoved[v]; }
+
+    vertex_iterator verticesBegin() const { return vertex_iterator(this, 0); }
+    vertex_iterator verticesEnd() const { return vertex_iterator(this, static_cast<vertex_descriptor>(mVertexProperties.size())); }
+
+    out_edge_iterator outEdgesBegin(vertex_descriptor v) const { return out_edge_iterator(v, outBegin(v)); }
+    out_edge_iterator outEdgesEnd(vertex_descriptor v) const { return out_edge_iterator(v, outBegin(v) + mOutRuns[v].mSize); }
+    in_edge_iterator inEdgesBegin(vertex_descriptor v) const { return in_edge_iterator(v, inBegin(v)); }
+    in_edge_iterator inEdgesEnd(vertex_descriptor v) const { return in_edge_iterator(v, inBegin(v) + mInRuns[v].mSize); }
+    size_t outDegree(vertex_descriptor v) const { return mOutRuns[v].mSize; }
+    size_t inDegree(vertex_descriptor v) const { return mInRuns[v].mSize; }
+
+    TVertexProperty& vertexProperty(vertex_descriptor v) { return mVertexProperties[v]; }
+    const TVertexProperty& vertexProperty(vertex_descriptor v) const { return mVertexProperties[v]; }
+
+    TEdgeProperty& edgeProperty(edge_descriptor e)
+    {
+        return const_cast<TEdgeProperty&>(static_cast<const FlatGraph*>(this)->edgeProperty(e));
+    }
+
+    const TEdgeProperty& edgeProperty(edge_descriptor e) const
+    {
+        const OutEdge* begin = outBegin(e.mSource);
+        const OutEdge* end = begin + mOutRuns[e.mSource].mSize;
+        const OutEdge* edge = std::lower_bound(begin, end, e.mTarget, [](const OutEdge& o, vertex_descriptor target) { return o.mTarget < target; });
+        assert(edge != end && edge->mTarget == e.mTarget);
+        return edge->mProperty;
+    }
+
+private:
+    OutEdge* outBegin(vertex_descriptor v) { return mOutEdges.data() + mOutRuns[v].mBegin; }
+    const OutEdge* outBegin(vertex_descriptor v) const { return mOutEdges.data() + mOutRuns[v].mBegin; }
+    const vertex_descriptor* inBegin(vertex_descriptor v) const { return mInEdges.data() + mInRuns[v].mBegin; }
+
+    // Makes room for one more entry in run, moving it to the end of edges if it's full
+    template <class T>
+    static void grow(Run& run, std::vector<T>& edges)
+    {
+        if (run.mSize < run.mCapacity)
+        {
+            return;
+        }
+
+        const uint32_t capacity = std::max<uint32_t>(2, run.mCapacity * 2);
+        if (run.mBegin + run.mCapacity == edges.size() && run.mCapacity > 0)
+        {
+            // Already last, so it can grow where it is
+            edges.resize(run.mBegin + capacity);
+        }
+        else
+        {
+            const uint32_t begin = static_cast<uint32_t>(edges.size());
+            edges.resize(begin + capacity);
+            std::copy(edges.begin() + run.mBegin, edges.begin() + run.mBegin + run.mSize, edges.begin() + begin);
+            run.mBegin = begin;
+        }
+        run.mCapacity = capacity;
+    }
+
+    template <class T>
+    static void insert(Run& run, std::vector<T>& edges, uint32_t index, const T& value)
+    {
+        grow(run, edges);
+        const auto begin = edges.begin() + run.mBegin;
+        std::copy_backward(begin + index, begin + run.mSize, begin + run.mSize + 1);
+        *(begin + index) = value;
+        run.mSize++;
+    }
+
+    static void insertSorted(Run& run, std::vector<vertex_descriptor>& edges, vertex_descriptor v)
+    {
+        const auto begin = edges.begin() + run.mBegin;
+        const auto pos = std::lower_bound(begin, begin + run.mSize, v);
+        insert(run, edges, static_cast<uint32_t>(pos - begin), v);
+    }
+
+    static void eraseSorted(Run& run, std::vector<vertex_descriptor>& edges, vertex_descriptor v)
+    {
+        const auto begin = edges.begin() + run.mBegin;
+        const auto end = begin + run.mSize;
+        const auto pos = std::lower_bound(begin, end, v);
+        if (pos != end && *pos == v)
+        {
+            std::copy(pos + 1, end, pos);
+            run.mSize--;
+        }
+    }
+
+    // Replaces from with to, or just removes from if to is already there
+    static void replaceSorted(Run& run, std::vector<vertex_descriptor>& edges, vertex_descriptor from, vertex_descriptor to)
+    {
+        const auto begin = edges.begin() + run.mBegin;
+        const auto end = begin + run.mSize;
+        if (std::binary_search(begin, end, to))
+        {
+            eraseSorted(run, edges, from);
+            return;
+        }
+        const auto pos = std::lower_bound(begin, end, from);
+        assert(pos != end && *pos == from);
+        *pos = to;
+        std::sort(begin, end);
+    }
+
+    void eraseOut(vertex_descriptor source, vertex_descriptor target)
+    {
+        Run& run = mOutRuns[source];
+        OutEdge* begin = outBegin(source);
+        OutEdge* end = begin + run.mSize;
+        OutEdge* pos = std::lower_bound(begin, end, target, [](const OutEdge& e, vertex_descriptor t) { return e.mTarget < t; });
+        if (pos != end && pos->mTarget == target)
+        {
+            std::copy(pos + 1, end, pos);
+            run.mSize--;
+        }
+    }
+
+    std::vector<TVertexProperty> mVertexProperties;
+    std::vector<bool> mRemoved;
+    std::vector<Run> mOutRuns;
+    std::vector<Run> mInRuns;
+    std::vector<OutEdge> mOutEdges;
+    std::vector<vertex_descriptor> mInEdges; // Sources, the edge properties are only kept with the out edges
+    size_t mNumVertices = 0;
+};
+
+// The Boost.Graph style interface to FlatGraph
+
+template <class V, class E>
+inline std::pair<typename FlatGraph<V, E>::vertex_iterator, typename FlatGraph<V, E>::vertex_iterator> vertices(const FlatGraph<V, E>& g)
+{
+    return std::make_pair(g.verticesBegin(), g.verticesEnd());
+}
+
+template <class V, class E>
+inline size_t num_vertices(const FlatGraph<V, E>& g)
+{
+    return g.numVertices();
+}
+
+template <class V, class E>
+inline std::pair<typename FlatGraph<V, E>::out_edge_iterator, typename FlatGraph<V, E>::out_edge_iterator> out_edges(typename FlatGraph<V, E>::vertex_descriptor v, const FlatGraph<V, E>& g)
+{
+    return std::make_pair(g.outEdgesBegin(v), g.outEdgesEnd(v));
+}
+
+template <class V, class E>
+inline std::pair<typename FlatGraph<V, E>::in_edge_iterator, typename FlatGraph<V, E>::in_edge_iterator> in_edges(typename FlatGraph<V, E>::vertex_descriptor v, const FlatGraph<V, E>& g)
+{
+    return std::make_pair(g.inEdgesBegin(v), g.inEdgesEnd(v));
+}
+
+template <class V, class E>
+inline size_t out_degree(typename FlatGraph<V, E>::vertex_descriptor v, const FlatGraph<V, E>& g)
+{
+    return g.outDegree(v);
+}
+
+template <class V, class E>
+inline size_t in_degree(typename FlatGraph<V, E>::vertex_descriptor v, const FlatGraph<V, E>& g)
+{
+    return g.inDegree(v);
+}
+
+template <class V, class E>
+inline typename FlatGraph<V, E>::vertex_descriptor source(typename FlatGraph<V, E>::edge_descriptor e, const FlatGraph<V, E>&)
+{
+    return e.mSource;
+}
+
+template <class V, class E>
+inline typename FlatGraph<V, E>::vertex_descriptor target(typename FlatGraph<V, E>::edge_descriptor e, const FlatGraph<V, E>&)
+{
+    return e.mTarget;
+}
+
+template <class V, class E>
+inline typename FlatGraph<V, E>::vertex_descriptor add_vertex(FlatGraph<V, E>& g)
+{
+    return g.addVertex();
+}
+
+template <class V, class E>
+inline std::pair<typename FlatGraph<V, E>::edge_descriptor, bool> add_edge(typename FlatGraph<V, E>::vertex_descriptor u, typename FlatGraph<V, E>::vertex_descriptor v, FlatGraph<V, E>& g)
+{
+    return g.addEdge(u, v);
+}
+
+template <class V, class E>
+inline void clear_vertex(typename FlatGraph<V, E>::vertex_descriptor v, FlatGraph<V, E>& g)
+{
+    g.clearVertex(v);
+}
+
+template <class V, class E>
+inline void remove_vertex(typename FlatGraph<V, E>::vertex_descriptor v, FlatGraph<V, E>& g)
+{
+    g.removeVertex(v);
+}
+
+template <class V, class E>
+inline void contract(typename FlatGraph<V, E>::vertex_descriptor u, typename FlatGraph<V, E>::vertex_descriptor v, FlatGraph<V, E>& g)
+{
+    g.contract(u, v);
+}
+
+template <class V, class E>
+inline const V& get(boost::vertex_name_t, const FlatGraph<V, E>& g, typename FlatGraph<V, E>::vertex_descriptor v)
+{
+    return g.vertexProperty(v);
+}
+
+template <class V, class E>
+inline void put(boost::vertex_name_t, FlatGraph<V, E>& g, typename FlatGraph<V, E>::vertex_descriptor v, const typename FlatGraph<V, E>::vertex_property_type& value)
+{
+    g.vertexProperty(v) = value;
+}
+
+// Vertices are numbered by the graph, so the index can be read but not set
+template <class V, class E>
+inline int get(boost::vertex_index_t, const FlatGraph<V, E>&, typename FlatGraph<V, E>::vertex_descriptor v)
+{
+    return static_cast<int>(v);
+}
+
+template <class V, class E>
+inline void put(boost::vertex_index_t, FlatGraph<V, E>&, typename FlatGraph<V, E>::vertex_descriptor v, int index)
+{
+    assert(static_cast<int>(v) == index);
+    (void)v;
+    (void)index;
+}
+
+template <class V, class E>
+inline const E& get(boost::edge_attribute_t, const FlatGraph<V, E>& g, typename FlatGraph<V, E>::edge_descriptor e)
+{
+    return g.edgeProperty(e);
+}
+
+template <class V, class E>
+inline void put(boost::edge_attribute_t, FlatGraph<V, E>& g, typename FlatGraph<V, E>::edge_descriptor e, const typename FlatGraph<V, E>::edge_property_type& value)
+{
+    g.edgeProperty(e) = value;
+}
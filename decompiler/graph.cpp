@@ -25,8 +25,27 @@
 void GraphProperties::operator()(std::ostream& out) const {
 	out << "node [shape=record]" << std::endl;
 	for (FuncMap::iterator fn = _engine->_functions.begin(); fn != _engine->_functions.end(); ++fn) {
-		int index = (boost::get(boost::vertex_index, *_g, fn->second._v));
+		int index = get(boost::vertex_index, *_g, fn->second._v);
 		out << "XXX" << index << " [shape=none, label=\"\", height=0]" << std::endl;
 		out << "XXX" << index << " -> " << index << std::endl;
 	}
 }
+
+void writeGraphviz(std::ostream &out, const Graph &g, bool stackEffect, const GraphProperties &properties) {
+	out << "digraph G {" << std::endl;
+	properties(out);
+	VertexRange vr = vertices(g);
+	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+		std::stringstream label;
+		label << StackEffect(stackEffect) << get(boost::vertex_name, g, *v);
+		out << get(boost::vertex_index, g, *v) << "[label=" << boost::escape_dot_string(label.str()) << "];" << std::endl;
+	}
+	for (VertexIterator v = vr.first; v != vr.second; ++v) {
+		OutEdgeRange r = out_edges(*v, g);
+		for (OutEdgeIterator e = r.first; e != r.second; ++e) {
+			out << get(boost::vertex_index, g, *v) << "->" << get(boost::vertex_index, g, target(*e, g)) << " ";
+			out << "[arrowhead=\"" << get(boost::edge_attribute, g, *e) << "\"];" << std::endl;
+		}
+	}
+	out << "}" << std::endl;
+}
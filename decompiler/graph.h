@@ -47,6 +47,8 @@
 
 #include <boost/intrusive_ptr.hpp>
 
+#include "flat_graph.h"
+
 /**
  * Enumeration representing the different kinds of groups.
  */
@@ -158,7 +160,12 @@ typedef boost::property<boost::edge_attribute_t, IsJump> EdgeProperty;
 /**
  * Type used for the code flow graph.
  */
-typedef boost::adjacency_list<boost::setS, boost::listS, boost::bidirectionalS, GraphProperty, EdgeProperty> Graph;
+typedef FlatGraph<GroupPtr, IsJump> Graph;
+
+/**
+ * The Boost.Graph type the code flow graph used to be, BasicControlFlow can still build one for comparison.
+ */
+typedef boost::adjacency_list<boost::setS, boost::listS, boost::bidirectionalS, GraphProperty, EdgeProperty> BoostGraph;
 
 /**
  * Type representing a vertex in the graph.
@@ -215,10 +222,7 @@ struct CodeLine {
 	 * @param unindentBefore Whether or not to remove an indentation level before the line. Defaults to false.
 	 * @param indentAfter Whether or not to add an indentation level after the line. Defaults to false.
 	 */
-	CodeLine(const std::string& line, bool unindentBefore, bool indentAfter) {
-		_line = line;
-		_unindentBefore = unindentBefore;
-		_indentAfter = indentAfter;
+	CodeLine(std::string line, bool unindentBefore, bool indentAfter) : _line(std::move(line)), _unindentBefore(unindentBefore), _indentAfter(indentAfter) {
 	}
 };
 
@@ -316,7 +320,7 @@ public:
 		ConstInstIterator inst = group->_start;
 		do {
 			std::stringstream stream;
-			stream << *inst;
+			stream << StackEffect(outputStackEffect(output)) << *inst;
 #if (BOOST_VERSION >= 104500)
 				output << stream.str();
 #else
@@ -376,11 +380,21 @@ public:
 	}
 
 	/**
-	 * Called by write_graphviz from Boost.Graph to print properties of the graph.
+	 * Called by writeGraphviz to print properties of the graph.
 	 *
-	 * @param out The std::ostream write_graphviz is writing to.
+	 * @param out The std::ostream writeGraphviz is writing to.
 	 */
 	void operator()(std::ostream& out) const;
 };
 
+/**
+ * Outputs a graph in graphviz dot format, as boost::write_graphviz does for a BoostGraph.
+ *
+ * @param out         The std::ostream to output to.
+ * @param g           The graph to output.
+ * @param stackEffect Whether instructions in the group labels should show their stack effect.
+ * @param properties  Properties of the graph as a whole.
+ */
+void writeGraphviz(std::ostream &out, const Graph &g, bool stackEffect, const GraphProperties &properties);
+
 #endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/**
+ * Incremental 64-bit FNV-1a hash, used to key caches of decompiled output. Not suitable
+ * where collisions could be forced on purpose, only for telling content apart.
+ */
+class Fnv1a
+{
+public:
+    void Add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            mHash = (mHash ^ bytes[i]) * kPrime;
+        }
+    }
+
+    // Strings are prefixed with their length so "ab" + "c" and "a" + "bc" differ
+    void Add(const std::string& str)
+    {
+        Add(static_cast<uint64_t>(str.size()));
+        Add(str.data(), str.size());
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type Add(T value)
+    {
+        Add(&value, sizeof(value));
+    }
+
+    uint64_t Value() const
+    {
+        return mHash;
+    }
+
+private:
+    static const uint64_t kOffsetBasis = 14695981039346656037ULL;
+    static const uint64_t kPrime = 1099511628211ULL;
+
+    uint64_t mHash = kOffsetBasis;
+};
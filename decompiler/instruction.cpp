@@ -23,10 +23,22 @@
 #include "decompiler_codegen.h"
 #include "decompiler_engine.h"
 
-bool outputStackEffect = true;
+#include <algorithm>
 
-void setOutputStackEffect(bool value) {
-	outputStackEffect = value;
+// Slot in each stream's iword storage for the StackEffect setting
+static int stackEffectIndex() {
+	static const int index = std::ios_base::xalloc();
+	return index;
+}
+
+std::ostream &operator<<(std::ostream &output, StackEffect effect) {
+	// Unused iword slots read as 0, so 0 has to mean the default of showing the effect
+	output.iword(stackEffectIndex()) = effect._enabled ? 0 : 1;
+	return output;
+}
+
+bool outputStackEffect(std::ostream &output) {
+	return output.iword(stackEffectIndex()) == 0;
 }
 
 bool Instruction::isJump() const {
@@ -77,7 +89,7 @@ std::ostream &Instruction::print(std::ostream &output) const {
 			output << ",";
 		output << " " << *param;
 	}
-	if (outputStackEffect)
+	if (outputStackEffect(output))
 		output << boost::format(" (%d)") % _stackChange;
 	return output;
 }
@@ -149,8 +161,9 @@ void UnaryOpPostfixStackInstruction::processInst(Function& , ValueStack &stack,
 
 void KernelCallStackInstruction::processInst(Function&, ValueStack &stack, Engine*, CodeGenerator *codeGen) {
 	codeGen->_argList.clear();
-	bool returnsValue = (_codeGenData.find("r") == 0);
-	std::string metadata = (!returnsValue ? _codeGenData : _codeGenData.substr(1));
+	const std::string &codeGenData = _codeGenData.str();
+	bool returnsValue = (codeGenData.find("r") == 0);
+	std::string metadata = (!returnsValue ? codeGenData : codeGenData.substr(1));
 	for (size_t i = 0; i < metadata.length(); i++)
 		codeGen->processSpecialMetadata(this, metadata[i], i);
 	stack.push(new CallValue(_name, codeGen->_argList));
@@ -164,3 +177,20 @@ void KernelCallStackInstruction::processInst(Function&, ValueStack &stack, Engin
 bool KernelCallInstruction::isKernelCall() const {
 	return true;
 }
+
+void markJumpTargets(InstIterator first, InstIterator last) {
+	for (InstIterator it = first; it != last; ++it) {
+		if (!(*it)->isJump())
+			continue;
+		const uint32 dest = (*it)->getDestAddress();
+		InstIterator target = std::lower_bound(first, last, dest, [](const InstPtr &inst, uint32 address) {
+			return inst->_address < address;
+		});
+		if (target == last || (*target)->_address != dest)
+			continue;
+		if ((*it)->isCondJump())
+			(*target)->mCondJumpsIn++;
+		else
+			(*target)->mLabelRequired = true;
+	}
+}
@@ -29,6 +29,7 @@
 
 #include "common/scummsys.h"
 #include "refcounted.h"
+#include "symbol.h"
 #include "value.h"
 #include "wrongtype.h"
 
@@ -36,9 +37,33 @@ class CodeGenerator;
 class Engine;
 
 /**
- * Changes whether or not to output the stack effect for an instruction.
+ * Stream manipulator setting whether Instructions printed to a stream show their stack effect.
+ * Streams show it unless told otherwise, engines that don't want it say so with
+ * Engine::_outputStackEffect, which whoever prints for them applies with
+ * output << StackEffect(engine->_outputStackEffect).
  */
-void setOutputStackEffect(bool value);
+struct StackEffect {
+	bool _enabled; ///< Whether to show the stack effect.
+
+	explicit StackEffect(bool enabled) : _enabled(enabled) { }
+};
+
+/**
+ * Apply a StackEffect setting to a stream.
+ *
+ * @param output The std::ostream to apply the setting to.
+ * @param effect The setting to apply.
+ * @return The std::ostream used for output.
+ */
+std::ostream &operator<<(std::ostream &output, StackEffect effect);
+
+/**
+ * Whether Instructions printed to a stream should show their stack effect.
+ *
+ * @param output The std::ostream to check.
+ * @return True unless the stream was given StackEffect(false).
+ */
+bool outputStackEffect(std::ostream &output);
 
 /**
  * Constants for categorizing the different kinds of instructions.
@@ -75,11 +100,12 @@ struct Instruction : public RefCounted {
 public:
 	uint32 _opcode;                 ///< The instruction opcode.
 	uint32 _address;                ///< The instruction address.
-	std::string _name;              ///< The instruction name (opcode name).
+	Symbol _name;                   ///< The instruction name (opcode name).
 	int16 _stackChange;             ///< How much this instruction changes the stack pointer by.
 	std::vector<ValuePtr> _params;  ///< Array of parameters used for the instruction.
-	std::string _codeGenData;       ///< String containing metadata for code generation. See the extended documentation for details.
-    bool mLabelRequired = false;
+	Symbol _codeGenData;            ///< String containing metadata for code generation. See the extended documentation for details.
+    bool mLabelRequired = false;    ///< Whether an unconditional jump from the same function targets the instruction, set by markJumpTargets.
+    uint16 mCondJumpsIn = 0;        ///< Number of conditional jumps from the same function targeting the instruction, set by markJumpTargets.
 
 	/**
 	 * Operator overload to output an Instruction to a std::ostream.
@@ -340,4 +366,13 @@ typedef InstVec::iterator InstIterator;
  */
 typedef InstVec::const_iterator ConstInstIterator;
 
+/**
+ * Record on each instruction of a function the jumps in it that target the instruction, so code
+ * generation knows where labels go without a pass over the jumps of its own.
+ *
+ * @param first The first instruction of the function. Instructions must be in address order.
+ * @param last  One past the last instruction of the function.
+ */
+void markJumpTargets(InstIterator first, InstIterator last);
+
 #endif
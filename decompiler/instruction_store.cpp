@@ -0,0 +1,50 @@
+#include "instruction_store.h"
+#include "value.h"
+
+size_t InstructionStore::Add(FactoryFunc factory, uint32 opcode, uint32 address, int16 stackChange, const char* mnemonic)
+{
+    auto it = mMnemonicIndex.find(mnemonic);
+    if (it == std::end(mMnemonicIndex))
+    {
+        it = mMnemonicIndex.insert(std::make_pair(mnemonic, static_cast<uint16>(mMnemonics.size()))).first;
+        mMnemonics.push_back(Symbol(mnemonic));
+    }
+
+    mOpcodes.push_back(opcode);
+    mAddresses.push_back(address);
+    mStackChanges.push_back(stackChange);
+    mMnemonicIds.push_back(it->second);
+    mFactories.push_back(factory);
+    mParamEnd.push_back(static_cast<uint32>(mParams.size()));
+    return mOpcodes.size() - 1;
+}
+
+InstPtr InstructionStore::Materialize(size_t index) const
+{
+    InstPtr inst = mFactories[index]();
+    inst->_opcode = mOpcodes[index];
+    inst->_address = mAddresses[index];
+    inst->_stackChange = mStackChanges[index];
+    inst->_name = Mnemonic(index);
+
+    const size_t count = ParamCount(index);
+    inst->_params.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const ParamValue& param = Param(index, i);
+        inst->_params.push_back(new IntValue(param.mValue, param.mIsSigned));
+    }
+    return inst;
+}
+
+size_t InstructionStore::MemoryUsage() const
+{
+    return mOpcodes.capacity() * sizeof(uint32) +
+        mAddresses.capacity() * sizeof(uint32) +
+        mStackChanges.capacity() * sizeof(int16) +
+        mMnemonicIds.capacity() * sizeof(uint16) +
+        mFactories.capacity() * sizeof(FactoryFunc) +
+        mParamEnd.capacity() * sizeof(uint32) +
+        mParams.capacity() * sizeof(ParamValue) +
+        mMnemonics.capacity() * sizeof(Symbol);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "instruction.h"
+#include "param_layout.h"
+#include <unordered_map>
+
+/**
+ * Flat struct-of-arrays storage for disassembled instructions. Each field lives in its own
+ * array, mnemonics are stored once and referred to by id, and parameters are stored inline
+ * in one shared array rather than as separately allocated values.
+ *
+ * Code that still needs the polymorphic Instruction interface can materialize instructions
+ * from the store once disassembly is finished.
+ */
+class InstructionStore
+{
+public:
+    typedef InstPtr (*FactoryFunc)();
+
+    InstructionStore() = default;
+    InstructionStore(const InstructionStore&) = delete;
+    InstructionStore& operator = (const InstructionStore&) = delete;
+
+    /**
+     * Adds an instruction, parameters added after this belong to it.
+     *
+     * @param factory  Creates the Instruction subclass when materializing.
+     * @param opcode   The instruction opcode.
+     * @param address  The instruction address.
+     * @param stackChange How much the instruction changes the stack pointer by.
+     * @param mnemonic The instruction name, which must have static storage duration as it is looked up by address.
+     * @return The index of the instruction.
+     */
+    size_t Add(FactoryFunc factory, uint32 opcode, uint32 address, int16 stackChange, const char* mnemonic);
+
+    void AddParam(const ParamValue& param)
+    {
+        mParams.push_back(param);
+        mParamEnd.back()++;
+    }
+
+    size_t Size() const { return mOpcodes.size(); }
+    bool Empty() const { return mOpcodes.empty(); }
+
+    uint32 Opcode(size_t index) const { return mOpcodes[index]; }
+    uint32 Address(size_t index) const { return mAddresses[index]; }
+    int16 StackChange(size_t index) const { return mStackChanges[index]; }
+    uint16 MnemonicId(size_t index) const { return mMnemonicIds[index]; }
+    const Symbol& Mnemonic(size_t index) const { return mMnemonics[mMnemonicIds[index]]; }
+
+    size_t ParamCount(size_t index) const { return mParamEnd[index] - ParamBegin(index); }
+    const ParamValue& Param(size_t index, size_t param) const { return mParams[ParamBegin(index) + param]; }
+
+    /**
+     * Builds a full Instruction for code that still needs the polymorphic interface.
+     */
+    InstPtr Materialize(size_t index) const;
+
+    /**
+     * Bytes reserved by the store, not counting the mnemonic strings which live in the symbol table.
+     */
+    size_t MemoryUsage() const;
+
+private:
+    size_t ParamBegin(size_t index) const { return index == 0 ? 0 : mParamEnd[index - 1]; }
+
+    std::vector<uint32> mOpcodes;
+    std::vector<uint32> mAddresses;
+    std::vector<int16> mStackChanges;
+    std::vector<uint16> mMnemonicIds;
+    std::vector<FactoryFunc> mFactories;
+    std::vector<uint32> mParamEnd;      // One past the last parameter of each instruction
+    std::vector<ParamValue> mParams;
+
+    std::vector<Symbol> mMnemonics;
+    std::unordered_map<const char*, uint16> mMnemonicIndex;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include "unknown_opcode_exception.h"
+
+// A single decoded integer parameter, kept inline rather than as an allocated IntValue
+struct ParamValue
+{
+    std::int32_t mValue;
+    bool mIsSigned;
+};
+
+/**
+ * A parameter format string such as "NBBBB" compiled to one 4 bit kind per character,
+ * so decoding an instruction is a switch on the kind rather than string comparisons.
+ * Construction is constexpr so opcode tables can hold their layouts precompiled.
+ */
+class ParamLayout
+{
+public:
+    enum eKind
+    {
+        eNibbles = 0,   // N, one byte split in to two 4 bit values
+        eBitField = 1,  // U, one byte split in to a 3 bit and a 5 bit value
+        eS8 = 2,        // b
+        eU8 = 3,        // B
+        eS16 = 4,       // s
+        eU16 = 5,       // w
+        eS32 = 6,       // i
+        eU32 = 7,       // d
+        eCustom = 8     // Anything else, handed to SimpleDisassembler::readParameter
+    };
+
+    static const unsigned int kMaxParams = 16;
+
+    constexpr ParamLayout()
+        : mFormat(""), mKinds(0), mCount(0)
+    {
+
+    }
+
+    constexpr ParamLayout(const char* format)
+        : mFormat(format), mKinds(Pack(format, 0)), mCount(Length(format, 0))
+    {
+
+    }
+
+    constexpr unsigned int Count() const
+    {
+        return mCount;
+    }
+
+    constexpr eKind Kind(unsigned int index) const
+    {
+        return static_cast<eKind>((mKinds >> (index * 4)) & 0xF);
+    }
+
+    // The original format character, needed for eCustom parameters
+    constexpr char Format(unsigned int index) const
+    {
+        return mFormat[index];
+    }
+
+    static constexpr eKind KindOf(char c)
+    {
+        return c == 'N' ? eNibbles :
+            c == 'U' ? eBitField :
+            c == 'b' ? eS8 :
+            c == 'B' ? eU8 :
+            c == 's' ? eS16 :
+            c == 'w' ? eU16 :
+            c == 'i' ? eS32 :
+            c == 'd' ? eU32 :
+            eCustom;
+    }
+
+private:
+    static constexpr unsigned int Length(const char* format, unsigned int length)
+    {
+        return *format == '\0' ? length :
+            length == kMaxParams ? throw InternalDecompilerError() :
+            Length(format + 1, length + 1);
+    }
+
+    static constexpr std::uint64_t Pack(const char* format, unsigned int shift)
+    {
+        return *format == '\0' || shift >= kMaxParams * 4 ? 0 :
+            (static_cast<std::uint64_t>(KindOf(*format)) << shift) | Pack(format + 1, shift + 4);
+    }
+
+    const char* mFormat;
+    std::uint64_t mKinds;
+    unsigned int mCount;
+};
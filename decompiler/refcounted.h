@@ -22,6 +22,9 @@
 #ifndef REFCOUNTED_H
 #define REFCOUNTED_H
 
+#include "arena.h"
+#include <new>
+
 class RefCounted;
 
 inline void intrusive_ptr_add_ref(RefCounted *p);
@@ -33,26 +36,52 @@ inline void intrusive_ptr_release(RefCounted *p);
 class RefCounted {
 private:
 	long _refCount; ///< Reference count used for boost::intrusive_ptr.
+	const bool _inArena; ///< Owned by an Arena, which destroys it, so the reference count is unused.
 	friend void ::intrusive_ptr_add_ref(RefCounted *p); ///< Allow access by reference counting methods.
 	friend void ::intrusive_ptr_release(RefCounted *p); ///< Allow access by reference counting methods.
+	friend class Arena; ///< Allow the arena to destroy the objects it owns.
 
 protected:
-	RefCounted() : _refCount(0) { }
+	RefCounted() : _refCount(0), _inArena(Arena::Claim(this)) { }
+	RefCounted(const RefCounted &) : _refCount(0), _inArena(Arena::Claim(this)) { }
+	RefCounted &operator=(const RefCounted &) { return *this; }
 	virtual ~RefCounted() { }
+
+public:
+	/**
+	 * Allocates from the current thread's Arena if there is one, otherwise from the heap.
+	 */
+	static void *operator new(size_t size) {
+		return Arena::Current() ? Arena::AllocateObject(size) : ::operator new(size);
+	}
+
+	/**
+	 * Arena memory is only released with the arena. This is reached for arena memory if a
+	 * constructor throws, in which case the arena must forget the object.
+	 */
+	static void operator delete(void *p) {
+		Arena *arena = Arena::Current();
+		if (arena && arena->Owns(p)) {
+			arena->Forget(p);
+			return;
+		}
+		::operator delete(p);
+	}
 };
 
 /**
  * Add a reference to a pointer.
  */
 inline void intrusive_ptr_add_ref(RefCounted *p) {
-	++(p->_refCount);
+	if (!p->_inArena)
+		++(p->_refCount);
 }
 
 /**
  * Remove a reference from a pointer.
  */
 inline void intrusive_ptr_release(RefCounted *p) {
-	if (--(p->_refCount) == 0)
+	if (!p->_inArena && --(p->_refCount) == 0)
 		delete p;
 }
 
@@ -55,29 +55,102 @@ void SimpleDisassembler::readParams(InstPtr inst, const char *typeString)
 {
     // Handle [] blocks as working on an individual element (i.e a BYTE,WORD etc)
     // this syntax allows picking of nibbles and bit fields into their own parameters.
-    while (*typeString)
+    for (; *typeString; typeString++)
     {
-        std::string typeStr(typeString, 1);
-        if (typeStr == "N") // Read nibbles 
-        {
-            const uint8 byte = mStream->ReadU8();
+        readParam(inst, ParamLayout::KindOf(*typeString), *typeString);
+    }
+}
 
-            inst->_params.push_back(new IntValue(Nib1(byte), false));
-            inst->_params.push_back(new IntValue(Nib2(byte), false));
-            _address++;
-        }
-        else if (typeStr == "U")
+void SimpleDisassembler::readParams(const InstPtr& inst, const ParamLayout& layout)
+{
+    for (unsigned int i = 0; i < layout.Count(); i++)
+    {
+        readParam(inst, layout.Kind(i), layout.Format(i));
+    }
+}
+
+void SimpleDisassembler::readParams(InstructionStore& store, const ParamLayout& layout)
+{
+    for (unsigned int i = 0; i < layout.Count(); i++)
+    {
+        if (layout.Kind(i) == ParamLayout::eCustom)
         {
-            const uint8 byte = mStream->ReadU8();
-            inst->_params.push_back( new IntValue((byte >> 5) & 0x7, false));
-            inst->_params.push_back( new IntValue((byte & 0x1F), false));
-            _address++;
+            // Custom types produce arbitrary Values, which the store can't hold
+            throw UnknownOpcodeParameterException(std::string(1, layout.Format(i)));
         }
-        else
+
+        ParamValue values[2];
+        const unsigned int count = readRaw(layout.Kind(i), values);
+        for (unsigned int j = 0; j < count; j++)
         {
-            inst->_params.push_back(readParameter(inst, typeStr));
+            store.AddParam(values[j]);
         }
-        typeString++;
+    }
+}
+
+void SimpleDisassembler::readParam(const InstPtr& inst, ParamLayout::eKind kind, char type)
+{
+    if (kind == ParamLayout::eCustom)
+    {
+        inst->_params.push_back(readParameter(inst, std::string(1, type)));
+        return;
+    }
+
+    ParamValue values[2];
+    const unsigned int count = readRaw(kind, values);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        inst->_params.push_back(new IntValue(values[i].mValue, values[i].mIsSigned));
+    }
+}
+
+unsigned int SimpleDisassembler::readRaw(ParamLayout::eKind kind, ParamValue* values)
+{
+    switch (kind)
+    {
+    case ParamLayout::eNibbles: // Two 4 bit values
+    {
+        const uint8 byte = mStream->ReadU8();
+        values[0] = { static_cast<int32>(Nib1(byte)), false };
+        values[1] = { static_cast<int32>(Nib2(byte)), false };
+        _address++;
+        return 2;
+    }
+    case ParamLayout::eBitField: // A 3 bit value then a 5 bit value
+    {
+        const uint8 byte = mStream->ReadU8();
+        values[0] = { (byte >> 5) & 0x7, false };
+        values[1] = { byte & 0x1F, false };
+        _address++;
+        return 2;
+    }
+    case ParamLayout::eS8: // signed byte
+        values[0] = { mStream->ReadS8(), true };
+        _address++;
+        return 1;
+    case ParamLayout::eU8: // unsigned byte
+        values[0] = { mStream->ReadU8(), false };
+        _address++;
+        return 1;
+    case ParamLayout::eS16: // 16-bit signed integer (short), little-endian
+        values[0] = { mStream->ReadS16(), true };
+        _address += 2;
+        return 1;
+    case ParamLayout::eU16: // 16-bit unsigned integer (word), little-endian
+        values[0] = { mStream->ReadU16(), false };
+        _address += 2;
+        return 1;
+    case ParamLayout::eS32: // 32-bit signed integer (int), little-endian
+        values[0] = { mStream->ReadS32(), true };
+        _address += 4;
+        return 1;
+    case ParamLayout::eU32: // 32-bit unsigned integer (dword), little-endian
+        values[0] = { static_cast<int32>(mStream->ReadU32()), false };
+        _address += 4;
+        return 1;
+    case ParamLayout::eCustom: // Not a raw integer, callers read these with readParameter
+    default:
+        throw InternalDecompilerError();
     }
 }
 
@@ -103,43 +176,15 @@ void SimpleDisassembler::readParams(InstPtr inst, const char *typeString, const
     }
 }
 
-ValuePtr SimpleDisassembler::readParameter(InstPtr inst, std::string type) {
-    ValuePtr retval = NULL;
-
-    if (type == "b") // signed byte
-    {
-        retval = new IntValue(mStream->ReadS8(), true);
-        _address++;
-    }
-    else if (type == "B") // unsigned byte
-    {
-        retval = new IntValue((uint32)mStream->ReadU8(), false);
-        _address++;
-    }
-    else if (type == "s") // 16-bit signed integer (short), little-endian
-    {
-        retval = new IntValue(mStream->ReadS16(), true);
-        _address += 2;
-    }
-    else if (type == "w") // 16-bit unsigned integer (word), little-endian
-    {
-        retval = new IntValue((uint32)mStream->ReadU16(), false);
-        _address += 2;
-    }
-    else if (type == "i") // 32-bit signed integer (int), little-endian
-    {
-        retval = new IntValue(mStream->ReadS32(), true);
-        _address += 4;
-    }
-    else if (type == "d") // 32-bit unsigned integer (dword), little-endian
-    {
-        retval = new IntValue(mStream->ReadU32(), false);
-        _address += 4;
-    }
-    else
+ValuePtr SimpleDisassembler::readParameter(InstPtr /*inst*/, std::string type) {
+    // Nibbles and bit fields make two parameters, so they can't be read as one here
+    const ParamLayout::eKind kind = type.size() == 1 ? ParamLayout::KindOf(type[0]) : ParamLayout::eCustom;
+    if (kind == ParamLayout::eNibbles || kind == ParamLayout::eBitField || kind == ParamLayout::eCustom)
     {
         throw UnknownOpcodeParameterException(type);
     }
-    return retval;
-}
 
+    ParamValue value;
+    readRaw(kind, &value);
+    return new IntValue(value.mValue, value.mIsSigned);
+}
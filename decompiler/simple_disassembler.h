@@ -23,6 +23,8 @@
 #define DEC_SIMPLE_DISASSEMBLER_H
 
 #include "decompiler_disassembler.h"
+#include "param_layout.h"
+#include "instruction_store.h"
 
 /**
  * Simple disassembler acting as a base for instruction sets only consisting of simple instructions (opcode params...).
@@ -41,7 +43,42 @@ protected:
     void readParams(InstPtr inst, const char *typeString, const std::vector<std::string>& params);
 
 	/**
-	 * Reads data for a single parameter.
+	 * Read parameters described by a precompiled layout and associate them with an instruction.
+	 *
+	 * @param inst   The instruction to associate the parameters with.
+	 * @param layout Compiled form of the parameter type string.
+	 */
+	void readParams(const InstPtr& inst, const ParamLayout& layout);
+
+	/**
+	 * Reads a single parameter of a known kind, eCustom kinds are passed on to readParameter.
+	 *
+	 * @param inst The instruction to associate the parameter with.
+	 * @param kind The kind of parameter to read.
+	 * @param type The format character the kind came from.
+	 */
+	void readParam(const InstPtr& inst, ParamLayout::eKind kind, char type);
+
+	/**
+	 * Read parameters described by a precompiled layout in to the last instruction of a store.
+	 *
+	 * @param store  The store whose last instruction the parameters belong to.
+	 * @param layout Compiled form of the parameter type string, which can't contain custom types.
+	 */
+	void readParams(InstructionStore& store, const ParamLayout& layout);
+
+	/**
+	 * Reads the integers for a single parameter of any kind except eCustom.
+	 *
+	 * @param kind   The kind of parameter to read.
+	 * @param values Receives the values, nibbles and bit fields make two.
+	 * @return The number of values written.
+	 */
+	unsigned int readRaw(ParamLayout::eKind kind, ParamValue* values);
+
+	/**
+	 * Reads data for a single parameter. readParams only calls this for characters that
+	 * ParamLayout doesn't know, so override it to add new parameter types.
 	 *
 	 * @param inst The instruction the parameter will belong to. Used for reference in parameter reading.
 	 * @param type Character describing the type of the parameter.
@@ -88,9 +125,15 @@ public:
 		LAST_INST->_opcode = full_opcode; \
 		LAST_INST->_address = this->_address; \
 		LAST_INST->_stackChange = stackChange; \
-		LAST_INST->_name = opcodePrefix + std::string(name); \
-		LAST_INST->_codeGenData = codeGenData; \
-		this->readParams(LAST_INST, params); \
+		{ \
+			/* The prefix is fixed for each opcode, so intern the names once per opcode */ \
+			static const Symbol kName(opcodePrefix + name); \
+			static const Symbol kCodeGenData(codeGenData); \
+			static constexpr ParamLayout kLayout(params); \
+			LAST_INST->_name = kName; \
+			LAST_INST->_codeGenData = kCodeGenData; \
+			this->readParams(LAST_INST, kLayout); \
+		} \
 
 #define OPCODE_MD(val, name, category, stackChange, params, codeGenData) \
 	OPCODE_BASE(val)\
@@ -22,31 +22,184 @@
 #ifndef DEC_STACK_H
 #define DEC_STACK_H
 
-#include <deque>
+#include <cstddef>
 #include <iostream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 /**
- * Stack class based on a deque.
+ * Stack class based on a contiguous array, bottom item first.
+ *
+ * The first InlineCapacity items are stored inside the stack itself, so shallow stacks, which
+ * is what code generation mostly deals with, never touch the heap to be created, copied or
+ * grown. Deeper stacks move to a heap array, four times the inline size and then doubling as
+ * needed, which is kept until the stack is destroyed however far it is popped.
  */
-template<typename T>
+template<typename T, size_t InlineCapacity = 4>
 class Stack {
 private:
-	std::deque<T> _stack; ///< Container used for the stack.
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type _inline[InlineCapacity]; ///< Storage for the items while they fit.
+	T *_items;        ///< The items, bottom first: either _inline or a heap array.
+	size_t _size;     ///< Number of items on the stack.
+	size_t _capacity; ///< Number of items _items has room for.
+
+	/**
+	 * Returns whether or not the items are stored in _inline.
+	 */
+	bool isInline() const { return _items == reinterpret_cast<const T *>(_inline); }
+
+	/**
+	 * Destroy every item, keeping the storage.
+	 */
+	void clear() {
+		for (size_t i = _size; i > 0; i--)
+			_items[i - 1].~T();
+		_size = 0;
+	}
+
+	/**
+	 * Make room for at least the given number of items.
+	 *
+	 * @param capacity The number of items to make room for.
+	 */
+	void reserve(size_t capacity) {
+		if (capacity <= _capacity)
+			return;
+		// A stack that outgrows its inline items is likely to go much deeper, so skip the small heap arrays
+		const size_t grown = isInline() ? InlineCapacity * 4 : _capacity * 2;
+		if (capacity < grown)
+			capacity = grown;
+		T *items = static_cast<T *>(::operator new(capacity * sizeof(T)));
+		for (size_t i = 0; i < _size; i++) {
+			new (&items[i]) T(std::move(_items[i]));
+			_items[i].~T();
+		}
+		if (!isInline())
+			::operator delete(_items);
+		_items = items;
+		_capacity = capacity;
+	}
+
+	/**
+	 * Take over the items of another stack, leaving it empty.
+	 *
+	 * @param other The stack to take the items of. This stack must be empty, and inline unless other is.
+	 */
+	void steal(Stack &other) {
+		if (other.isInline()) {
+			for (size_t i = 0; i < other._size; i++)
+				new (&_items[i]) T(std::move(other._items[i]));
+			_size = other._size;
+			other.clear();
+		} else {
+			_items = other._items;
+			_size = other._size;
+			_capacity = other._capacity;
+			other._items = reinterpret_cast<T *>(other._inline);
+			other._size = 0;
+			other._capacity = InlineCapacity;
+		}
+	}
+
+	/**
+	 * Return the item on the specificed stack position, warning if it is not there.
+	 *
+	 * @param pos The number of items to skip on the stack.
+	 * @return Index of the desired item in _items.
+	 */
+	size_t index(size_t pos) const {
+		if (pos >= _size) {
+			std::cerr << "WARNING: Looking outside stack\n";
+			throw std::out_of_range("Stack::peekPos");
+		}
+		return _size - 1 - pos;
+	}
+
 public:
+	Stack() : _items(reinterpret_cast<T *>(_inline)), _size(0), _capacity(InlineCapacity) {}
+
+	Stack(const Stack &other) : Stack() {
+		*this = other;
+	}
+
+	Stack(Stack &&other) noexcept : Stack() {
+		steal(other);
+	}
+
+	~Stack() {
+		clear();
+		if (!isInline())
+			::operator delete(_items);
+	}
+
+	Stack &operator=(const Stack &other) {
+		if (this == &other)
+			return *this;
+		clear();
+		reserve(other._size);
+		for (size_t i = 0; i < other._size; i++)
+			new (&_items[i]) T(other._items[i]);
+		_size = other._size;
+		return *this;
+	}
+
+	Stack &operator=(Stack &&other) noexcept {
+		if (this == &other)
+			return *this;
+		clear();
+		if (!other.isInline() && !isInline()) {
+			::operator delete(_items);
+			_items = reinterpret_cast<T *>(_inline);
+			_capacity = InlineCapacity;
+		}
+		steal(other);
+		return *this;
+	}
 
 	/**
 	 * Returns whether or not the stack is empty.
 	 *
 	 * @return true if the stack is empty, false if it is not.
 	 */
-	bool empty() const { return _stack.empty(); }
+	bool empty() const { return _size == 0; }
+
+	/**
+	 * Exchange the contents of this stack with those of another, only moving items that are stored inline.
+	 *
+	 * @param other The stack to exchange contents with.
+	 */
+	void swap(Stack &other) {
+		if (this == &other)
+			return;
+		if (!isInline() && !other.isInline()) {
+			std::swap(_items, other._items);
+			std::swap(_size, other._size);
+			std::swap(_capacity, other._capacity);
+			return;
+		}
+		Stack tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+	}
 
 	/**
 	 * Push an item onto the stack.
 	 *
 	 * @param item The item to push.
 	 */
-	void push(const T &item) { _stack.push_front(item); }
+	void push(const T &item) {
+		if (_size == _capacity) {
+			// item may be on this stack, so copy it before the items move
+			T copy(item);
+			reserve(_size + 1);
+			new (&_items[_size]) T(std::move(copy));
+		} else {
+			new (&_items[_size]) T(item);
+		}
+		_size++;
+	}
 
 	/**
 	 * Pop an item from the stack and return it.
@@ -54,8 +207,8 @@ public:
 	 * @return The value popped from the stack.
 	 */
 	T pop() {
-		T retval = _stack.front();
-		_stack.pop_front();
+		T retval(std::move(_items[_size - 1]));
+		_items[--_size].~T();
 		return retval;
 	}
 
@@ -64,14 +217,14 @@ public:
 	 *
 	 * @return The topmost item on the stack.
 	 */
-	T &peek() { return _stack.front(); }
+	T &peek() { return _items[_size - 1]; }
 
 	/**
 	 * Return the topmost item on the stack without removing it.
 	 *
 	 * @return The topmost item on the stack.
 	 */
-	const T &peek() const { return _stack.front(); }
+	const T &peek() const { return _items[_size - 1]; }
 
 	/**
 	 * Return the item on the specificed stack position without removing it.
@@ -79,11 +232,7 @@ public:
 	 * @param pos The number of items to skip on the stack.
 	 * @return The desired item from the stack.
 	 */
-	T &peekPos(size_t pos) {
-		if (pos >= _stack.size())
-			std::cerr << "WARNING: Looking outside stack\n";
-		return _stack.at(pos);
-	}
+	T &peekPos(size_t pos) { return _items[index(pos)]; }
 
 	/**
 	 * Return the item on the specificed stack position without removing it.
@@ -91,11 +240,7 @@ public:
 	 * @param pos The number of items to skip on the stack.
 	 * @return The desired item from the stack.
 	 */
-	const T &peekPos(size_t pos) const {
-		if (pos >= _stack.size())
-			std::cerr << "WARNING: Looking outside stack\n";
-		return _stack.at(pos);
-	}
+	const T &peekPos(size_t pos) const { return _items[index(pos)]; }
 };
 
 #endif
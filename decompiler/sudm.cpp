@@ -3,6 +3,10 @@
 #include "decompiler/ff7_field/ff7_field_disassembler.h"
 #include "decompiler/ff7_field/ff7_field_codegen.h"
 #include "decompiler/control_flow.h"
+#include "decompiler/arena.h"
+#include "decompiler/thread_pool.h"
+#include "decompiler/hash.h"
+#include <algorithm>
 
 namespace SUDM
 {
@@ -25,39 +29,321 @@ namespace SUDM
 
         namespace Field
         {
+            namespace
+            {
+                // Layout of the fixed part of the script section header
+                const size_t kMagicOffset = 0;
+                const size_t kNumEntitiesOffset = 2;
+                const size_t kNumModelsOffset = 3;
+                const size_t kOffsetToStringsOffset = 4;
+                const size_t kNumAkaoOffsetsOffset = 6;
+                const size_t kScaleOffset = 8;
+                const size_t kCreatorOffset = 16;
+                const size_t kNameOffset = 24;
+                const size_t kEntityNamesOffset = 32;
+
+                const unsigned int kMagic = 0x0502;
+                const size_t kNameSize = 8;
+            }
+
+            FieldScriptInfo::FieldScriptInfo(const unsigned char* data, size_t size)
+                : mData(data), mSize(size)
+            {
+                if (mSize < kEntityNamesOffset || ReadU16(kMagicOffset) != kMagic)
+                {
+                    throw FF7ScriptHeaderInvalidException();
+                }
+
+                // The tables follow each other, sized by the counts in the fixed part
+                mEntityNamesOffset = kEntityNamesOffset;
+                mAkaoOffsetsOffset = mEntityNamesOffset + NumEntities() * kNameSize;
+                mEntityScriptsOffset = mAkaoOffsetsOffset + NumAkaoOffsets() * sizeof(uint32_t);
+                if (mSize < HeaderSize())
+                {
+                    throw FF7ScriptHeaderInvalidException();
+                }
+            }
+
+            FieldScriptInfo::FieldScriptInfo(const std::vector<unsigned char>& scriptBytes)
+                : FieldScriptInfo(scriptBytes.data(), scriptBytes.size())
+            {
+
+            }
+
+            float FieldScriptInfo::ScaleFactor() const
+            {
+                // 9 bit fixed point
+                return static_cast<float>(ReadU16(kScaleOffset)) / 512.0f;
+            }
+
+            std::string FieldScriptInfo::Creator() const
+            {
+                return ReadName(kCreatorOffset);
+            }
+
+            std::string FieldScriptInfo::Name() const
+            {
+                return ReadName(kNameOffset);
+            }
+
+            unsigned int FieldScriptInfo::OffsetToStrings() const
+            {
+                return ReadU16(kOffsetToStringsOffset);
+            }
+
+            size_t FieldScriptInfo::HeaderSize() const
+            {
+                return mEntityScriptsOffset + NumEntities() * kScriptsPerEntity * sizeof(uint16_t);
+            }
+
+            unsigned int FieldScriptInfo::NumEntities() const
+            {
+                return mData[kNumEntitiesOffset];
+            }
+
+            unsigned int FieldScriptInfo::NumModels() const
+            {
+                return mData[kNumModelsOffset];
+            }
+
+            std::string FieldScriptInfo::EntityName(unsigned int entity) const
+            {
+                if (entity >= NumEntities())
+                {
+                    throw InternalDecompilerError();
+                }
+                return ReadName(mEntityNamesOffset + entity * kNameSize);
+            }
+
+            unsigned int FieldScriptInfo::NumAkaoOffsets() const
+            {
+                return ReadU16(kNumAkaoOffsetsOffset);
+            }
+
+            unsigned int FieldScriptInfo::AkaoOffset(unsigned int index) const
+            {
+                if (index >= NumAkaoOffsets())
+                {
+                    throw InternalDecompilerError();
+                }
+                return ReadU32(mAkaoOffsetsOffset + index * sizeof(uint32_t));
+            }
+
+            unsigned int FieldScriptInfo::ScriptEntryPoint(unsigned int entity, unsigned int script) const
+            {
+                if (entity >= NumEntities() || script >= kScriptsPerEntity)
+                {
+                    throw InternalDecompilerError();
+                }
+                return ReadU16(mEntityScriptsOffset + (entity * kScriptsPerEntity + script) * sizeof(uint16_t));
+            }
+
+            std::string FieldScriptInfo::ReadName(size_t offset) const
+            {
+                // Names fill all 8 bytes or end at a NUL
+                const char* name = reinterpret_cast<const char*>(mData + offset);
+                return std::string(name, std::find(name, name + kNameSize, '\0'));
+            }
+
+            unsigned int FieldScriptInfo::ReadU16(size_t offset) const
+            {
+                return mData[offset] | (mData[offset + 1] << 8);
+            }
+
+            unsigned int FieldScriptInfo::ReadU32(size_t offset) const
+            {
+                return ReadU16(offset) | (ReadU16(offset + 2) << 16);
+            }
+
             float ScaleFactor(const std::vector<unsigned char>& scriptBytes)
             {
-                // Could be cleaner, but just does enough work to pull out the fields scale
-                IScriptFormatter formatter;
-                ::FF7::FF7FieldEngine engine(formatter, "Unused");
-                InstVec insts;
-                engine.getDisassembler(insts, scriptBytes);
-                return engine.ScaleFactor();
+                return FieldScriptInfo(scriptBytes).ScaleFactor();
             }
 
-            DecompiledScript Decompile(std::string scriptName,
+            static unsigned int ResolveThreads(unsigned int numThreads)
+            {
+                return numThreads == 0 ? ThreadPool::DefaultConcurrency() : numThreads;
+            }
+
+            std::shared_ptr<const CachedFunction> FunctionCache::Find(uint64_t key)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                auto it = mFunctions.find(key);
+                if (it == std::end(mFunctions))
+                {
+                    mMisses++;
+                    return nullptr;
+                }
+                mHits++;
+                return it->second;
+            }
+
+            void FunctionCache::Insert(uint64_t key, std::shared_ptr<const CachedFunction> function)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFunctions[key] = std::move(function);
+            }
+
+            size_t FunctionCache::Size() const
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                return mFunctions.size();
+            }
+
+            size_t FunctionCache::Hits() const
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                return mHits;
+            }
+
+            size_t FunctionCache::Misses() const
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                return mMisses;
+            }
+
+            void FunctionCache::Clear()
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFunctions.clear();
+                mHits = 0;
+                mMisses = 0;
+            }
+
+            // Hash of everything outside a function that its generated Lua can depend on
+            // mode is how the functions are generated, Gotos unless from an analyzed control flow graph
+            static uint64_t FieldContextHash(const ::FF7::FF7FieldEngine& engine, IScriptFormatter& formatter, ControlFlowMode mode)
+            {
+                Fnv1a hash;
+                hash.Add(formatter.Fingerprint());
+                hash.Add(static_cast<uint32_t>(mode));
+                hash.Add(engine.ScriptName());
+                hash.Add(engine.ScaleFactor());
+                hash.Add(engine._outputStackEffect);
+                for (const auto& entity : engine.Entities())
+                {
+                    hash.Add(static_cast<uint64_t>(entity.first));
+                    hash.Add(entity.second.Name());
+                    for (const auto& function : entity.second.Functions())
+                    {
+                        hash.Add(static_cast<uint64_t>(function.first));
+                        hash.Add(function.second);
+                    }
+                }
+                return hash.Value();
+            }
+
+            static uint64_t FunctionHash(uint64_t contextHash, const Function& func, const InstructionStore& store)
+            {
+                Fnv1a hash;
+                hash.Add(contextHash);
+                hash.Add(func._name);
+                hash.Add(func._metadata.str());
+                for (size_t i = func.mFirstInstruction; i < func.mFirstInstruction + func.mNumInstructions; i++)
+                {
+                    hash.Add(store.Opcode(i));
+                    hash.Add(store.Address(i));
+                    for (size_t j = 0; j < store.ParamCount(i); j++)
+                    {
+                        hash.Add(store.Param(i, j).mValue);
+                        hash.Add(store.Param(i, j).mIsSigned);
+                    }
+                }
+                return hash.Value();
+            }
+
+            // Looks every function up in the cache, and only makes Instruction objects for the ones that
+            // missed. The others are left as null, unless they were already made, they are never looked at
+            // as their Lua comes from the cache.
+            static void LookUpFunctions(FunctionCache& cache, const ::FF7::FF7FieldEngine& engine, IScriptFormatter& formatter,
+                ::FF7::FF7Disassembler& disassembler, ControlFlowMode mode, ::FF7::FunctionCacheLookup& lookup)
+            {
+                lookup.mCache = &cache;
+                const uint64_t contextHash = FieldContextHash(engine, formatter, mode);
+                for (const auto& function : engine._functions)
+                {
+                    const Function& func = function.second;
+                    const uint64_t key = FunctionHash(contextHash, func, disassembler.Store());
+                    lookup.mKeys[&func] = key;
+                    auto cached = cache.Find(key);
+                    if (cached)
+                    {
+                        lookup.mHits[&func] = cached;
+                        continue;
+                    }
+                    disassembler.MaterializeFunction(func);
+                }
+            }
+
+            // Steps control flow analysis may take for each instruction of a script in the structured modes.
+            // Real scripts need a handful, the rest are written with gotos.
+            static const size_t kAnalysisStepsPerInstruction = 64;
+
+            // Instructions a script needs for its objects to fill more than the arena's first chunk. Below
+            // that the chunk costs more memory than it saves and as much time.
+            static const size_t kArenaMinInstructions = 64;
+
+            // Generates the script's entities on pool when there is one
+            static DecompiledScript DecompileOnPool(std::string scriptName,
                                   const std::vector<unsigned char>& scriptBytes,
-                                  IScriptFormatter& formatter, 
+                                  IScriptFormatter& formatter,
                                   std::string textToAppend,
-                                  std::string textToPrepend)
+                                  std::string textToPrepend,
+                                  ThreadPool* pool,
+                                  FunctionCache* cache,
+                                  ControlFlowMode mode)
             {
+                // Every instruction, value and group made below dies together when this returns, so
+                // allocate them from one arena rather than individually. Declared first so it outlives them.
+                Arena arena;
+
                 // Disassemble the script
                 ::FF7::FF7FieldEngine engine(formatter, scriptName);
+                engine.SetThreadPool(pool);
                 InstVec insts;
 
                 auto disassembler = engine.getDisassembler(insts, scriptBytes);
-                disassembler->disassemble();
+                auto& fieldDisassembler = static_cast<::FF7::FF7Disassembler&>(*disassembler);
+
+                // Decoding to the store is cheap, Instruction objects are only made for what needs them below
+                fieldDisassembler.DisassembleToStore();
+                Arena::Scope arenaScope(Arena::Enabled() && insts.size() >= kArenaMinInstructions ? &arena : nullptr);
+                if (mode != ControlFlowMode::Gotos || !cache)
+                {
+                    // Analysis needs every function, even those the cache has, and without a cache every
+                    // function is generated
+                    for (const auto& function : engine._functions)
+                    {
+                        fieldDisassembler.MaterializeFunction(function.second);
+                    }
 
-                //disassembler->dumpDisassembly(std::cout);
+                    //disassembler->dumpDisassembly(std::cout);
+                }
 
-                // Create CFG
-                auto controlFlow = std::make_unique<ControlFlow>(insts, engine);
-                controlFlow->createGroups();
+                // Create CFG, the simple code generator only uses it once analyzed, so it isn't made with gotos
+                std::unique_ptr<ControlFlow> controlFlow;
+                if (mode != ControlFlowMode::Gotos)
+                {
+                    controlFlow = std::make_unique<ControlFlow>(insts, engine);
+                    controlFlow->createGroups();
+                }
 
                 // Decompile/analyze
-                //Graph graph = controlFlow->analyze();
-                //engine.postCFG(insts, graph);
-                Graph graph;
+                const Graph noGraph;
+                bool analyzed = false;
+                if (mode != ControlFlowMode::Gotos)
+                {
+                    // Given no graph, the code generator writes every function with gotos
+                    analyzed = engine.AnalyzeControlFlow(*controlFlow, insts, mode, kAnalysisStepsPerInstruction * insts.size());
+                }
+                const Graph& graph = analyzed ? controlFlow->getGraph() : noGraph;
+
+                ::FF7::FunctionCacheLookup lookup;
+                if (cache)
+                {
+                    LookUpFunctions(*cache, engine, formatter, fieldDisassembler, analyzed ? mode : ControlFlowMode::Gotos, lookup);
+                    engine.SetFunctionCache(&lookup);
+                }
 
                 DecompiledScript ds;
 
@@ -69,6 +355,86 @@ namespace SUDM
                 ds.entities = engine.GetEntities();
                 return ds;
             }
+
+            DecompiledScript Decompile(std::string scriptName,
+                                  const std::vector<unsigned char>& scriptBytes,
+                                  IScriptFormatter& formatter, 
+                                  std::string textToAppend,
+                                  std::string textToPrepend,
+                                  unsigned int numThreads,
+                                  FunctionCache* cache,
+                                  ControlFlowMode mode)
+            {
+                numThreads = ResolveThreads(numThreads);
+                if (numThreads == 1)
+                {
+                    return DecompileOnPool(scriptName, scriptBytes, formatter, textToAppend, textToPrepend, nullptr, cache, mode);
+                }
+
+                // The calling thread works too, so it makes up one of the threads
+                ThreadPool pool(numThreads - 1);
+                return DecompileOnPool(scriptName, scriptBytes, formatter, textToAppend, textToPrepend, &pool, cache, mode);
+            }
+
+            // Takes the job's script from diskCache when it has it, otherwise decompiles and adds it
+            static DecompiledScript DecompileThroughDiskCache(const DecompileJob& job, ThreadPool* pool, DiskCache& diskCache)
+            {
+                const uint64_t key = DiskCache::Key(job.scriptName, job.scriptBytes, *job.formatter, job.mode);
+                CachedScript cached;
+                if (diskCache.Find(key, cached))
+                {
+                    // The formatter still needs to hear about the spawn points as if the script was decompiled
+                    for (const auto& sp : cached.spawnPoints)
+                    {
+                        job.formatter->AddSpawnPoint(sp.targetMapId, sp.entity, sp.funcName, sp.address, sp.x, sp.y, sp.triangleId, sp.angle);
+                    }
+                }
+                else
+                {
+                    // Text to prepend and append is left out so jobs that only differ by it share an entry
+                    ::FF7::SpawnPointRecorder recorder(*job.formatter);
+                    cached.script = DecompileOnPool(job.scriptName, job.scriptBytes, recorder, "", "", pool, job.cache, job.mode);
+                    cached.spawnPoints = recorder.TakeSpawnPoints();
+                    diskCache.Insert(key, cached);
+                }
+
+                DecompiledScript ds = std::move(cached.script);
+                ds.luaScript = job.textToPrepend + ds.luaScript + job.textToAppend;
+                return ds;
+            }
+
+            std::vector<DecompiledScript> DecompileBatch(const std::vector<DecompileJob>& jobs, unsigned int numThreads, DiskCache* diskCache)
+            {
+                numThreads = ResolveThreads(numThreads);
+
+                // Each job writes only its own result slot, so the results need no locking
+                std::vector<DecompiledScript> results(jobs.size());
+                std::vector<std::function<void()>> tasks;
+                tasks.reserve(jobs.size());
+
+                // The calling thread works too, so it makes up one of the threads. Jobs hand their
+                // entities to the same pool, so there is work for more threads than jobs.
+                ThreadPool pool(numThreads - 1);
+                ThreadPool* jobPool = &pool;
+                for (size_t i = 0; i < jobs.size(); i++)
+                {
+                    tasks.push_back([&jobs, &results, jobPool, diskCache, i]()
+                    {
+                        const DecompileJob& job = jobs[i];
+                        if (diskCache)
+                        {
+                            results[i] = DecompileThroughDiskCache(job, jobPool, *diskCache);
+                        }
+                        else
+                        {
+                            results[i] = DecompileOnPool(job.scriptName, job.scriptBytes, *job.formatter, job.textToAppend, job.textToPrepend, jobPool, job.cache, job.mode);
+                        }
+                    });
+                }
+
+                pool.Run(tasks);
+                return results;
+            }
         }
     }
 
@@ -1,12 +1,26 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include "unknown_opcode_exception.h"
 
+class MappedFile;
+
 namespace SUDM
 {
+    // Callbacks used while decompiling to name things and report what was found.
+    //
+    // Thread safety: Decompile with one thread calls the formatter only from the thread that
+    // called it. With more threads, and in DecompileBatch, a job's formatter is called from
+    // whichever threads generate that job's entities, one call at a time, and calls for
+    // different entities can interleave. A formatter shared by several jobs in a batch can
+    // therefore be called from several threads at once and must be thread safe, for example
+    // by wrapping it in a SynchronizedScriptFormatter.
     class IScriptFormatter
     {
     public:
@@ -41,6 +55,87 @@ namespace SUDM
 
         // Sets the header comment for a function in an entity, can return empty
         virtual std::string FunctionComment(const std::string& /*entity*/, const std::string& /*funcName*/)  { return ""; }
+
+        // Identifies everything the other methods' results depend on, such as a version and the
+        // name tables in use. Cached output is only reused for a formatter with the same fingerprint,
+        // so it must change whenever the formatter would name anything differently.
+        virtual std::string Fingerprint() { return ""; }
+    };
+
+    // Forwards every call to another formatter while holding a lock, so a formatter that isn't
+    // thread safe can be shared by all the jobs of a batch
+    class SynchronizedScriptFormatter : public IScriptFormatter
+    {
+    public:
+        explicit SynchronizedScriptFormatter(IScriptFormatter& formatter)
+            : mFormatter(formatter)
+        {
+
+        }
+
+        virtual void AddSpawnPoint(unsigned int targetMapId, const std::string& entity, const std::string& funcName, unsigned int address, int x, int y, int triangleId, int angle) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFormatter.AddSpawnPoint(targetMapId, entity, funcName, address, x, y, triangleId, angle);
+        }
+
+        virtual std::string SpawnPointName(unsigned int targetMapId, const std::string& entity, const std::string& funcName, unsigned int address) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.SpawnPointName(targetMapId, entity, funcName, address);
+        }
+
+        virtual std::string MapName(unsigned int mapId) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.MapName(mapId);
+        }
+
+        virtual std::string VarName(unsigned int bank, unsigned int addr) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.VarName(bank, addr);
+        }
+
+        virtual std::string EntityName(const std::string& entity) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.EntityName(entity);
+        }
+
+        virtual std::string AnimationName(int charId, int id) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.AnimationName(charId, id);
+        }
+
+        virtual std::string CharName(int charId) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.CharName(charId);
+        }
+
+        virtual std::string FunctionName(const std::string& entity, const std::string& funcName) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.FunctionName(entity, funcName);
+        }
+
+        virtual std::string FunctionComment(const std::string& entity, const std::string& funcName) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.FunctionComment(entity, funcName);
+        }
+
+        virtual std::string Fingerprint() override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mFormatter.Fingerprint();
+        }
+
+    private:
+        IScriptFormatter& mFormatter;
+        std::mutex mMutex;
     };
 
     namespace FF7
@@ -56,8 +151,130 @@ namespace SUDM
                 std::map<std::string, int> entities;
             };
 
+            // Reads the header of a field's script section in place, without copying the script or
+            // disassembling it, for callers that only want to know what a field contains.
+            // The bytes must outlive the FieldScriptInfo. Nothing is allocated, other than names
+            // being copied in to std::strings short enough to be stored inline.
+            class FieldScriptInfo
+            {
+            public:
+                static const unsigned int kScriptsPerEntity = 32;
+
+                // Throws ::FF7ScriptHeaderInvalidException if the magic is wrong or the header is truncated
+                FieldScriptInfo(const unsigned char* data, size_t size);
+                explicit FieldScriptInfo(const std::vector<unsigned char>& scriptBytes);
+
+                // Scale of the field for movement and talk distances
+                float ScaleFactor() const;
+
+                // Creator and name of the field, up to 8 characters each and never shown in game
+                std::string Creator() const;
+                std::string Name() const;
+
+                // Offset of the string table that follows the scripts, relative to the section start
+                unsigned int OffsetToStrings() const;
+
+                // Size of the header including its tables, the scripts start after it
+                size_t HeaderSize() const;
+
+                unsigned int NumEntities() const;
+                unsigned int NumModels() const;
+
+                // Name of an entity, up to 8 characters
+                std::string EntityName(unsigned int entity) const;
+
+                unsigned int NumAkaoOffsets() const;
+                unsigned int AkaoOffset(unsigned int index) const;
+
+                // Entry point of one of an entity's kScriptsPerEntity scripts, relative to the section start
+                unsigned int ScriptEntryPoint(unsigned int entity, unsigned int script) const;
+
+            private:
+                std::string ReadName(size_t offset) const;
+                unsigned int ReadU16(size_t offset) const;
+                unsigned int ReadU32(size_t offset) const;
+
+                const unsigned char* mData;
+                size_t mSize;
+                size_t mEntityNamesOffset;
+                size_t mAkaoOffsetsOffset;
+                size_t mEntityScriptsOffset;
+            };
+
+            // Same as FieldScriptInfo(scriptBytes).ScaleFactor()
             float ScaleFactor(const std::vector<unsigned char>& scriptBytes);
 
+            // The Lua generated for one function, as kept by a FunctionCache
+            struct CachedFunction
+            {
+                struct Line
+                {
+                    std::string text;
+                    bool unindentBefore;
+                    bool indentAfter;
+                };
+
+                // Arguments of an IScriptFormatter::AddSpawnPoint call made while generating the function
+                struct SpawnPoint
+                {
+                    unsigned int targetMapId;
+                    std::string entity;
+                    std::string funcName;
+                    unsigned int address;
+                    int x;
+                    int y;
+                    int triangleId;
+                    int angle;
+                };
+
+                std::vector<Line> lines;
+                std::vector<SpawnPoint> spawnPoints;
+            };
+
+            // Remembers the Lua generated for each function decompiled with it. The key hashes the
+            // function's instructions and addresses, its name and entity, the names of every entity
+            // and function in the field, the field's scale, the ControlFlowMode and the
+            // formatter's Fingerprint. Decompiling an edited field again with the same cache only
+            // generates the functions whose key changed, the rest are spliced in and their spawn points
+            // passed to the formatter again.
+            // Thread safe, so one cache can serve every job of a DecompileBatch.
+            class FunctionCache
+            {
+            public:
+                // Returns null, and counts a miss, if the key isn't cached
+                std::shared_ptr<const CachedFunction> Find(uint64_t key);
+                void Insert(uint64_t key, std::shared_ptr<const CachedFunction> function);
+
+                size_t Size() const;
+                size_t Hits() const;
+                size_t Misses() const;
+                void Clear();
+
+            private:
+                mutable std::mutex mMutex;
+                std::unordered_map<uint64_t, std::shared_ptr<const CachedFunction>> mFunctions;
+                size_t mHits = 0;
+                size_t mMisses = 0;
+            };
+
+            // How the Lua of each function is laid out
+            enum class ControlFlowMode
+            {
+                // Every jump is a goto or an if around the code it skips, which works for any script
+                Gotos,
+
+                // Loops and if/else chains found by control flow analysis are written as while, repeat
+                // and if blocks. Functions that can't be written that way, and every function of scripts
+                // too tangled to analyze within a budget linear in their size, are written with gotos.
+                Structured,
+
+                // As Structured, with loops and elses found from the script's dominator tree. That is slower
+                // than Structured on the small, shallow scripts fields are made of, but stays close to linear
+                // in size however deeply a script nests, so only pick it for large, deeply nested scripts that
+                // Structured runs out of budget on. It has the same budget and falls back to gotos the same way.
+                StructuredByDominators
+            };
+
             /*
             * Throws ::InternalDecompilerError on failure.
             * scriptName - name of the script to be converted, should match file name.
@@ -65,13 +282,102 @@ namespace SUDM
             * formatter - used to rename variables, drop functions etc.
             * textToAppend - raw text that is glued on to the end of the decompiled output.
             * textToPrepend - raw text that is glued to to the start of the decompiled output.
+            * numThreads - total threads to generate the script's entities on including the caller,
+            * 0 for one per hardware thread. The output is the same whatever the number.
+            * cache - optional, reuses the Lua of functions that haven't changed since an earlier call.
+            * mode - how control flow is written.
             * returns a string containing [textToPrepend] [decompiled script] [textToAppend]
             */
             DecompiledScript Decompile(std::string scriptName,
                 const std::vector<unsigned char>& scriptBytes,
                 IScriptFormatter& formatter,
                 std::string textToAppend = "",
-                std::string textToPrepend = "");
+                std::string textToPrepend = "",
+                unsigned int numThreads = 1,
+                FunctionCache* cache = nullptr,
+                ControlFlowMode mode = ControlFlowMode::Gotos);
+
+            // The arguments of one Decompile call
+            struct DecompileJob
+            {
+                std::string scriptName;
+                std::vector<unsigned char> scriptBytes;
+                IScriptFormatter* formatter;
+                std::string textToAppend;
+                std::string textToPrepend;
+                FunctionCache* cache; // Can be null, or shared between jobs
+                ControlFlowMode mode; // Gotos when left out of an initializer list
+            };
+
+            class DiskCache;
+
+            /*
+            * Decompiles many scripts at once on a work stealing thread pool, which also shares out
+            * the entities of each script, see IScriptFormatter for the rules on calling formatters
+            * from several threads.
+            * jobs - the scripts to decompile.
+            * numThreads - total threads to use including the caller, 0 for one per hardware thread.
+            * returns one DecompiledScript per job, in the same order as jobs.
+            * diskCache - optional, results are taken from it when they can be and added to it when not.
+            * Throws the exception from the first failing job (in job order) once all have finished.
+            */
+            std::vector<DecompiledScript> DecompileBatch(const std::vector<DecompileJob>& jobs, unsigned int numThreads = 0, DiskCache* diskCache = nullptr);
+
+            // A decompiled script as kept by a DiskCache, without any text to prepend or append, and
+            // with the spawn points to give the formatter when it is used
+            struct CachedScript
+            {
+                DecompiledScript script;
+                std::vector<CachedFunction::SpawnPoint> spawnPoints;
+            };
+
+            // Keeps decompiled scripts in a file between runs, so an asset build only decompiles the
+            // fields that changed. Entries are keyed by Key, which hashes the script's name and bytes,
+            // the control flow mode, the SUDM version and the formatter's Fingerprint.
+            //
+            // The file is a header, the entries, then an index sorted by key. It is memory mapped and
+            // searched in place, so opening a large cache costs nothing until entries are looked up.
+            // New entries are kept in memory until Save, which writes the old and new entries to a
+            // new file and then replaces the old one. A missing, damaged or outdated file is treated
+            // as an empty cache and replaced on Save. Thread safe.
+            class DiskCache
+            {
+            public:
+                explicit DiskCache(const std::string& fileName);
+                ~DiskCache(); // Saves, ignoring failures
+                DiskCache(const DiskCache&) = delete;
+                DiskCache& operator = (const DiskCache&) = delete;
+
+                static uint64_t Key(const std::string& scriptName, const std::vector<unsigned char>& scriptBytes, IScriptFormatter& formatter,
+                    ControlFlowMode mode = ControlFlowMode::Gotos);
+
+                // Counts a hit or a miss
+                bool Find(uint64_t key, CachedScript& script);
+                void Insert(uint64_t key, const CachedScript& script);
+
+                // Throws std::runtime_error if the file can't be written
+                void Save();
+
+                size_t Size() const;
+                size_t Hits() const;
+                size_t Misses() const;
+
+                // One line summary of the hit rate, for the end of a build
+                std::string Report() const;
+
+            private:
+                void Open();
+                bool FindSaved(uint64_t key, size_t& offset, size_t& size) const;
+
+                const std::string mFileName;
+                mutable std::mutex mMutex;
+                std::unique_ptr<MappedFile> mFile;
+                size_t mSavedCount = 0;
+                size_t mIndexOffset = 0;
+                std::map<uint64_t, std::vector<unsigned char>> mUnsaved; // Entries already in file form
+                size_t mHits = 0;
+                size_t mMisses = 0;
+            };
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "symbol.h"
+#include <mutex>
+#include <unordered_set>
+
+namespace
+{
+    // Node based, so the address of each string is stable for the life of the program
+    struct SymbolTable
+    {
+        std::mutex mMutex;
+        std::unordered_set<std::string> mStrings;
+    };
+
+    SymbolTable& Table()
+    {
+        static SymbolTable table;
+        return table;
+    }
+}
+
+const std::string* Symbol::Intern(const std::string& str)
+{
+    if (str.empty())
+    {
+        return &Empty();
+    }
+    SymbolTable& table = Table();
+    std::lock_guard<std::mutex> lock(table.mMutex);
+    return &*table.mStrings.insert(str).first;
+}
+
+const std::string& Symbol::Empty()
+{
+    static const std::string empty;
+    return empty;
+}
+
+size_t Symbol::TableSize()
+{
+    SymbolTable& table = Table();
+    std::lock_guard<std::mutex> lock(table.mMutex);
+    return table.mStrings.size();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+
+/**
+ * A handle to a string in the process wide symbol table. Each distinct string is stored once,
+ * so a Symbol is a single pointer, copying one never allocates and comparing two Symbols
+ * is a pointer comparison.
+ *
+ * Interning takes a lock and a hash lookup, so code that creates the same symbol repeatedly
+ * (such as an opcode's mnemonic) should create it once and copy it.
+ */
+class Symbol
+{
+public:
+    Symbol()
+        : mStr(&Empty())
+    {
+
+    }
+
+    Symbol(const char* str)
+        : mStr(Intern(std::string(str)))
+    {
+
+    }
+
+    Symbol(const std::string& str)
+        : mStr(Intern(str))
+    {
+
+    }
+
+    const std::string& str() const
+    {
+        return *mStr;
+    }
+
+    operator const std::string&() const
+    {
+        return *mStr;
+    }
+
+    const char* c_str() const
+    {
+        return mStr->c_str();
+    }
+
+    bool empty() const
+    {
+        return mStr->empty();
+    }
+
+    friend bool operator == (const Symbol& lhs, const Symbol& rhs) { return lhs.mStr == rhs.mStr; }
+    friend bool operator != (const Symbol& lhs, const Symbol& rhs) { return lhs.mStr != rhs.mStr; }
+    friend bool operator == (const Symbol& lhs, const char* rhs) { return *lhs.mStr == rhs; }
+    friend bool operator != (const Symbol& lhs, const char* rhs) { return *lhs.mStr != rhs; }
+    friend bool operator == (const char* lhs, const Symbol& rhs) { return lhs == *rhs.mStr; }
+    friend bool operator != (const char* lhs, const Symbol& rhs) { return lhs != *rhs.mStr; }
+    friend bool operator == (const Symbol& lhs, const std::string& rhs) { return *lhs.mStr == rhs; }
+    friend bool operator != (const Symbol& lhs, const std::string& rhs) { return *lhs.mStr != rhs; }
+    friend bool operator == (const std::string& lhs, const Symbol& rhs) { return lhs == *rhs.mStr; }
+    friend bool operator != (const std::string& lhs, const Symbol& rhs) { return lhs != *rhs.mStr; }
+
+    friend std::ostream& operator << (std::ostream& output, const Symbol& symbol)
+    {
+        return output << *symbol.mStr;
+    }
+
+    // Number of distinct strings interned so far
+    static size_t TableSize();
+
+private:
+    static const std::string* Intern(const std::string& str);
+    static const std::string& Empty();
+
+    const std::string* mStr;
+};
+
+namespace std
+{
+    template<>
+    struct hash<Symbol>
+    {
+        size_t operator()(const Symbol& symbol) const
+        {
+            return hash<const std::string*>()(&symbol.str());
+        }
+    };
+}
@@ -21,13 +21,16 @@
 
 #include "decompiler/control_flow.h"
 #include "decompiler/decompiler_disassembler.h"
+#include "decompiler/dominators.h"
 #include "decompiler/graph.h"
 #include "decompiler/scummv6/engine.h"
 #include <gmock/gmock.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include "make_unique.h"
 
-#define GET(vertex) (boost::get(boost::vertex_name, g, vertex))
+#define GET(vertex) (get(boost::vertex_name, g, vertex))
 
 
 TEST(CFG, testUnreachable) {
@@ -38,22 +41,22 @@ TEST(CFG, testUnreachable) {
     d->disassemble();
     ControlFlow *c = new ControlFlow(insts, *engine);
     Graph g = c->getGraph();
-    ASSERT_TRUE(boost::num_vertices(g) == 4);
-    VertexRange range = boost::vertices(g);
+    ASSERT_TRUE(num_vertices(g) == 4);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         switch ((*gr->_start)->_address) {
         case 0:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 0 && boost::out_degree(*it, g) == 1);
+            ASSERT_TRUE(in_degree(*it, g) == 0 && out_degree(*it, g) == 1);
             break;
         case 2:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 1 && boost::out_degree(*it, g) == 1);
+            ASSERT_TRUE(in_degree(*it, g) == 1 && out_degree(*it, g) == 1);
             break;
         case 5:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 0 && boost::out_degree(*it, g) == 1);
+            ASSERT_TRUE(in_degree(*it, g) == 0 && out_degree(*it, g) == 1);
             break;
         case 6:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 2 && boost::out_degree(*it, g) == 0);
+            ASSERT_TRUE(in_degree(*it, g) == 2 && out_degree(*it, g) == 0);
             break;
         default:
             ASSERT_TRUE(false);
@@ -72,22 +75,22 @@ TEST(CFG, testBranching) {
 
     ControlFlow *c = new ControlFlow(insts, *engine);
     Graph g = c->getGraph();
-    ASSERT_TRUE(boost::num_vertices(g) == 4);
-    VertexRange range = boost::vertices(g);
+    ASSERT_TRUE(num_vertices(g) == 4);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         switch ((*gr->_start)->_address) {
         case 0:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 0 && boost::out_degree(*it, g) == 1);
+            ASSERT_TRUE(in_degree(*it, g) == 0 && out_degree(*it, g) == 1);
             break;
         case 2:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 1 && boost::out_degree(*it, g) == 2);
+            ASSERT_TRUE(in_degree(*it, g) == 1 && out_degree(*it, g) == 2);
             break;
         case 5:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 1 && boost::out_degree(*it, g) == 1);
+            ASSERT_TRUE(in_degree(*it, g) == 1 && out_degree(*it, g) == 1);
             break;
         case 6:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 2 && boost::out_degree(*it, g) == 0);
+            ASSERT_TRUE(in_degree(*it, g) == 2 && out_degree(*it, g) == 0);
             break;
         default:
             ASSERT_TRUE(false);
@@ -107,20 +110,20 @@ TEST(CFG, testGrouping) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->getGraph();
-    ASSERT_TRUE(boost::num_vertices(g) == 3);
-    VertexRange range = boost::vertices(g);
+    ASSERT_TRUE(num_vertices(g) == 3);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         switch ((*gr->_start)->_address) {
         case 0:
             ASSERT_TRUE((*gr->_end)->_address == 2);
-            ASSERT_TRUE(boost::in_degree(*it, g) == 0 && boost::out_degree(*it, g) == 2);
+            ASSERT_TRUE(in_degree(*it, g) == 0 && out_degree(*it, g) == 2);
             break;
         case 5:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 1 && boost::out_degree(*it, g) == 1);
+            ASSERT_TRUE(in_degree(*it, g) == 1 && out_degree(*it, g) == 1);
             break;
         case 6:
-            ASSERT_TRUE(boost::in_degree(*it, g) == 2 && boost::out_degree(*it, g) == 0);
+            ASSERT_TRUE(in_degree(*it, g) == 2 && out_degree(*it, g) == 0);
             break;
         default:
             ASSERT_TRUE(false);
@@ -139,7 +142,7 @@ TEST(CFG, DISABLED_testShortCircuitDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->getGraph();
-    ASSERT_TRUE(boost::num_vertices(g) == 3);
+    ASSERT_TRUE(num_vertices(g) == 3);
 }
 
 TEST(CFG, testWhileDetection) {
@@ -151,7 +154,7 @@ TEST(CFG, testWhileDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0)
@@ -169,7 +172,7 @@ TEST(CFG, testDoWhileDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 3)
@@ -186,7 +189,7 @@ TEST(CFG, testBreakDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x14)
@@ -203,7 +206,7 @@ TEST(CFG, testBreakDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0xA)
@@ -218,7 +221,7 @@ TEST(CFG, testBreakDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0xD)
@@ -236,7 +239,7 @@ TEST(CFG, testContinueDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x14)
@@ -254,7 +257,7 @@ TEST(CFG, testContinueDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0xA)
@@ -269,7 +272,7 @@ TEST(CFG, testContinueDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0xD)
@@ -286,7 +289,7 @@ TEST(CFG, testIfDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -302,7 +305,7 @@ TEST(CFG, testIfDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -317,7 +320,7 @@ TEST(CFG, testIfDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x3)
@@ -333,7 +336,7 @@ TEST(CFG, testIfDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -348,7 +351,7 @@ TEST(CFG, testIfDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x3)
@@ -365,7 +368,7 @@ TEST(CFG, testElseDetection) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x10) {
@@ -383,7 +386,7 @@ TEST(CFG, testElseDetection) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -401,7 +404,7 @@ TEST(CFG, testNestedLoops) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -419,7 +422,7 @@ TEST(CFG, testNestedLoops) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x6)
@@ -436,7 +439,7 @@ TEST(CFG, testNestedLoops) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -453,7 +456,7 @@ TEST(CFG, testNestedLoops) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -470,7 +473,7 @@ TEST(CFG, testNestedLoops) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x0)
@@ -488,7 +491,7 @@ TEST(CFG, testNestedLoops) {
     c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     g = c->analyze();
-    range = boost::vertices(g);
+    range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         if ((*gr->_start)->_address == 0x3)
@@ -510,7 +513,7 @@ TEST(CFG, DISABLED_testSamAndMaxScript30) {
     auto c = std::make_unique<ControlFlow>(insts, *engine);
     c->createGroups();
     Graph g = c->analyze();
-    VertexRange range = boost::vertices(g);
+    VertexRange range = vertices(g);
     for (VertexIterator it = range.first; it != range.second; ++it) {
         GroupPtr gr = GET(*it);
         switch ((*gr->_start)->_address) {
@@ -553,3 +556,187 @@ TEST(CFG, DISABLED_testSamAndMaxScript30) {
         }
     }
 }
+
+namespace {
+
+// Everything analysis decides about a group, and its edges, by address so graphs of different types compare
+struct GroupSummary {
+    uint32 _start;
+    uint32 _end;
+    int _stackLevel;
+    GroupType _type;
+    bool _startElse;
+    std::vector<std::pair<uint32, bool> > _outEdges;
+    std::vector<uint32> _inEdges;
+    std::vector<uint32> _endElse;
+
+    bool operator==(const GroupSummary &rhs) const {
+        return _start == rhs._start && _end == rhs._end && _stackLevel == rhs._stackLevel && _type == rhs._type &&
+            _startElse == rhs._startElse && _outEdges == rhs._outEdges && _inEdges == rhs._inEdges && _endElse == rhs._endElse;
+    }
+};
+
+template <class TGraph>
+std::vector<GroupSummary> summarize(const TGraph &g) {
+    std::vector<GroupSummary> summary;
+    for (auto v = vertices(g).first; v != vertices(g).second; ++v) {
+        GroupPtr gr = get(boost::vertex_name, g, *v);
+        GroupSummary s = { (*gr->_start)->_address, (*gr->_end)->_address, gr->_stackLevel, gr->_type, gr->_startElse };
+        for (auto e = out_edges(*v, g).first; e != out_edges(*v, g).second; ++e)
+            s._outEdges.push_back(std::make_pair((*get(boost::vertex_name, g, target(*e, g))->_start)->_address, get(boost::edge_attribute, g, *e)._isJump));
+        for (auto e = in_edges(*v, g).first; e != in_edges(*v, g).second; ++e)
+            s._inEdges.push_back((*get(boost::vertex_name, g, source(*e, g))->_start)->_address);
+        std::sort(s._outEdges.begin(), s._outEdges.end());
+        std::sort(s._inEdges.begin(), s._inEdges.end());
+        for (auto it = gr->_endElse.begin(); it != gr->_endElse.end(); ++it)
+            s._endElse.push_back((*(*it)->_start)->_address);
+        summary.push_back(s);
+    }
+    std::sort(summary.begin(), summary.end(), [](const GroupSummary &a, const GroupSummary &b) { return a._start < b._start; });
+    return summary;
+}
+
+}
+
+TEST(CFG, testFlatGraphMatchesBoostGraph) {
+    const char *scripts[] = { "branches", "break-do-while", "break-do-while2", "break-while", "continue-do-while", "continue-do-while2",
+        "continue-while", "do-while-in-while", "do-while", "if-else", "if-no-else", "if", "nested-do-while", "nested-while",
+        "nested-while2", "short-circuit", "unreachable", "while-in-do-while", "while-in-do-while2", "while" };
+    for (const char *script : scripts) {
+        InstVec insts;
+        auto engine = std::make_unique<Scumm::v6::Scummv6Engine>();
+        auto d = engine->getDisassembler(insts);
+        d->open((std::string("decompiler/test/") + script + ".dmp").c_str());
+        d->disassemble();
+
+        BasicControlFlow<BoostGraph> boostFlow(insts, *engine);
+        ControlFlow flatFlow(insts, *engine);
+        ASSERT_TRUE(summarize(boostFlow.getGraph()) == summarize(flatFlow.getGraph())) << script;
+
+        boostFlow.createGroups();
+        flatFlow.createGroups();
+        ASSERT_TRUE(summarize(boostFlow.getGraph()) == summarize(flatFlow.getGraph())) << script;
+
+        auto boostAnalyzed = summarize(boostFlow.analyze());
+        auto flatAnalyzed = summarize(flatFlow.analyze());
+        ASSERT_TRUE(boostAnalyzed == flatAnalyzed) << script;
+    }
+}
+
+TEST(CFG, testDominatorAnalysisMatchesAnalyze) {
+    const char *scripts[] = { "branches", "break-do-while", "break-do-while2", "break-while", "continue-do-while", "continue-do-while2",
+        "continue-while", "do-while-in-while", "do-while", "if-else", "if-no-else", "if", "nested-do-while", "nested-while",
+        "nested-while2", "short-circuit", "unreachable", "while-in-do-while", "while-in-do-while2", "while" };
+    for (const char *script : scripts) {
+        InstVec insts;
+        auto engine = std::make_unique<Scumm::v6::Scummv6Engine>();
+        auto d = engine->getDisassembler(insts);
+        d->open((std::string("decompiler/test/") + script + ".dmp").c_str());
+        d->disassemble();
+
+        ControlFlow walked(insts, *engine);
+        walked.createGroups();
+        ControlFlow dominated(insts, *engine);
+        dominated.createGroups();
+        auto expected = summarize(walked.analyze());
+        ASSERT_TRUE(summarize(dominated.analyzeWithDominators()) == expected) << script;
+
+        BasicControlFlow<BoostGraph> boostFlow(insts, *engine);
+        boostFlow.createGroups();
+        ASSERT_TRUE(summarize(boostFlow.analyzeWithDominators()) == expected) << script;
+    }
+}
+
+TEST(CFG, testDominatorTree) {
+    // 0 -> 1 -> 2 -> 3 -> 1 is a loop with 2 -> 2 nested in it, 4 <-> 5 is entered at both ends
+    // from 3 and 0 so isn't one, and 6 is only reached as a root of its own
+    const std::vector<std::vector<uint32_t> > edges = { { 1, 4 }, { 2 }, { 2, 3 }, { 1, 5 }, { 5 }, { 4 }, { 0 } };
+    std::vector<uint32_t> succBegin(1, 0), succs;
+    for (const auto &out : edges) {
+        succs.insert(succs.end(), out.begin(), out.end());
+        succBegin.push_back(static_cast<uint32_t>(succs.size()));
+    }
+    DominatorTree dom(succBegin, succs, { 0 });
+
+    const uint32_t kNone = DominatorTree::kNone;
+    ASSERT_EQ((std::vector<uint32_t>{ kNone, 0, 1, 2, 0, 0, kNone }),
+        (std::vector<uint32_t>{ dom.IDom(0), dom.IDom(1), dom.IDom(2), dom.IDom(3), dom.IDom(4), dom.IDom(5), dom.IDom(6) }));
+    ASSERT_TRUE(dom.Dominates(1, 3));
+    ASSERT_TRUE(dom.Dominates(3, 3));
+    ASSERT_FALSE(dom.Dominates(3, 1));
+    ASSERT_FALSE(dom.Dominates(4, 5));
+    ASSERT_FALSE(dom.Dominates(0, 6));
+
+    ASSERT_EQ((std::vector<uint32_t>{ kNone, 1, 2, 1, kNone, kNone, kNone }),
+        (std::vector<uint32_t>{ dom.LoopHeader(0), dom.LoopHeader(1), dom.LoopHeader(2), dom.LoopHeader(3), dom.LoopHeader(4), dom.LoopHeader(5), dom.LoopHeader(6) }));
+    ASSERT_EQ(dom.ParentLoop(2), 1u);
+    ASSERT_EQ(dom.ParentLoop(1), kNone);
+}
+
+TEST(CFG, testFlatGraphContract) {
+    typedef FlatGraph<int, IsJump> TestGraph;
+    TestGraph g;
+    for (int i = 0; i < 5; i++)
+        put(boost::vertex_name, g, add_vertex(g), i * 10);
+
+    // 0 -> 1 only, so 1's edges are handed straight to 0
+    put(boost::edge_attribute, g, add_edge(0, 1, g).first, IsJump(false));
+    put(boost::edge_attribute, g, add_edge(1, 2, g).first, IsJump(true));
+    put(boost::edge_attribute, g, add_edge(1, 3, g).first, IsJump(false));
+    ASSERT_FALSE(add_edge(1, 3, g).second);
+    contract(0, 1, g);
+    ASSERT_EQ(num_vertices(g), 4u);
+    ASSERT_EQ(out_degree(0, g), 2u);
+    ASSERT_EQ(target(*out_edges(0, g).first, g), 2u);
+    ASSERT_TRUE(get(boost::edge_attribute, g, *out_edges(0, g).first)._isJump);
+    ASSERT_EQ(source(*in_edges(3, g).first, g), 0u);
+    ASSERT_EQ(in_degree(2, g), 1u);
+
+    // 2 also has an edge from 4, which goes with it, and an edge to 3 that replaces 0's
+    put(boost::edge_attribute, g, add_edge(4, 2, g).first, IsJump(false));
+    put(boost::edge_attribute, g, add_edge(2, 3, g).first, IsJump(true));
+    put(boost::edge_attribute, g, add_edge(2, 2, g).first, IsJump(true));
+    contract(0, 2, g);
+    ASSERT_EQ(num_vertices(g), 3u);
+    ASSERT_EQ(out_degree(0, g), 1u);
+    ASSERT_EQ(target(*out_edges(0, g).first, g), 3u);
+    ASSERT_TRUE(get(boost::edge_attribute, g, *out_edges(0, g).first)._isJump);
+    ASSERT_EQ(out_degree(4, g), 0u);
+    ASSERT_EQ(in_degree(3, g), 1u);
+
+    std::vector<TestGraph::vertex_descriptor> remaining(vertices(g).first, vertices(g).second);
+    ASSERT_EQ(remaining, (std::vector<TestGraph::vertex_descriptor>{ 0, 3, 4 }));
+    ASSERT_EQ(get(boost::vertex_name, g, 4), 40);
+}
+
+TEST(CFG, testAnalysisBudget) {
+    InstVec insts;
+    auto engine = std::make_unique<Scumm::v6::Scummv6Engine>();
+    auto d = engine->getDisassembler(insts);
+    d->open("decompiler/test/if-else.dmp");
+    d->disassemble();
+
+    ControlFlow unlimited(insts, *engine);
+    unlimited.createGroups();
+    auto expected = summarize(unlimited.analyze());
+
+    ControlFlow generous(insts, *engine);
+    generous.setAnalysisBudget(64 * insts.size());
+    generous.createGroups();
+    ASSERT_TRUE(summarize(generous.analyze()) == expected);
+
+    ControlFlow starved(insts, *engine);
+    starved.setAnalysisBudget(1);
+    starved.createGroups();
+    ASSERT_THROW(starved.analyze(), AnalysisBudgetExceededException);
+
+    ControlFlow generousDominators(insts, *engine);
+    generousDominators.setAnalysisBudget(64 * insts.size());
+    generousDominators.createGroups();
+    ASSERT_TRUE(summarize(generousDominators.analyzeWithDominators()) == expected);
+
+    ControlFlow starvedDominators(insts, *engine);
+    starvedDominators.setAnalysisBudget(1);
+    starvedDominators.createGroups();
+    ASSERT_THROW(starvedDominators.analyzeWithDominators(), AnalysisBudgetExceededException);
+}
@@ -27,7 +27,7 @@
 #include "decompiler/scummv6/engine.h"
 
 #include <vector>
-#define GET(vertex) (boost::get(boost::vertex_name, g, vertex))
+#define GET(vertex) (get(boost::vertex_name, g, vertex))
 
 #include <streambuf>
 #include <ostream>
@@ -58,7 +58,7 @@ TEST(CodeGen, testContinue) {
     auto cg = engine->getCodeGenerator(insts, ns);
     cg->generate(insts, g);
 
-    VertexIterator v = boost::vertices(g).first;
+    VertexIterator v = vertices(g).first;
     std::vector<std::string> output, expected;
     expected.push_back("do{");
     expected.push_back("if(18 != var321) {");
@@ -97,7 +97,7 @@ TEST(CodeGen, testBreak) {
     auto cg = engine->getCodeGenerator(insts, ns);
     cg->generate(insts, g);
 
-    VertexIterator v = boost::vertices(g).first;
+    VertexIterator v = vertices(g).first;
     std::vector<std::string> output, expected;
     expected.push_back("while (42 != VAR_CHARSET_MASK) {");
     expected.push_back("if (18 != var321) {");
@@ -136,7 +136,7 @@ TEST(CodeGen, testElse) {
     auto cg = engine->getCodeGenerator(insts, ns);
     cg->generate(insts, g);
 
-    VertexIterator v = boost::vertices(g).first;
+    VertexIterator v = vertices(g).first;
     std::vector<std::string> output, expected;
     expected.push_back("if (42 != VAR_CHARSET_MASK) {");
     expected.push_back("VAR_CHARSET_MASK--;");
@@ -178,7 +178,7 @@ TEST(CodeGen, DISABLED_testCoalescing) {
     auto cg = engine->getCodeGenerator(insts, ns);
     cg->generate(insts, g);
 
-    VertexIterator v = boost::vertices(g).first;
+    VertexIterator v = vertices(g).first;
     GroupPtr gr = GET(*v);
     // Find first node
     while (gr->_prev != NULL)
@@ -203,7 +203,7 @@ TEST(CodeGen, DISABLED_testCoalescing) {
     cg = engine->getCodeGenerator(insts, ns);
     cg->generate(insts, g);
 
-    v = boost::vertices(g).first;
+    v = vertices(g).first;
     gr = GET(*v);
     // Find first node
     while (gr->_prev != NULL)
@@ -71,6 +71,25 @@ TEST(Disassembler, testUnknownOpcodeException) {
     }
 }
 
+TEST(Disassembler, testMarkJumpTargets) {
+    InstVec insts;
+    Scumm::v6::Scummv6Disassembler s(insts);
+    s.open("decompiler/test/if-else.dmp");
+    s.disassemble();
+    ASSERT_EQ(insts.size(), 8u);
+
+    // Only the conditional jump lands inside the first seven instructions
+    markJumpTargets(insts.begin(), insts.begin() + 7);
+    for (size_t i = 0; i < insts.size(); i++) {
+        ASSERT_EQ(insts[i]->mCondJumpsIn, i == 6 ? 1 : 0);
+        ASSERT_FALSE(insts[i]->mLabelRequired);
+    }
+
+    markJumpTargets(insts.begin() + 5, insts.end());
+    ASSERT_TRUE(insts[7]->mLabelRequired);
+    ASSERT_EQ(insts[6]->mCondJumpsIn, 1);
+}
+
 // This test requires script-15.dmp from Sam & Max: Hit The Road.
 // 1ab08298c9c8fb4c77953756989c7449 *script-15.dmp
 // Disabled as mentioned file is copyrighted
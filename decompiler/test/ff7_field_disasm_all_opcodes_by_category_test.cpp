@@ -6,7 +6,10 @@
 #include "util.h"
 #include "make_unique.h"
 #include "ff7_field_dummy_formatter.h"
+#include "ff7_field_script_bytes.h"
 #include "lzs.h"
+#include <algorithm>
+#include <cstdio>
 
 #define FLOW_BASE 0
 #define FLOW_LABELS 13
@@ -63,11 +66,7 @@ void checkUncat(const InstVec& insts);
 TEST(FF7Field, BugFixes)
 {
 
-    auto scriptBytes = Lzs::Decompress(BinaryReader::ReadAll("decompiler/test/bug_fixes.dat"));
-
-    // Remove section pointers, leave everything after the script data as this doesn't matter
-    const int kNumSections = 7;
-    scriptBytes.erase(scriptBytes.begin(), scriptBytes.begin() + kNumSections * sizeof(uint32));
+    auto scriptBytes = LoadFieldScript("bug_fixes");
     DummyFormatter formatter;
     SUDM::FF7::Field::DecompiledScript ds = SUDM::FF7::Field::Decompile("bug_fixes", scriptBytes, formatter, "", "EntityContainer = {}\n\n");
     ASSERT_FALSE(ds.luaScript.empty());
@@ -1947,6 +1946,29 @@ void checkUncat(const InstVec& insts)
 
 
 
+TEST(FF7Field, DisassemblerParsesFunctionMetaData)
+{
+    InstVec insts;
+    DummyFormatter formatter;
+    FF7::FF7FieldEngine engine(formatter, "test");
+
+    auto d = engine.getDisassembler(insts);
+    d->open("decompiler/test/ff7_all_opcodes_by_category.dat");
+    d->disassemble();
+
+    ASSERT_FALSE(engine._functions.empty());
+    for (const auto& function : engine._functions)
+    {
+        const Function& func = function.second;
+        ASSERT_TRUE(func.mMetaData != nullptr);
+        const FF7::FunctionMetaData parsed(func._metadata);
+        ASSERT_EQ(func.mMetaData->IsStart(), parsed.IsStart());
+        ASSERT_EQ(func.mMetaData->IsEnd(), parsed.IsEnd());
+        ASSERT_EQ(func.mMetaData->CharacterId(), parsed.CharacterId());
+        ASSERT_EQ(func.mMetaData->EntityName(), parsed.EntityName());
+    }
+}
+
 TEST(FF7Field, Decomp_AllOpcodes)
 //TEST(FF7Field, Decomp_AllOpcodes)
 {
@@ -1957,12 +1979,8 @@ TEST(FF7Field, Decomp_AllOpcodes)
     //std::cout << "ready" << std::endl;
    // std::cin.ignore();
 
-    auto scriptBytes = Lzs::Decompress(BinaryReader::ReadAll("decompiler/test/ff7_all_opcodes_by_category.dat"));
-    //auto scriptBytes = Lzs::Decompress(BinaryReader::ReadAll("decompiler/test/anfrst_1.dat"));
-
-    // Remove section pointers, leave everything after the script data as this doesn't matter
-    const int kNumSections = 7;
-    scriptBytes.erase(scriptBytes.begin(), scriptBytes.begin() + kNumSections * sizeof(uint32));
+    auto scriptBytes = LoadFieldScript("ff7_all_opcodes_by_category");
+    //auto scriptBytes = LoadFieldScript("anfrst_1");
     DummyFormatter formatter;
     SUDM::FF7::Field::DecompiledScript ds = SUDM::FF7::Field::Decompile("ff7_all_opcodes_by_category", scriptBytes, formatter, "", "EntityContainer = {}\n\n");
     ASSERT_FALSE(ds.luaScript.empty());
@@ -1975,4 +1993,455 @@ TEST(FF7Field, Decomp_AllOpcodes)
     }
 
     tmp << ds.luaScript;
-}
\ No newline at end of file
+}
+TEST(FF7Field, DecompileBatchMatchesDecompile)
+{
+    const char* files[] = { "bug_fixes", "ff7_all_opcodes_by_category" };
+
+    DummyFormatter formatter;
+    SUDM::SynchronizedScriptFormatter sharedFormatter(formatter);
+    std::vector<SUDM::FF7::Field::DecompileJob> jobs;
+    for (int copy = 0; copy < 4; copy++)
+    {
+        for (const char* file : files)
+        {
+            auto scriptBytes = LoadFieldScript(file);
+            jobs.push_back({ file, scriptBytes, &sharedFormatter, "", "-- copy " + std::to_string(copy) + "\n" });
+        }
+    }
+
+    const auto results = SUDM::FF7::Field::DecompileBatch(jobs, 4);
+    ASSERT_EQ(results.size(), jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const auto expected = SUDM::FF7::Field::Decompile(jobs[i].scriptName, jobs[i].scriptBytes, formatter, jobs[i].textToAppend, jobs[i].textToPrepend);
+        ASSERT_EQ(results[i].luaScript, expected.luaScript);
+        ASSERT_EQ(results[i].entities, expected.entities);
+    }
+
+    // A bad script fails the batch, but only once every job has finished
+    jobs[1].scriptBytes = { 0x00, 0x00 };
+    ASSERT_THROW(SUDM::FF7::Field::DecompileBatch(jobs, 4), InternalDecompilerError);
+}
+
+TEST(FF7Field, DecompileEntitiesInParallelMatchesSerial)
+{
+    const char* files[] = { "bug_fixes", "ff7_all_opcodes_by_category" };
+    for (const char* file : files)
+    {
+        auto scriptBytes = LoadFieldScript(file);
+
+        DummyFormatter formatter;
+        const auto serial = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1);
+        const auto parallel = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 4);
+        ASSERT_EQ(parallel.luaScript, serial.luaScript);
+        ASSERT_EQ(parallel.entities, serial.entities);
+    }
+}
+
+namespace
+{
+    class SpawnPointCountingFormatter : public DummyFormatter
+    {
+    public:
+        virtual void AddSpawnPoint(unsigned int, const std::string&, const std::string&, unsigned int, int, int, int, int) override
+        {
+            mSpawnPoints++;
+        }
+
+        int mSpawnPoints = 0;
+    };
+}
+
+TEST(FF7Field, FunctionCacheRegeneratesOnlyEditedFunctions)
+{
+    auto scriptBytes = LoadFieldScript("ff7_all_opcodes_by_category");
+
+    SpawnPointCountingFormatter formatter;
+    const auto uncached = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter);
+    const int spawnPoints = formatter.mSpawnPoints;
+    ASSERT_GT(spawnPoints, 0);
+
+    SUDM::FF7::Field::FunctionCache cache;
+    formatter.mSpawnPoints = 0;
+    const auto cold = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 1, &cache);
+    ASSERT_EQ(cold.luaScript, uncached.luaScript);
+    ASSERT_EQ(cache.Hits(), 0u);
+    const size_t numFunctions = cache.Misses();
+    ASSERT_EQ(cache.Size(), numFunctions);
+
+    // Everything comes from the cache, including the spawn points the formatter is told about
+    formatter.mSpawnPoints = 0;
+    const auto warm = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 4, &cache);
+    ASSERT_EQ(warm.luaScript, uncached.luaScript);
+    ASSERT_EQ(warm.entities, uncached.entities);
+    ASSERT_EQ(cache.Hits(), numFunctions);
+    ASSERT_EQ(formatter.mSpawnPoints, spawnPoints);
+
+    // Change how long a WAIT waits, which only changes the function it's in
+    InstVec insts;
+    FF7::FF7FieldEngine engine(formatter, "test");
+    FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+    disassembler.disassemble();
+    auto wait = std::find_if(insts.begin(), insts.end(), [](const InstPtr& inst) { return inst->_opcode == FF7::eOpcodes::WAIT; });
+    ASSERT_NE(wait, insts.end());
+    auto edited = scriptBytes;
+    edited[(*wait)->_address + 1] ^= 0x55;
+
+    cache.Clear();
+    SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 1, &cache);
+    const auto expected = SUDM::FF7::Field::Decompile("test", edited, formatter);
+    const auto incremental = SUDM::FF7::Field::Decompile("test", edited, formatter, "", "", 1, &cache);
+    ASSERT_EQ(incremental.luaScript, expected.luaScript);
+    ASSERT_NE(incremental.luaScript, uncached.luaScript);
+    ASSERT_EQ(cache.Hits(), numFunctions - 1);
+
+    // A formatter that names things differently can't use what another one generated
+    class RenamingFormatter : public SpawnPointCountingFormatter
+    {
+    public:
+        virtual std::string Fingerprint() override { return "renaming"; }
+    };
+    RenamingFormatter renaming;
+    SUDM::FF7::Field::Decompile("test", edited, renaming, "", "", 1, &cache);
+    ASSERT_EQ(cache.Hits(), numFunctions - 1);
+}
+
+TEST(FF7Field, DiskCacheKeepsScriptsBetweenRuns)
+{
+    const char* files[] = { "bug_fixes", "ff7_all_opcodes_by_category" };
+    const std::string cacheFile = "sudm_test.cache";
+    std::remove(cacheFile.c_str());
+
+    SpawnPointCountingFormatter formatter;
+    SUDM::SynchronizedScriptFormatter sharedFormatter(formatter);
+    std::vector<SUDM::FF7::Field::DecompileJob> jobs;
+    for (const char* file : files)
+    {
+        auto scriptBytes = LoadFieldScript(file);
+        jobs.push_back({ file, scriptBytes, &sharedFormatter, "-- end\n", "-- start\n" });
+    }
+    const auto expected = SUDM::FF7::Field::DecompileBatch(jobs, 2);
+    const int spawnPoints = formatter.mSpawnPoints;
+
+    // The first run fills the cache and writes it when it goes away
+    {
+        SUDM::FF7::Field::DiskCache cache(cacheFile);
+        formatter.mSpawnPoints = 0;
+        const auto cold = SUDM::FF7::Field::DecompileBatch(jobs, 2, &cache);
+        ASSERT_EQ(cache.Hits(), 0u);
+        ASSERT_EQ(cache.Misses(), jobs.size());
+        ASSERT_EQ(formatter.mSpawnPoints, spawnPoints);
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            ASSERT_EQ(cold[i].luaScript, expected[i].luaScript);
+        }
+    }
+
+    // The next run takes everything from the file, including the spawn points
+    {
+        SUDM::FF7::Field::DiskCache cache(cacheFile);
+        ASSERT_EQ(cache.Size(), jobs.size());
+        formatter.mSpawnPoints = 0;
+        jobs[0].textToPrepend = "-- different start\n";
+        const auto warm = SUDM::FF7::Field::DecompileBatch(jobs, 2, &cache);
+        ASSERT_EQ(cache.Hits(), jobs.size());
+        ASSERT_EQ(formatter.mSpawnPoints, spawnPoints);
+        ASSERT_EQ(warm[0].luaScript, "-- different start\n" + expected[0].luaScript.substr(std::string("-- start\n").size()));
+        ASSERT_EQ(warm[1].luaScript, expected[1].luaScript);
+        ASSERT_EQ(warm[1].entities, expected[1].entities);
+
+        // An edited script misses, and saving keeps the old entries next to the new one
+        jobs[1].scriptBytes.back() ^= 0xFF;
+        SUDM::FF7::Field::DecompileBatch(jobs, 2, &cache);
+        ASSERT_EQ(cache.Misses(), 1u);
+        cache.Save();
+        ASSERT_EQ(cache.Size(), jobs.size() + 1);
+        ASSERT_FALSE(cache.Report().empty());
+    }
+
+    // A damaged file is an empty cache, which is replaced when saved
+    {
+        std::ofstream damaged(cacheFile, std::ios::binary | std::ios::trunc);
+        damaged << "SUDMCACH not really";
+    }
+    {
+        SUDM::FF7::Field::DiskCache cache(cacheFile);
+        ASSERT_EQ(cache.Size(), 0u);
+        SUDM::FF7::Field::DecompileBatch(jobs, 2, &cache);
+        ASSERT_EQ(cache.Misses(), jobs.size());
+    }
+    {
+        SUDM::FF7::Field::DiskCache cache(cacheFile);
+        ASSERT_EQ(cache.Size(), jobs.size());
+    }
+    std::remove(cacheFile.c_str());
+}
+
+TEST(FF7Field, StructuredControlFlowNeverAddsGotos)
+{
+    const auto countGotos = [](const std::string& lua)
+    {
+        size_t count = 0;
+        for (size_t pos = lua.find("goto "); pos != std::string::npos; pos = lua.find("goto ", pos + 1))
+        {
+            count++;
+        }
+        return count;
+    };
+
+    const char* files[] = { "bug_fixes", "ff7_all_opcodes_by_category" };
+    for (const char* file : files)
+    {
+        auto scriptBytes = LoadFieldScript(file);
+
+        SpawnPointCountingFormatter formatter;
+        const auto gotos = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter);
+        const int spawnPoints = formatter.mSpawnPoints;
+
+        // Functions that can't be structured fall back to gotos, so spawn points are only added once
+        formatter.mSpawnPoints = 0;
+        const auto structured = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, nullptr, SUDM::FF7::Field::ControlFlowMode::Structured);
+        ASSERT_EQ(formatter.mSpawnPoints, spawnPoints);
+        ASSERT_EQ(structured.entities, gotos.entities);
+        ASSERT_LE(countGotos(structured.luaScript), countGotos(gotos.luaScript));
+
+        const auto parallel = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 4, nullptr, SUDM::FF7::Field::ControlFlowMode::Structured);
+        ASSERT_EQ(parallel.luaScript, structured.luaScript);
+
+        // Structured functions are cached apart from goto ones
+        SUDM::FF7::Field::FunctionCache cache;
+        SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, &cache);
+        const auto cached = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, &cache, SUDM::FF7::Field::ControlFlowMode::Structured);
+        ASSERT_EQ(cached.luaScript, structured.luaScript);
+
+        // Both analyses find the same constructs in structured code
+        const auto dominated = SUDM::FF7::Field::Decompile(file, scriptBytes, formatter, "", "", 1, &cache, SUDM::FF7::Field::ControlFlowMode::StructuredByDominators);
+        ASSERT_EQ(dominated.luaScript, structured.luaScript);
+    }
+}
+
+namespace
+{
+    // The Lua of one function of a decompiled script, from its signature to its end
+    std::string FunctionLua(const std::string& lua, const std::string& name)
+    {
+        const size_t begin = lua.find("    " + name + " = function( self )\n");
+        const std::string end = "\n    end,\n";
+        const size_t endPos = lua.find(end, begin);
+        if (begin == std::string::npos || endPos == std::string::npos)
+        {
+            return "";
+        }
+        return lua.substr(begin, endPos + end.size() - begin);
+    }
+
+    // ff7_control_flow_test with its scripts after on_start replaced by the given ones, from on_interact on.
+    // Scripts past the last given one start where it ends, padded with NOPs to the end of the script data.
+    std::vector<unsigned char> ControlFlowScript(const std::vector<std::vector<unsigned char>>& scripts)
+    {
+        const size_t kEntryPoints = 0x30;
+        const size_t kNumScripts = 32;
+        const size_t kFirstScript = 0x71;
+        const size_t kScriptEnd = 0xbd;
+        const unsigned char kNop = 0x5f;
+
+        auto scriptBytes = LoadFieldScript("ff7_control_flow_test");
+        std::vector<size_t> starts;
+        size_t pos = kFirstScript;
+        for (const auto& script : scripts)
+        {
+            starts.push_back(pos);
+            std::copy(script.begin(), script.end(), scriptBytes.begin() + pos);
+            pos += script.size();
+        }
+        EXPECT_LE(pos, kScriptEnd);
+        std::fill(scriptBytes.begin() + pos, scriptBytes.begin() + kScriptEnd, kNop);
+        for (size_t i = 1; i < kNumScripts; i++)
+        {
+            const size_t start = i - 1 < starts.size() ? starts[i - 1] : pos;
+            scriptBytes[kEntryPoints + i * 2] = start & 0xff;
+            scriptBytes[kEntryPoints + i * 2 + 1] = static_cast<unsigned char>(start >> 8);
+        }
+        return scriptBytes;
+    }
+}
+
+TEST(FF7Field, StructuredLoopAtFunctionStart)
+{
+    // on_interact loops while 1 == 2 from its first instruction, and script_2 loops back to its
+    // first instruction from its end, which the previous function's last instruction falls in to
+    auto scriptBytes = LoadFieldScript("ff7_control_flow_test");
+    const std::pair<size_t, unsigned char> patch[] =
+    {
+        { 0x77, 0x12 }, { 0x78, 0x06 },
+        { 0x7a, 0x14 }, { 0x7b, 0x00 }, { 0x7c, 0x01 }, { 0x7d, 0x02 }, { 0x7e, 0x00 }, { 0x7f, 0x02 },
+        { 0x80, 0x5f }, { 0x81, 0x12 }, { 0x82, 0x07 }
+    };
+    for (const auto& byte : patch)
+    {
+        scriptBytes[byte.first] = byte.second;
+    }
+
+    DummyFormatter formatter;
+    const auto gotos = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter);
+    const auto structured = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 1, nullptr, SUDM::FF7::Field::ControlFlowMode::Structured);
+    ASSERT_EQ(FunctionLua(structured.luaScript, "on_interact"),
+        "    on_interact = function( self )\n"
+        "        --[[\n"
+        "        00000071: IFUB 0, 0, 1, 2, 0, 3 (False target address: 0x79)\n"
+        "        00000077: JMPB 6 (Jump target address: 0x71)\n"
+        "        00000079: NOP\n"
+        "        ]]\n"
+        "\n"
+        "        while (1 == 2) do\n"
+        "            -- Hack, yield control for possible inf loop\n"
+        "            script:wait(0)\n"
+        "        end\n"
+        "    end,\n");
+
+    // An infinite loop can't be structured, so it is written with gotos
+    ASSERT_FALSE(FunctionLua(gotos.luaScript, "script_2").empty());
+    ASSERT_EQ(FunctionLua(structured.luaScript, "script_2"), FunctionLua(gotos.luaScript, "script_2"));
+
+    // Both analyses are given the same groups, so they agree
+    const auto dominated = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 1, nullptr, SUDM::FF7::Field::ControlFlowMode::StructuredByDominators);
+    ASSERT_EQ(dominated.luaScript, structured.luaScript);
+}
+
+TEST(FF7Field, StructuredControlFlowConstructs)
+{
+    const auto scriptBytes = ControlFlowScript(
+    {
+        // on_interact: IFUB 1 == 2 to 0x7c, WAIT 1, JMPB to 0x71, RET
+        { 0x14, 0x00, 0x01, 0x02, 0x00, 0x06, 0x24, 0x01, 0x00, 0x12, 0x09, 0x00 },
+        // script_2: WAIT 2, IFUB 3 == 4 to 0x8b, WAIT 3, JMPB to 0x80, RET
+        { 0x24, 0x02, 0x00, 0x14, 0x00, 0x03, 0x04, 0x00, 0x06, 0x24, 0x03, 0x00, 0x12, 0x09, 0x00 },
+        // script_3: WAIT 4, IFUB 5 == 6 to 0x97, JMPB to 0x8c, RET
+        { 0x24, 0x04, 0x00, 0x14, 0x00, 0x05, 0x06, 0x00, 0x03, 0x12, 0x09, 0x00 },
+        // script_4: IFUB 7 == 8 to 0xa3, WAIT 5, JMPF to 0xac, IFUB 9 == 10 to 0xac, WAIT 6, RET
+        { 0x14, 0x00, 0x07, 0x08, 0x00, 0x06, 0x24, 0x05, 0x00, 0x10, 0x0a, 0x14, 0x00, 0x09, 0x0a, 0x00, 0x04, 0x24, 0x06, 0x00, 0x00 },
+        // script_5: IFUB 11 == 12 to 0xb8, WAIT 7, JMPF to 0xbb, WAIT 8, RET
+        { 0x14, 0x00, 0x0b, 0x0c, 0x00, 0x06, 0x24, 0x07, 0x00, 0x10, 0x04, 0x24, 0x08, 0x00, 0x00 }
+    });
+
+    DummyFormatter formatter;
+    const auto gotos = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter);
+    const auto structured = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 1, nullptr, SUDM::FF7::Field::ControlFlowMode::Structured);
+
+    // A while loop at the start of a function
+    ASSERT_EQ(FunctionLua(structured.luaScript, "on_interact"),
+        "    on_interact = function( self )\n"
+        "        --[[\n"
+        "        00000071: IFUB 0, 0, 1, 2, 0, 6 (False target address: 0x7c)\n"
+        "        00000077: WAIT 1\n"
+        "        0000007a: JMPB 9 (Jump target address: 0x71)\n"
+        "        0000007c: RET\n"
+        "        ]]\n"
+        "\n"
+        "        while (1 == 2) do\n"
+        "            script:wait( 0.0333333 )\n"
+        "            -- Hack, yield control for possible inf loop\n"
+        "            script:wait(0)\n"
+        "        end\n"
+        "        return 0\n"
+        "    end,\n");
+
+    // A while loop after a statement
+    ASSERT_EQ(FunctionLua(structured.luaScript, "script_2"),
+        "    script_2 = function( self )\n"
+        "        --[[\n"
+        "        0000007d: WAIT 2\n"
+        "        00000080: IFUB 0, 0, 3, 4, 0, 6 (False target address: 0x8b)\n"
+        "        00000086: WAIT 3\n"
+        "        00000089: JMPB 9 (Jump target address: 0x80)\n"
+        "        0000008b: RET\n"
+        "        ]]\n"
+        "\n"
+        "        script:wait( 0.0666667 )\n"
+        "        while (3 == 4) do\n"
+        "            script:wait( 0.1 )\n"
+        "            -- Hack, yield control for possible inf loop\n"
+        "            script:wait(0)\n"
+        "        end\n"
+        "        return 0\n"
+        "    end,\n");
+
+    // Field conditional jumps only go forwards, so a loop testing its condition after its body, a
+    // repeat ... until, jumps back to a statement before the condition, which a while can't repeat
+    ASSERT_FALSE(FunctionLua(gotos.luaScript, "script_3").empty());
+    ASSERT_EQ(FunctionLua(structured.luaScript, "script_3"), FunctionLua(gotos.luaScript, "script_3"));
+
+    // An if with an else whose whole body is another if, written as elseif
+    ASSERT_EQ(FunctionLua(structured.luaScript, "script_4"),
+        "    script_4 = function( self )\n"
+        "        --[[\n"
+        "        00000098: IFUB 0, 0, 7, 8, 0, 6 (False target address: 0xa3)\n"
+        "        0000009e: WAIT 5\n"
+        "        000000a1: JMPF 10 (Jump target address: 0xac)\n"
+        "        000000a3: IFUB 0, 0, 9, 10, 0, 4 (False target address: 0xac)\n"
+        "        000000a9: WAIT 6\n"
+        "        000000ac: RET\n"
+        "        ]]\n"
+        "\n"
+        "        if (7 == 8) then\n"
+        "            script:wait( 0.166667 )\n"
+        "        elseif (9 == 10) then\n"
+        "            script:wait( 0.2 )\n"
+        "        end\n"
+        "        return 0\n"
+        "    end,\n");
+
+    // An if with an else
+    ASSERT_EQ(FunctionLua(structured.luaScript, "script_5"),
+        "    script_5 = function( self )\n"
+        "        --[[\n"
+        "        000000ad: IFUB 0, 0, 11, 12, 0, 6 (False target address: 0xb8)\n"
+        "        000000b3: WAIT 7\n"
+        "        000000b6: JMPF 4 (Jump target address: 0xbb)\n"
+        "        000000b8: WAIT 8\n"
+        "        000000bb: RET\n"
+        "        ]]\n"
+        "\n"
+        "        if (11 == 12) then\n"
+        "            script:wait( 0.233333 )\n"
+        "        else\n"
+        "            script:wait( 0.266667 )\n"
+        "        end\n"
+        "        return 0\n"
+        "    end,\n");
+
+    const auto dominated = SUDM::FF7::Field::Decompile("test", scriptBytes, formatter, "", "", 1, nullptr, SUDM::FF7::Field::ControlFlowMode::StructuredByDominators);
+    ASSERT_EQ(dominated.luaScript, structured.luaScript);
+}
+
+TEST(FF7Field, FailedAnalysisFallsBackToGotos)
+{
+    // Stands in for a script analysis chokes on in a way other than running out of budget
+    class FailingEngine : public FF7::FF7FieldEngine
+    {
+    public:
+        using FF7::FF7FieldEngine::FF7FieldEngine;
+        virtual void postCFG(InstVec&, Graph) override
+        {
+            throw std::runtime_error("malformed script");
+        }
+    };
+
+    auto scriptBytes = LoadFieldScript("ff7_control_flow_test");
+
+    DummyFormatter formatter;
+    FF7::FF7FieldEngine engine(formatter, "test");
+    FailingEngine failing(formatter, "test");
+    for (auto mode : { SUDM::FF7::Field::ControlFlowMode::Structured, SUDM::FF7::Field::ControlFlowMode::StructuredByDominators })
+    {
+        for (FF7::FF7FieldEngine* e : { &engine, static_cast<FF7::FF7FieldEngine*>(&failing) })
+        {
+            InstVec insts;
+            e->getDisassembler(insts, scriptBytes)->disassemble();
+            ControlFlow controlFlow(insts, *e);
+            controlFlow.createGroups();
+            ASSERT_EQ(e->AnalyzeControlFlow(controlFlow, insts, mode, 0), e == &engine);
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "lzs.h"
+#include "binaryreader.h"
+#include <string>
+#include <vector>
+
+// Decompresses decompiler/test/<name>.dat and removes its section pointers, so the script section
+// comes first. Everything after the script data is left as it doesn't matter.
+inline std::vector<unsigned char> LoadFieldScript(const std::string& name)
+{
+    auto scriptBytes = Lzs::Decompress(BinaryReader::ReadAll("decompiler/test/" + name + ".dat"));
+    const int kNumSections = 7;
+    scriptBytes.erase(scriptBytes.begin(), scriptBytes.begin() + kNumSections * sizeof(uint32));
+    return scriptBytes;
+}
@@ -0,0 +1,166 @@
+#include <gmock/gmock.h>
+#include "lzs.h"
+#include "make_unique.h"
+
+// Prefixes the body with the 32-bit little-endian length header
+static std::vector<unsigned char> LzsStream(std::vector<unsigned char> body)
+{
+    const size_t length = body.size();
+    body.insert(body.begin(), { static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+        static_cast<unsigned char>(length >> 16), static_cast<unsigned char>(length >> 24) });
+    return body;
+}
+
+TEST(Lzs, DecompressLiterals)
+{
+    const auto out = Lzs::Decompress(LzsStream({ 0xFF, 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 0x01, 'I' }));
+    ASSERT_EQ(std::string(out.begin(), out.end()), "ABCDEFGHI");
+}
+
+TEST(Lzs, DecompressOverlappingReference)
+{
+    // A literal followed by an 18 byte reference to the byte before it
+    const auto out = Lzs::Decompress(LzsStream({ 0x01, 'A', 0xEE, 0xFF }));
+    ASSERT_EQ(std::string(out.begin(), out.end()), std::string(19, 'A'));
+}
+
+TEST(Lzs, DecompressReferenceBeforeStartIsZeros)
+{
+    // Two literals then a 4 byte reference starting 2 bytes before the output does
+    const auto out = Lzs::Decompress(LzsStream({ 0x03, 'X', 'Y', 0xEC, 0xF1 }));
+    const std::vector<unsigned char> expected = { 'X', 'Y', 0, 0, 'X', 'Y' };
+    ASSERT_EQ(out, expected);
+}
+
+TEST(Lzs, DecompressSelfReferenceIsZeros)
+{
+    // 18 literals, a 3 byte reference 18 bytes back, then a 4 byte reference to its own output
+    const auto out = Lzs::Decompress(LzsStream({ 0xFF, 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
+        0xFF, 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 0x03, 'Q', 'R', 0xEE, 0xF0, 0x03, 0x01 }));
+    std::vector<unsigned char> expected = { 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'A', 'B', 'C', 0, 0, 0, 0 };
+    ASSERT_EQ(out, expected);
+}
+
+TEST(Lzs, DecompressEmpty)
+{
+    ASSERT_TRUE(Lzs::Decompress(LzsStream({})).empty());
+}
+
+TEST(Lzs, DecompressThrowsOnMalformedInput)
+{
+    ASSERT_THROW(Lzs::Decompress(std::vector<unsigned char>{ 0x00, 0x00 }), InternalDecompilerError);
+
+    auto badLength = LzsStream({ 0x01, 'A' });
+    badLength[0]++;
+    ASSERT_THROW(Lzs::Decompress(badLength), LzsDecompressionException);
+
+    // Reference is missing its second byte
+    ASSERT_THROW(Lzs::Decompress(LzsStream({ 0x01, 'A', 0xEE })), LzsDecompressionException);
+}
+
+TEST(Lzs, StreamMatchesDecompress)
+{
+    const char* files[] = { "decompiler/test/bug_fixes.dat", "decompiler/test/ff7_all_opcodes_by_category.dat", "decompiler/test/ff7_control_flow_test.dat" };
+    for (const char* file : files)
+    {
+        const auto compressed = BinaryReader::ReadAll(file);
+        const auto expected = Lzs::Decompress(compressed);
+
+        // Odd sized reads so references get split across calls
+        Lzs::StreamDecompressor stream(compressed.data(), compressed.size());
+        std::vector<unsigned char> out;
+        unsigned char buffer[7];
+        size_t read = 0;
+        while ((read = stream.Read(buffer, sizeof(buffer))) > 0)
+        {
+            out.insert(out.end(), buffer, buffer + read);
+        }
+        ASSERT_EQ(out, expected) << file;
+        ASSERT_EQ(stream.Produced(), expected.size());
+    }
+}
+
+TEST(Lzs, StreamSelfReferenceIsZeros)
+{
+    const auto compressed = LzsStream({ 0xFF, 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
+        0xFF, 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 0x03, 'Q', 'R', 0xEE, 0xF0, 0x03, 0x01 });
+    Lzs::StreamDecompressor stream(compressed.data(), compressed.size());
+    std::vector<unsigned char> out(64);
+    out.resize(stream.Read(out.data(), out.size()));
+    ASSERT_EQ(out, Lzs::Decompress(compressed));
+}
+
+TEST(Lzs, StreamOnlyDecompressesWhatIsRead)
+{
+    const auto compressed = BinaryReader::ReadAll("decompiler/test/ff7_all_opcodes_by_category.dat");
+    const auto expected = Lzs::Decompress(compressed);
+
+    auto source = std::make_unique<Lzs::StreamDecompressor>(compressed.data(), compressed.size());
+    Lzs::StreamDecompressor* stream = source.get();
+    BinaryReader reader(std::move(source));
+
+    ASSERT_EQ(reader.ReadU32(), BinaryReader(expected.data(), expected.size()).ReadU32());
+    ASSERT_LT(stream->Produced(), expected.size());
+
+    reader.Seek(static_cast<unsigned int>(expected.size()) - 1);
+    ASSERT_EQ(reader.ReadU8(), expected.back());
+    ASSERT_EQ(stream->Produced(), expected.size());
+    ASSERT_THROW(reader.ReadU8(), InternalDecompilerError);
+
+    // Seeking back is fine as everything read so far is kept
+    reader.Seek(0);
+    ASSERT_EQ(reader.ReadU8(), expected[0]);
+}
+
+TEST(Lzs, StreamThrowsOnMalformedInput)
+{
+    const std::vector<unsigned char> tooSmall = { 0x00, 0x00 };
+    ASSERT_THROW(Lzs::StreamDecompressor(tooSmall.data(), tooSmall.size()), LzsDecompressionException);
+
+    const auto truncated = LzsStream({ 0x01, 'A', 0xEE });
+    Lzs::StreamDecompressor stream(truncated.data(), truncated.size());
+    unsigned char buffer[16];
+    ASSERT_THROW(stream.Read(buffer, sizeof(buffer)), LzsDecompressionException);
+}
+
+static void ExpectRoundTrip(const std::vector<unsigned char>& data)
+{
+    for (auto mode : { Lzs::eCompressionMode::eFast, Lzs::eCompressionMode::eMaxRatio })
+    {
+        ASSERT_EQ(Lzs::Decompress(Lzs::Compress(data, mode)), data);
+    }
+}
+
+TEST(Lzs, CompressRoundTrips)
+{
+    ExpectRoundTrip({});
+    ExpectRoundTrip({ 'A' });
+    ExpectRoundTrip({ 'A', 'B', 'A', 'B', 'A', 'B', 'A', 'B' });
+    ExpectRoundTrip(std::vector<unsigned char>(10000, 0));
+    ExpectRoundTrip(std::vector<unsigned char>(10000, 0xAB));
+
+    std::vector<unsigned char> noise(20000);
+    unsigned int seed = 1;
+    for (auto& byte : noise)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = static_cast<unsigned char>(seed >> 16);
+    }
+    ExpectRoundTrip(noise);
+
+    const char* files[] = { "decompiler/test/bug_fixes.dat", "decompiler/test/ff7_all_opcodes_by_category.dat", "decompiler/test/ff7_control_flow_test.dat" };
+    for (const char* file : files)
+    {
+        ExpectRoundTrip(Lzs::Decompress(BinaryReader::ReadAll(file)));
+    }
+}
+
+TEST(Lzs, CompressShrinksRepetitiveData)
+{
+    const std::vector<unsigned char> data(4096, 'Z');
+    for (auto mode : { Lzs::eCompressionMode::eFast, Lzs::eCompressionMode::eMaxRatio })
+    {
+        // One literal then references of 18 bytes, each 2 bytes plus a control byte per 8
+        ASSERT_LT(Lzs::Compress(data, mode).size(), data.size() / 8);
+    }
+}
@@ -13,9 +13,12 @@
 #include "make_unique.h"
 #include "sudm.h"
 #include "lzs.h"
+#include "arena.h"
+#include "thread_pool.h"
 #include "ff7_field_dummy_formatter.h"
+#include "ff7_field_script_bytes.h"
 
-#define GET(vertex) (boost::get(boost::vertex_name, g, vertex))
+#define GET(vertex) (get(boost::vertex_name, g, vertex))
 
 
 class TestReadParameterDisassembler : public SimpleDisassembler
@@ -32,6 +35,11 @@ public:
         return SimpleDisassembler::readParams(inst, typeString);
     }
 
+    void readParams(InstPtr inst, const ParamLayout& layout)
+    {
+        return SimpleDisassembler::readParams(inst, layout);
+    }
+
 
     virtual void doDisassemble() throw(std::exception) override final
     {
@@ -123,6 +131,364 @@ TEST(SimpleDisassembler, readParameter_d)
     ASSERT_EQ(inst->_params[0]->getUnsigned(), 0xEFBEADDE);
 }
 
+TEST(ParamLayout, CompilesAtCompileTime)
+{
+    constexpr ParamLayout layout("NBwX");
+    static_assert(layout.Count() == 4, "one entry per format character");
+    static_assert(layout.Kind(0) == ParamLayout::eNibbles, "N is a nibble pair");
+    static_assert(layout.Kind(1) == ParamLayout::eU8, "B is an unsigned byte");
+    static_assert(layout.Kind(2) == ParamLayout::eU16, "w is an unsigned word");
+    static_assert(layout.Kind(3) == ParamLayout::eCustom, "unknown characters are left to readParameter");
+    ASSERT_EQ(layout.Format(3), 'X');
+
+    ASSERT_THROW(ParamLayout("BBBBBBBBBBBBBBBBB"), InternalDecompilerError);
+}
+
+TEST(ParamLayout, ReadsSameAsFormatString)
+{
+    const std::vector<unsigned char> data = { 0xAB, 0xAA, 0x9C, 0xFF, 0xFE, 0xFE, 0xAA, 0x01, 0x02, 0x03, 0x04 };
+    const InstPtr expected = DoReadParameterTest("NUbswd", data);
+
+    InstVec insts;
+    TestReadParameterDisassembler d(std::vector<unsigned char>(data), insts);
+    InstPtr inst = new FF7::FF7NoOperationInstruction();
+    d.readParams(inst, ParamLayout("NUbswd"));
+
+    ASSERT_EQ(inst->_params.size(), expected->_params.size());
+    for (size_t i = 0; i < inst->_params.size(); i++)
+    {
+        ASSERT_EQ(inst->_params[i]->getSigned(), expected->_params[i]->getSigned());
+    }
+
+    // Characters the layout doesn't know still reach readParameter, which rejects them here
+    ASSERT_THROW(DoReadParameterTest("X", { 0 }), UnknownOpcodeParameterException);
+}
+
+TEST(FF7Field, InstructionTableCoversSubOpcodes)
+{
+    const auto insts = FF7::FieldInstructions();
+    ASSERT_EQ(insts.at("IFUB")->mOpCode, static_cast<unsigned int>(FF7::eOpcodes::IFUB));
+    ASSERT_STREQ(insts.at("IFUB")->mArgumentFormat, "NBBBB");
+    ASSERT_EQ(insts.at("ARROW")->mOpCode, static_cast<unsigned int>((FF7::eOpcodes::SPECIAL << 8) | FF7::eSpecialOpcodes::ARROW));
+    ASSERT_EQ(insts.at("RESET")->mOpCode, static_cast<unsigned int>((FF7::eOpcodes::KAWAI << 8) | FF7::eKawaiOpcodes::RESET));
+    ASSERT_EQ(insts.count("SPECIAL"), 0u);
+}
+
+TEST(InstructionStore, MaterializesStoredInstructions)
+{
+    InstructionStore store;
+    const InstructionStore::FactoryFunc factory = []() -> InstPtr { return new FF7::FF7ModelInstruction(); };
+    const char* kMnemonic = "MOVE";
+    store.Add(factory, FF7::eOpcodes::MOVE, 0x10, 0, kMnemonic);
+    store.AddParam({ 1, false });
+    store.AddParam({ -5, true });
+    store.Add(factory, FF7::eOpcodes::MOVE, 0x16, 0, kMnemonic);
+
+    ASSERT_EQ(store.Size(), 2u);
+    ASSERT_EQ(store.MnemonicId(0), store.MnemonicId(1));
+    ASSERT_EQ(store.ParamCount(0), 2u);
+    ASSERT_EQ(store.ParamCount(1), 0u);
+
+    InstPtr inst = store.Materialize(0);
+    ASSERT_EQ(inst->_opcode, static_cast<uint32>(FF7::eOpcodes::MOVE));
+    ASSERT_EQ(inst->_address, 0x10u);
+    ASSERT_EQ(inst->_name, "MOVE");
+    ASSERT_EQ(inst->_params.size(), 2u);
+    ASSERT_EQ(inst->_params[0]->getUnsigned(), 1u);
+    ASSERT_EQ(inst->_params[1]->getSigned(), -5);
+}
+
+TEST(FF7Field, StoreMatchesInstructions)
+{
+    auto scriptBytes = LoadFieldScript("bug_fixes");
+
+    SUDM::IScriptFormatter formatter;
+    FF7::FF7FieldEngine engine(formatter, "test");
+    InstVec insts;
+    FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+    disassembler.disassemble();
+
+    const InstructionStore& store = disassembler.Store();
+    ASSERT_EQ(store.Size(), insts.size());
+    for (size_t i = 0; i < store.Size(); i++)
+    {
+        ASSERT_EQ(store.Address(i), insts[i]->_address);
+        ASSERT_EQ(store.Opcode(i), insts[i]->_opcode);
+        ASSERT_EQ(store.Mnemonic(i), insts[i]->_name);
+        ASSERT_EQ(store.ParamCount(i), insts[i]->_params.size());
+    }
+}
+
+TEST(FF7Field, FunctionsRecordTheirInstructions)
+{
+    auto scriptBytes = LoadFieldScript("ff7_all_opcodes_by_category");
+
+    SUDM::IScriptFormatter formatter;
+    FF7::FF7FieldEngine engine(formatter, "test");
+    InstVec insts;
+    FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+    disassembler.disassemble();
+
+    ASSERT_FALSE(engine._functions.empty());
+    size_t expectedFirst = 0;
+    for (const auto& function : engine._functions)
+    {
+        const Function& func = function.second;
+        ASSERT_EQ(func.mFirstInstruction, expectedFirst);
+        ASSERT_GT(func.mNumInstructions, 0u);
+        ASSERT_EQ(insts[func.mFirstInstruction]->_address, func.mStartAddr);
+        ASSERT_EQ(insts[func.mFirstInstruction + func.mNumInstructions - 1]->_address, func.mEndAddr);
+        expectedFirst += func.mNumInstructions;
+    }
+    ASSERT_EQ(expectedFirst, insts.size());
+}
+
+TEST(FF7Field, FieldScriptInfoReadsHeaderInPlace)
+{
+    auto scriptBytes = LoadFieldScript("ff7_all_opcodes_by_category");
+
+    SUDM::IScriptFormatter formatter;
+    FF7::FF7FieldEngine engine(formatter, "test");
+    InstVec insts;
+    FF7::FF7Disassembler disassembler(formatter, &engine, insts, scriptBytes);
+    disassembler.disassemble();
+
+    const SUDM::FF7::Field::FieldScriptInfo info(scriptBytes);
+    ASSERT_EQ(info.ScaleFactor(), disassembler.ScaleFactor());
+    ASSERT_EQ(SUDM::FF7::Field::ScaleFactor(scriptBytes), disassembler.ScaleFactor());
+    ASSERT_GT(info.NumEntities(), 0u);
+    ASSERT_EQ(engine.GetEntities().count(info.EntityName(0)), 1u);
+    ASSERT_EQ(engine._functions.begin()->first, info.ScriptEntryPoint(0, 0));
+    ASSERT_THROW(info.EntityName(info.NumEntities()), InternalDecompilerError);
+
+    // The scripts sit between the header and the strings
+    ASSERT_LE(info.Creator().size(), 8u);
+    ASSERT_LE(info.Name().size(), 8u);
+    ASSERT_LE(info.HeaderSize(), info.ScriptEntryPoint(0, 0));
+    ASSERT_GT(info.OffsetToStrings(), engine._functions.rbegin()->second.mEndAddr);
+    ASSERT_LE(info.OffsetToStrings(), scriptBytes.size());
+
+    const std::vector<unsigned char> truncated(scriptBytes.begin(), scriptBytes.begin() + 40);
+    ASSERT_THROW(SUDM::FF7::Field::FieldScriptInfo{ truncated }, FF7ScriptHeaderInvalidException);
+}
+
+TEST(Symbol, InternsEqualStrings)
+{
+    const Symbol a("MOVE");
+    const Symbol b(std::string("MO") + "VE");
+    ASSERT_EQ(&a.str(), &b.str());
+    ASSERT_TRUE(a == b);
+    ASSERT_TRUE(a == "MOVE");
+    ASSERT_TRUE(a != Symbol("MOVA"));
+    ASSERT_TRUE(Symbol().empty());
+    ASSERT_EQ(Symbol(""), Symbol());
+}
+
+TEST(FF7Field, FunctionMetaDataParsedFromSymbol)
+{
+    const FF7::FunctionMetaData md(Symbol("start_end_5_some_entity"));
+    ASSERT_TRUE(md.IsStart());
+    ASSERT_TRUE(md.IsEnd());
+    ASSERT_EQ(md.CharacterId(), 5);
+    ASSERT_EQ(md.EntityName(), "some_entity");
+}
+
+TEST(Instruction, StackEffectIsPerStream)
+{
+    InstPtr inst = new FF7::FF7ModelInstruction();
+    inst->_address = 0x10;
+    inst->_name = "MOVE";
+    inst->_stackChange = 2;
+
+    // Creating engines no longer changes how anything else prints
+    SUDM::IScriptFormatter formatter;
+    FF7::FF7FieldEngine fieldEngine(formatter, "test");
+    ASSERT_FALSE(fieldEngine._outputStackEffect);
+
+    std::stringstream plain;
+    plain << inst;
+    std::stringstream field;
+    field << StackEffect(fieldEngine._outputStackEffect) << inst;
+    std::stringstream shown;
+    shown << StackEffect(false) << StackEffect(true) << inst;
+
+    ASSERT_TRUE(outputStackEffect(plain));
+    ASSERT_FALSE(outputStackEffect(field));
+    ASSERT_EQ(plain.str(), shown.str());
+    ASSERT_NE(plain.str().find(" (2)"), std::string::npos);
+    ASSERT_EQ(field.str().find(" (2)"), std::string::npos);
+}
+
+namespace
+{
+    struct CountedValue : public IntValue
+    {
+        CountedValue(int& destroyed) : IntValue(0, false), mDestroyed(destroyed) { }
+        ~CountedValue() { mDestroyed++; }
+        int& mDestroyed;
+    };
+}
+
+TEST(Arena, DestroysObjectsWithTheArena)
+{
+    int destroyed = 0;
+    {
+        Arena arena;
+        Arena::Scope scope(&arena);
+        ValuePtr value = new CountedValue(destroyed);
+        ASSERT_TRUE(arena.Owns(value.get()));
+        {
+            ValuePtr copy = value;
+        }
+        value = nullptr;
+
+        // Releasing the last reference doesn't delete arena objects
+        ASSERT_EQ(destroyed, 0);
+        ASSERT_EQ(arena.ObjectCount(), 1u);
+
+        // Stack objects are never claimed by the arena
+        CountedValue onStack(destroyed);
+        ASSERT_FALSE(arena.Owns(&onStack));
+    }
+    ASSERT_EQ(destroyed, 2);
+}
+
+TEST(Arena, ClaimsNestedAllocations)
+{
+    int destroyed = 0;
+    {
+        Arena arena;
+        Arena::Scope scope(&arena);
+
+        // The outer allocation may happen before the inner objects are constructed
+        ValuePtr value = new BinaryOpValue(new CountedValue(destroyed), new CountedValue(destroyed), "+");
+        ASSERT_TRUE(arena.Owns(value.get()));
+        ASSERT_EQ(arena.ObjectCount(), 3u);
+        value = nullptr;
+        ASSERT_EQ(destroyed, 0);
+    }
+    ASSERT_EQ(destroyed, 2);
+}
+
+TEST(Arena, LeavesEmbeddedObjectsToTheirOwner)
+{
+    struct PairValue : public CountedValue
+    {
+        PairValue(int& destroyed) : CountedValue(destroyed), mOther(destroyed) { }
+        CountedValue mOther;
+    };
+
+    int destroyed = 0;
+    {
+        Arena arena;
+        Arena::Scope scope(&arena);
+        ValuePtr value = new PairValue(destroyed);
+        ASSERT_TRUE(arena.Owns(value.get()));
+        ASSERT_EQ(arena.ObjectCount(), 1u);
+    }
+    ASSERT_EQ(destroyed, 2);
+}
+
+TEST(Arena, HeapAllocationOutsideScope)
+{
+    int destroyed = 0;
+    Arena arena;
+    {
+        ValuePtr value = new CountedValue(destroyed);
+        ASSERT_FALSE(arena.Owns(value.get()));
+    }
+    ASSERT_EQ(destroyed, 1);
+    ASSERT_EQ(arena.ObjectCount(), 0u);
+}
+
+TEST(ThreadPool, RunsNestedBatchesAndRethrowsFirstError)
+{
+    ThreadPool pool(3);
+    std::atomic<int> count(0);
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 8; i++)
+    {
+        tasks.push_back([&]()
+        {
+            // Running a batch from inside a task must not deadlock
+            std::vector<std::function<void()>> inner(4, [&]() { count++; });
+            pool.Run(inner);
+        });
+    }
+    pool.Run(tasks);
+    ASSERT_EQ(count, 32);
+
+    tasks.clear();
+    for (int i = 0; i < 8; i++)
+    {
+        tasks.push_back([i]()
+        {
+            if (i == 3 || i == 6)
+            {
+                throw std::runtime_error(std::to_string(i));
+            }
+        });
+    }
+    try
+    {
+        pool.Run(tasks);
+        FAIL();
+    }
+    catch (const std::runtime_error& e)
+    {
+        ASSERT_STREQ(e.what(), "3");
+    }
+}
+
+TEST(BinaryReader, ReadsLittleEndianFromView)
+{
+    const unsigned char data[] = { 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xff, 0x80 };
+    BinaryReader r(data, sizeof(data));
+
+    ASSERT_EQ(r.Size(), sizeof(data));
+    ASSERT_EQ(r.ReadU32(), 0xEFBEADDE);
+    ASSERT_EQ(r.ReadS16(), -2);
+    ASSERT_EQ(r.ReadS8(), -128);
+    ASSERT_EQ(r.Position(), 7);
+
+    r.Seek(1);
+    ASSERT_EQ(r.ReadU16(), 0xBEAD);
+}
+
+TEST(BinaryReader, ThrowsOnOutOfBounds)
+{
+    BinaryReader r(std::vector<unsigned char>{ 0x01, 0x02, 0x03 });
+
+    ASSERT_THROW(r.ReadU32(), InternalDecompilerError);
+    ASSERT_EQ(r.Position(), 0);
+    ASSERT_EQ(r.ReadU16(), 0x0201);
+    ASSERT_THROW(r.ReadU16(), InternalDecompilerError);
+    ASSERT_EQ(r.ReadU8(), 0x03);
+    ASSERT_NO_THROW(r.Seek(3));
+    ASSERT_THROW(r.Seek(4), InternalDecompilerError);
+}
+
+TEST(MappedFile, MatchesReadAll)
+{
+    const std::vector<unsigned char> expected = BinaryReader::ReadAll("decompiler/test/ff7.dat");
+    MappedFile file("decompiler/test/ff7.dat");
+
+    ASSERT_EQ(file.Size(), expected.size());
+    ASSERT_TRUE(std::equal(expected.begin(), expected.end(), file.Data()));
+
+    ASSERT_THROW(MappedFile("decompiler/test/does_not_exist.dat"), std::runtime_error);
+}
+
+#ifdef __linux__
+TEST(MappedFile, FallsBackForUnsizedFiles)
+{
+    // procfs files report a size of 0 so can't be mapped, but still have content
+    MappedFile file("/proc/self/stat");
+    ASSERT_FALSE(file.IsMapped());
+    ASSERT_GT(file.Size(), 0);
+}
+#endif
+
 TEST(FF7Field, FunctionMetaData_Parse_Empty)
 {
     FF7::FunctionMetaData meta("");
@@ -226,15 +592,13 @@ TEST(FF7World, DisAsm)
         if (out.is_open())
         {
             auto& g = c->getGraph();
-            boost::write_graphviz(
-                out, g, boost::make_label_writer(get(boost::vertex_name, g)),
-                boost::makeArrowheadWriter(get(boost::edge_attribute, g)), GraphProperties(&engine, g));
+            writeGraphviz(out, g, engine._outputStackEffect, GraphProperties(&engine, g));
         }
         out.close();
 
         cg->generate(insts, g);
 
-        VertexIterator v = boost::vertices(g).first;
+        VertexIterator v = vertices(g).first;
         GroupPtr gr = GET(*v);
 
         // Find first node
@@ -1150,6 +1514,22 @@ private:
         }
     }
 
+    // The table holds the disassembler format, where N is one byte of two nibbles and a conditional
+    // jump ends with its byte offset, so spell it out as the arguments written in the source
+    static std::string AssemblerFormat(const FF7::TInstructRecord& rec)
+    {
+        std::string format;
+        for (const char* fmt = rec.mArgumentFormat; *fmt; fmt++)
+        {
+            format += *fmt == 'N' ? "NN" : std::string(1, *fmt);
+        }
+        if (!format.empty() && rec.mFactoryFunc()->isCondJump())
+        {
+            format.back() = 'L';
+        }
+        return format;
+    }
+
     void ParseInstruction(const Tokenzier::Token& inst, std::deque<Tokenzier::Token>& tokens, Assembler::Method& method)
     {
         const auto insts = FF7::FieldInstructions();
@@ -1161,7 +1541,8 @@ private:
 
         // TODO: Handle arguments correctly, validate labels
         const FF7::TInstructRecord* rec = it->second;
-        const char* fmt = rec->mArgumentFormat;
+        const std::string assemblerFormat = AssemblerFormat(*rec);
+        const char* fmt = assemblerFormat.c_str();
 
         // method.AddInstruction(rec->mOpCode, rec->mOpCodeSize);
         // TODO: Flow control needs special handling
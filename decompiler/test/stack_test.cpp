@@ -0,0 +1,108 @@
+#include <gmock/gmock.h>
+#include "decompiler/stack.h"
+#include <memory>
+#include <stdexcept>
+
+// A stack of 0 at the bottom up to count - 1 at the top
+static Stack<int> Counting(int count)
+{
+    Stack<int> stack;
+    for (int i = 0; i < count; i++)
+    {
+        stack.push(i);
+    }
+    return stack;
+}
+
+static void ExpectCounting(Stack<int> stack, int count)
+{
+    for (int i = count - 1; i >= 0; i--)
+    {
+        ASSERT_FALSE(stack.empty());
+        ASSERT_EQ(stack.pop(), i);
+    }
+    ASSERT_TRUE(stack.empty());
+}
+
+TEST(Stack, PushPopPastInlineCapacity)
+{
+    Stack<int> stack;
+    ASSERT_TRUE(stack.empty());
+    for (int count : { 0, 1, 4, 5, 100 })
+    {
+        ExpectCounting(Counting(count), count);
+    }
+}
+
+TEST(Stack, PeekPosCountsFromTop)
+{
+    for (int count : { 3, 50 })
+    {
+        Stack<int> stack = Counting(count);
+        ASSERT_EQ(stack.peek(), count - 1);
+        ASSERT_EQ(stack.peekPos(0), count - 1);
+        ASSERT_EQ(stack.peekPos(2), count - 3);
+        stack.peekPos(1) = -1;
+        stack.pop();
+        ASSERT_EQ(stack.peek(), -1);
+        ASSERT_THROW(stack.peekPos(count - 1), std::out_of_range);
+    }
+}
+
+TEST(Stack, CopiesAreIndependent)
+{
+    for (int count : { 2, 4, 5, 40 })
+    {
+        const Stack<int> original = Counting(count);
+        Stack<int> copy(original);
+        copy.push(count);
+        Stack<int> assigned = Counting(count * 2);
+        assigned = original;
+        assigned.pop();
+        ExpectCounting(original, count);
+        ExpectCounting(copy, count + 1);
+        ExpectCounting(assigned, count - 1);
+    }
+}
+
+TEST(Stack, MoveAndSwapEveryStorageCombination)
+{
+    for (int a : { 0, 3, 9 })
+    {
+        for (int b : { 0, 2, 20 })
+        {
+            Stack<int> first = Counting(a);
+            Stack<int> second = Counting(b);
+            first.swap(second);
+            ExpectCounting(first, b);
+            ExpectCounting(second, a);
+
+            Stack<int> moved = Counting(a);
+            Stack<int> into = Counting(b);
+            into = std::move(moved);
+            ExpectCounting(into, a);
+            into.push(7);
+            ASSERT_EQ(into.pop(), 7);
+        }
+    }
+}
+
+TEST(Stack, ItemsAreReleased)
+{
+    auto item = std::make_shared<int>(0);
+    {
+        Stack<std::shared_ptr<int>> stack;
+        for (int i = 0; i < 10; i++)
+        {
+            stack.push(item);
+        }
+        Stack<std::shared_ptr<int>> copy(stack);
+        ASSERT_EQ(item.use_count(), 21);
+        stack.pop();
+        Stack<std::shared_ptr<int>> small;
+        small.push(item);
+        small.swap(copy);
+        ASSERT_EQ(item.use_count(), 21);
+    }
+    ASSERT_EQ(item.use_count(), 1);
+}
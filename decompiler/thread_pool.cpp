@@ -0,0 +1,164 @@
+#include "thread_pool.h"
+#include "arena.h"
+
+ThreadPool::ThreadPool(unsigned int numWorkers)
+    : mQueued(0)
+{
+    for (unsigned int i = 0; i < numWorkers; i++)
+    {
+        mQueues.emplace_back(new Queue());
+    }
+    for (unsigned int i = 0; i < numWorkers; i++)
+    {
+        mThreads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (std::thread& thread : mThreads)
+    {
+        thread.join();
+    }
+}
+
+unsigned int ThreadPool::DefaultConcurrency()
+{
+    const unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void ThreadPool::Run(const std::vector<std::function<void()>>& tasks)
+{
+    Batch batch;
+    batch.mRemaining = tasks.size();
+    batch.mErrorIndex = tasks.size();
+
+    if (mQueues.empty())
+    {
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            Execute({ &tasks[i], &batch, i });
+        }
+    }
+    else
+    {
+        // Deal the tasks out round robin, stealing evens out whatever imbalance that leaves
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            Queue& queue = *mQueues[i % mQueues.size()];
+            std::lock_guard<std::mutex> lock(queue.mMutex);
+            queue.mTasks.push_back({ &tasks[i], &batch, i });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mQueued += tasks.size();
+        }
+        mWake.notify_all();
+
+        // Help out rather than blocking, this may run tasks from other batches too. Those mustn't
+        // allocate from this thread's arena, their objects would die with the caller rather than them.
+        Task task;
+        while (batch.mRemaining > 0 && TryPop(0, task))
+        {
+            if (task.mBatch == &batch)
+            {
+                Execute(task);
+            }
+            else
+            {
+                Arena::Scope noArena(nullptr);
+                Execute(task);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(batch.mMutex);
+        batch.mDone.wait(lock, [&]() { return batch.mRemaining == 0; });
+    }
+
+    if (batch.mError)
+    {
+        std::rethrow_exception(batch.mError);
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t index)
+{
+    for (;;)
+    {
+        Task task;
+        if (TryPop(index, task))
+        {
+            Execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWake.wait(lock, [&]() { return mStop || mQueued > 0; });
+        if (mStop)
+        {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryPop(size_t preferredQueue, Task& task)
+{
+    // Newest task from our own queue first, as its data is most likely to still be cached
+    {
+        Queue& queue = *mQueues[preferredQueue];
+        std::lock_guard<std::mutex> lock(queue.mMutex);
+        if (!queue.mTasks.empty())
+        {
+            task = queue.mTasks.back();
+            queue.mTasks.pop_back();
+            mQueued--;
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest task from someone else
+    for (size_t i = 1; i < mQueues.size(); i++)
+    {
+        Queue& queue = *mQueues[(preferredQueue + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(queue.mMutex);
+        if (!queue.mTasks.empty())
+        {
+            task = queue.mTasks.front();
+            queue.mTasks.pop_front();
+            mQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Execute(const Task& task)
+{
+    Batch& batch = *task.mBatch;
+    try
+    {
+        (*task.mFunc)();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(batch.mMutex);
+        if (task.mIndex < batch.mErrorIndex)
+        {
+            batch.mErrorIndex = task.mIndex;
+            batch.mError = std::current_exception();
+        }
+    }
+
+    // Notify under the lock, otherwise Run could see zero and destroy the batch while we still use it
+    std::lock_guard<std::mutex> lock(batch.mMutex);
+    if (--batch.mRemaining == 0)
+    {
+        batch.mDone.notify_all();
+    }
+}
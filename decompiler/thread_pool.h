@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed size pool of worker threads with a task queue per worker. Workers take tasks from
+ * the back of their own queue and, when that is empty, steal from the front of the others,
+ * so uneven task costs (such as field scripts of very different sizes) still balance out.
+ *
+ * The thread calling Run helps execute tasks while it waits, which means Run can be called
+ * from inside a task without deadlocking, and a pool with no workers runs everything on the
+ * calling thread. Tasks the caller runs from other batches run without its Arena, if it has one.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @param numWorkers Number of threads to start, the caller of Run is an extra one.
+     */
+    explicit ThreadPool(unsigned int numWorkers);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    unsigned int NumWorkers() const { return static_cast<unsigned int>(mThreads.size()); }
+
+    /**
+     * Runs every task and returns once they have all finished. If any task throws, the
+     * exception from the lowest indexed failing task is rethrown after the rest complete.
+     */
+    void Run(const std::vector<std::function<void()>>& tasks);
+
+    // Total concurrency to use when the caller doesn't say, at least 1
+    static unsigned int DefaultConcurrency();
+
+private:
+    struct Batch
+    {
+        std::atomic<size_t> mRemaining;
+        std::mutex mMutex;
+        std::condition_variable mDone;
+        size_t mErrorIndex;
+        std::exception_ptr mError;
+    };
+
+    struct Task
+    {
+        const std::function<void()>* mFunc;
+        Batch* mBatch;
+        size_t mIndex;
+    };
+
+    struct Queue
+    {
+        std::mutex mMutex;
+        std::deque<Task> mTasks;
+    };
+
+    void WorkerLoop(size_t index);
+    bool TryPop(size_t preferredQueue, Task& task);
+    static void Execute(const Task& task);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mThreads;
+
+    // Guards sleeping workers, mQueued is only increased while holding it so no wake up is missed
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    std::atomic<size_t> mQueued;
+    bool mStop = false;
+};
@@ -82,6 +82,32 @@ private:
     std::string mWhat;
 };
 
+class AnalysisBudgetExceededException : public InternalDecompilerError
+{
+public:
+    virtual const char *what() const throw() override
+    {
+        return "control flow analysis took more steps than its budget allows";
+    }
+};
+
+class LzsDecompressionException : public InternalDecompilerError
+{
+public:
+    LzsDecompressionException(const std::string& reason)
+        : mWhat("malformed LZS data: " + reason)
+    {
+
+    }
+
+    virtual const char *what() const throw() override
+    {
+        return mWhat.c_str();
+    }
+
+private:
+    std::string mWhat;
+};
 
 /**
  * Exception representing an unknown opcode.
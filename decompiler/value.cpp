@@ -22,42 +22,49 @@
 #include "value.h"
 
 #include <boost/format.hpp>
+#include <atomic>
 #include <map>
 #include <sstream>
 #include <string>
 
-static int dupindex = 0;
-static std::map<std::string, int> binaryOpPrecedence;
-static std::map<std::string, std::string> negateMap;
-
-void initPrecedence() {
-	binaryOpPrecedence["||"] = kLogicalOrPrecedence;
-	binaryOpPrecedence["&&"] = kLogicalAndPrecedence;
-	binaryOpPrecedence["|"] = kBitwiseOrPrecedence;
-	binaryOpPrecedence["^"] = kBitwiseXorPrecedence;
-	binaryOpPrecedence["&"] = kBitwiseAndPrecedence;
-	binaryOpPrecedence["=="] = kEqualityOpPrecedence;
-	binaryOpPrecedence["!="] = kEqualityOpPrecedence;
-	binaryOpPrecedence["<"] = kRelationOpPrecedence;
-	binaryOpPrecedence["<="] = kRelationOpPrecedence;
-	binaryOpPrecedence[">="] = kRelationOpPrecedence;
-	binaryOpPrecedence[">"] = kRelationOpPrecedence;
-	binaryOpPrecedence["<<"] = kShiftOpPrecedence;
-	binaryOpPrecedence[">>"] = kShiftOpPrecedence;
-	binaryOpPrecedence["+"] = kAddOpPrecedence;
-	binaryOpPrecedence["-"] = kAddOpPrecedence;
-	binaryOpPrecedence["*"] = kMultOpPrecedence;
-	binaryOpPrecedence["/"] = kMultOpPrecedence;
-	binaryOpPrecedence["%"] = kMultOpPrecedence;
-}
-
-void initNegateMap() {
-	negateMap["=="] = "!=";
-	negateMap["!="] = "==";
-	negateMap["<"] = ">=";
-	negateMap["<="] = ">";
-	negateMap[">="] = "<";
-	negateMap[">"] = "<=";
+// Shared by every thread, so atomic
+static std::atomic<int> dupindex(0);
+
+// Built once on first use, function local statics are initialized thread safely
+static const std::map<std::string, int> &binaryOpPrecedence() {
+	static const std::map<std::string, int> precedence = {
+		{ "||", kLogicalOrPrecedence },
+		{ "&&", kLogicalAndPrecedence },
+		{ "|", kBitwiseOrPrecedence },
+		{ "^", kBitwiseXorPrecedence },
+		{ "&", kBitwiseAndPrecedence },
+		{ "==", kEqualityOpPrecedence },
+		{ "!=", kEqualityOpPrecedence },
+		{ "<", kRelationOpPrecedence },
+		{ "<=", kRelationOpPrecedence },
+		{ ">=", kRelationOpPrecedence },
+		{ ">", kRelationOpPrecedence },
+		{ "<<", kShiftOpPrecedence },
+		{ ">>", kShiftOpPrecedence },
+		{ "+", kAddOpPrecedence },
+		{ "-", kAddOpPrecedence },
+		{ "*", kMultOpPrecedence },
+		{ "/", kMultOpPrecedence },
+		{ "%", kMultOpPrecedence }
+	};
+	return precedence;
+}
+
+static const std::map<std::string, std::string> &negateMap() {
+	static const std::map<std::string, std::string> negations = {
+		{ "==", "!=" },
+		{ "!=", "==" },
+		{ "<", ">=" },
+		{ "<=", ">" },
+		{ ">=", "<" },
+		{ ">", "<=" }
+	};
+	return negations;
 }
 
 bool Value::isInteger() {
@@ -204,18 +211,16 @@ std::ostream &BinaryOpValue::print(std::ostream &output) const {
 }
 
 int BinaryOpValue::precedence() const {
-	if (binaryOpPrecedence.empty())
-		initPrecedence();
-	return binaryOpPrecedence[_op];
+	auto it = binaryOpPrecedence().find(_op);
+	return it == binaryOpPrecedence().end() ? 0 : it->second;
 }
 
 ValuePtr BinaryOpValue::negate() throw(WrongTypeException) {
-	if (negateMap.empty())
-		initNegateMap();
-	if (negateMap.find(_op) == negateMap.end())
+	auto it = negateMap().find(_op);
+	if (it == negateMap().end())
 		return Value::negate();
 	else
-		return new BinaryOpValue(_lhs, _rhs, negateMap[_op]);
+		return new BinaryOpValue(_lhs, _rhs, it->second);
 }
 
 std::ostream &UnaryOpValue::print(std::ostream &output) const {